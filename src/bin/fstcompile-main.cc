@@ -38,6 +38,7 @@ DECLARE_string(ssymbols);
 DECLARE_bool(keep_isymbols);
 DECLARE_bool(keep_osymbols);
 DECLARE_bool(keep_state_numbering);
+DECLARE_int32(threads);
 
 int fstcompile_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -54,6 +55,11 @@ int fstcompile_main(int argc, char **argv) {
     return 1;
   }
 
+  if (FST_FLAGS_threads < 0) {
+    LOG(ERROR) << argv[0] << ": --threads must be non-negative";
+    return 1;
+  }
+
   std::string source = "standard input";
   std::ifstream fstrm;
   if (argc > 1 && strcmp(argv[1], "-") != 0) {
@@ -97,7 +103,8 @@ int fstcompile_main(int argc, char **argv) {
              ssyms.get(), FST_FLAGS_acceptor,
              FST_FLAGS_keep_isymbols,
              FST_FLAGS_keep_osymbols,
-             FST_FLAGS_keep_state_numbering);
+             FST_FLAGS_keep_state_numbering,
+             FST_FLAGS_threads);
 
   return 0;
 }
@@ -26,6 +26,9 @@ DEFINE_string(ssymbols, "", "State label symbol table");
 DEFINE_bool(keep_isymbols, false, "Store input label symbol table with FST");
 DEFINE_bool(keep_osymbols, false, "Store output label symbol table with FST");
 DEFINE_bool(keep_state_numbering, false, "Do not renumber input states");
+DEFINE_int32(threads, 1,
+             "Number of threads used to parse the input (0 for one per "
+             "hardware thread)");
 
 int fstcompile_main(int argc, char **argv);
 
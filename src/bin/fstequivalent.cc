@@ -29,7 +29,8 @@ DEFINE_uint64(seed, ::fst::script::kDefaultSeed, "Random seed");
 DEFINE_string(select, "uniform",
               "Selection type: one of "
               " \"uniform\", \"log_prob\" (when appropriate),"
-              " \"fast_log_prob\" (when appropriate)");
+              " \"fast_log_prob\" (when appropriate),"
+              " \"alias\" (when appropriate)");
 
 int fstequivalent_main(int argc, char **argv);
 
@@ -39,6 +39,7 @@ DECLARE_string(save_isymbols);
 DECLARE_string(save_osymbols);
 DECLARE_bool(show_weight_one);
 DECLARE_string(missing_symbol);
+DECLARE_int32(threads);
 
 int fstprint_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -56,6 +57,11 @@ int fstprint_main(int argc, char **argv) {
     return 1;
   }
 
+  if (FST_FLAGS_threads < 0) {
+    LOG(ERROR) << argv[0] << ": --threads must be non-negative";
+    return 1;
+  }
+
   const std::string in_name =
       (argc > 1 && strcmp(argv[1], "-") != 0) ? argv[1] : "";
   const std::string out_name =
@@ -111,7 +117,7 @@ int fstprint_main(int argc, char **argv) {
 
   s::Print(*fst, ostrm, dest, isyms.get(), osyms.get(), ssyms.get(),
            FST_FLAGS_acceptor, FST_FLAGS_show_weight_one,
-           FST_FLAGS_missing_symbol);
+           FST_FLAGS_missing_symbol, FST_FLAGS_threads);
 
   if (isyms && !FST_FLAGS_save_isymbols.empty()) {
     if (!isyms->WriteText(FST_FLAGS_save_isymbols)) return 1;
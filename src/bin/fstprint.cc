@@ -28,6 +28,9 @@ DEFINE_bool(show_weight_one, false,
             "Print/draw arc weights and final weights equal to semiring One?");
 DEFINE_string(missing_symbol, "",
               "Symbol to print when lookup fails (default raises error)");
+DEFINE_int32(threads, 1,
+             "Number of threads used to format the output (0 for one per "
+             "hardware thread)");
 
 int fstprint_main(int argc, char **argv);
 
@@ -25,7 +25,8 @@ DEFINE_uint64(seed, ::fst::script::kDefaultSeed, "Random seed");
 DEFINE_string(select, "uniform",
               "Selection type: one of "
               " \"uniform\", \"log_prob\" (when appropriate),"
-              " \"fast_log_prob\" (when appropriate)");
+              " \"fast_log_prob\" (when appropriate),"
+              " \"alias\" (when appropriate)");
 DEFINE_bool(weighted, false,
             "Output tree weighted by path count vs. unweighted paths");
 DEFINE_bool(remove_total_weight, false,
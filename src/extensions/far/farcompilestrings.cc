@@ -20,11 +20,13 @@ DEFINE_int32(generate_keys, 0,
              "Generate N digit numeric keys (def: use file basenames)");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"");
+              "\"stlist\", \"sttable\", \"packed\"");
 DEFINE_string(arc_type, "standard", "Output arc type");
 DEFINE_string(entry_type, "line",
               "Entry type: one of : "
-              "\"file\" (one FST per file), \"line\" (one FST per line)");
+              "\"file\" (one FST per file), \"line\" (one FST per line), "
+              "\"set\" (one FST per file of lines sorted in label order, "
+              "accepting the set of lines)");
 DEFINE_string(fst_type, "", "Output FST type");
 DEFINE_string(token_type, "symbol",
               "Token type: one of : "
@@ -32,6 +32,7 @@
 
 DECLARE_string(far_type);
 DECLARE_string(fst_type);
+DECLARE_int32(threads);
 
 int farconvert_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -50,6 +51,11 @@ int farconvert_main(int argc, char **argv) {
     return 1;
   }
 
+  if (FST_FLAGS_threads < 0) {
+    LOG(ERROR) << argv[0] << ": --threads must be non-negative";
+    return 1;
+  }
+
   // No args: read from stdin and write to stdout.
   // One arg: read from in.far and write to stdout.
   // Note that only STList can be written to stdout.
@@ -79,7 +85,7 @@ int farconvert_main(int argc, char **argv) {
   if (!writer) return 1;
 
   // An unspecified fst_type entails that the input FST types are preserved.
-  s::Convert(*reader, *writer, FST_FLAGS_fst_type);
+  s::Convert(*reader, *writer, FST_FLAGS_fst_type, FST_FLAGS_threads);
 
   if (reader->Error()) {
     FSTERROR() << "Error reading FAR: " << in_name;
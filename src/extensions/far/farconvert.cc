@@ -20,8 +20,11 @@
 DEFINE_string(fst_type, "", "Output FST type");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"; "
+              "\"stlist\", \"sttable\", \"packed\"; "
               "the input FAR type is used if \"default\"");
+DEFINE_int32(threads, 1,
+             "Number of threads used to convert FSTs (0 for one per hardware "
+             "thread)");
 
 int farconvert_main(int argc, char **argv);
 
@@ -20,7 +20,7 @@ DEFINE_int32(generate_keys, 0,
              "Generate N digit numeric keys (def: use file basenames)");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", "
-              "\"stlist\", \"sttable\"");
+              "\"stlist\", \"sttable\", \"packed\"");
 DEFINE_bool(file_list_input, false,
             "Each input file contains a list of files to be processed");
 
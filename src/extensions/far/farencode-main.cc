@@ -37,6 +37,7 @@ DECLARE_bool(encode_labels);
 DECLARE_bool(encode_weights);
 DECLARE_bool(encode_reuse);
 DECLARE_string(far_type);
+DECLARE_int32(threads);
 
 int farencode_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -55,6 +56,11 @@ int farencode_main(int argc, char **argv) {
     return 1;
   }
 
+  if (FST_FLAGS_threads < 0) {
+    LOG(ERROR) << argv[0] << ": --threads must be non-negative";
+    return 1;
+  }
+
   const std::string in_name = (strcmp(argv[1], "-") != 0) ? argv[1] : "";
   const std::string mapper_name = argv[2];
   const std::string out_name =
@@ -84,7 +90,7 @@ int farencode_main(int argc, char **argv) {
     std::unique_ptr<EncodeMapperClass> mapper(
         EncodeMapperClass::Read(mapper_name));
     if (!mapper) return 1;
-    s::Decode(*reader, *writer, *mapper);
+    s::Decode(*reader, *writer, *mapper, FST_FLAGS_threads);
   } else if (FST_FLAGS_encode_reuse) {
     std::unique_ptr<EncodeMapperClass> mapper(
         EncodeMapperClass::Read(mapper_name));
@@ -23,8 +23,11 @@ DEFINE_bool(encode_weights, false, "Encode weights");
 DEFINE_bool(encode_reuse, false, "Re-use existing mapper");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"; "
+              "\"stlist\", \"sttable\", \"packed\"; "
               "the input FAR type is used if \"default\"");
+DEFINE_int32(threads, 1,
+             "Number of threads used to decode FSTs (0 for one per hardware "
+             "thread); encoding is sequential");
 
 int farencode_main(int argc, char **argv);
 
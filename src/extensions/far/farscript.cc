@@ -20,6 +20,7 @@
 
 #include <fst/extensions/far/farscript.h>
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -69,8 +70,8 @@ void CompileStrings(const std::vector<std::string> &sources,
 REGISTER_FST_OPERATION_4ARCS(CompileStrings, FarCompileStringsArgs);
 
 void Convert(FarReaderClass &reader, FarWriterClass &writer,
-             std::string_view fst_type) {
-  FarConvertArgs args{reader, writer, fst_type};
+             std::string_view fst_type, size_t num_threads) {
+  FarConvertArgs args{reader, writer, fst_type, num_threads};
   Apply<Operation<FarConvertArgs>>("Convert", reader.ArcType(), &args);
 }
 
@@ -86,12 +87,12 @@ void Create(const std::vector<std::string> &sources, FarWriterClass &writer,
 REGISTER_FST_OPERATION_4ARCS(Create, FarCreateArgs);
 
 void Decode(FarReaderClass &reader, FarWriterClass &writer,
-            const EncodeMapperClass &encoder) {
+            const EncodeMapperClass &encoder, size_t num_threads) {
   if (!internal::ArcTypesMatch(reader, encoder, "Decode") ||
       !internal::ArcTypesMatch(writer, encoder, "Decode")) {
     return;
   }
-  FarDecodeArgs args{reader, writer, encoder};
+  FarDecodeArgs args{reader, writer, encoder, num_threads};
   Apply<Operation<FarDecodeArgs>>("Decode", reader.ArcType(), &args);
 }
 
@@ -38,6 +38,8 @@ bool GetFarType(std::string_view str, FarType *far_type) {
     *far_type = FarType::STLIST;
   } else if (str == "sttable") {
     *far_type = FarType::STTABLE;
+  } else if (str == "packed") {
+    *far_type = FarType::PACKED;
   } else if (str == "default") {
     *far_type = FarType::DEFAULT;
   } else {
@@ -51,6 +53,8 @@ bool GetFarEntryType(std::string_view str, FarEntryType *entry_type) {
     *entry_type = FarEntryType::LINE;
   } else if (str == "file") {
     *entry_type = FarEntryType::FILE;
+  } else if (str == "set") {
+    *entry_type = FarEntryType::SET;
   } else {
     return false;
   }
@@ -70,6 +74,8 @@ std::string GetFarTypeString(FarType far_type) {
       return "stlist";
     case FarType::STTABLE:
       return "sttable";
+    case FarType::PACKED:
+      return "packed";
     case FarType::DEFAULT:
       return "default";
     default:
@@ -46,6 +46,7 @@ size_t BitmapIndex::Rank1(size_t end) const {
   // Without this special case, we'd go past the end. It's questionable
   // whether we should support end == Bits().
   if (end >= num_bits_) return GetOnesCount();
+  if (!blocks_.empty()) return InterleavedRank1(end);
   const uint32_t end_word = end / kStorageBitSize;
   const uint32_t sum = GetIndexOnesCount(end_word);
   const int bit_index = end % kStorageBitSize;
@@ -57,6 +58,7 @@ size_t BitmapIndex::Rank1(size_t end) const {
 
 size_t BitmapIndex::Select1(size_t bit_index) const {
   if (bit_index >= GetOnesCount()) return Bits();
+  if (!blocks_.empty()) return InterleavedSelect1(bit_index);
   const RankIndexEntry& entry = FindRankIndexEntry(bit_index);
   const uint32_t block_index = &entry - rank_index_.data();
   // TODO(jrosenstock): Look at whether word or bit indices are faster.
@@ -103,6 +105,7 @@ size_t BitmapIndex::Select1(size_t bit_index) const {
 size_t BitmapIndex::Select0(size_t bit_index) const {
   const uint32_t zeros_count = Bits() - GetOnesCount();
   if (bit_index >= zeros_count) return Bits();
+  if (!blocks_.empty()) return InterleavedSelect0(bit_index);
   const RankIndexEntry& entry = FindInvertedRankIndexEntry(bit_index);
   const uint32_t block_index = &entry - rank_index_.data();
   static_assert(kUnitsPerRankIndexEntry == 8);
@@ -152,6 +155,21 @@ std::pair<size_t, size_t> BitmapIndex::Select0s(size_t bit_index) const {
   if (bit_index >= zeros_count) return {Bits(), Bits()};
   if (bit_index + 1 >= zeros_count) return {Select0(bit_index), Bits()};
 
+  if (!blocks_.empty()) {
+    // As below, looks for the next zero in the same word.
+    const size_t first = InterleavedSelect0(bit_index);
+    const size_t offset = first % kBitsPerBlock;
+    const uint64_t inv_word =
+        ~blocks_[first / kBitsPerBlock].words[offset / kStorageBitSize];
+    const uint64_t masked_inv_word =
+        inv_word & -(uint64_t{0x2} << (offset % kStorageBitSize));
+    if (masked_inv_word != 0) {
+      return {first, first - offset % kStorageBitSize +
+                         __builtin_ctzll(masked_inv_word)};
+    }
+    return {first, InterleavedSelect0(bit_index + 1)};
+  }
+
   const RankIndexEntry& entry = FindInvertedRankIndexEntry(bit_index);
   const uint32_t block_index = &entry - rank_index_.data();
   uint32_t word_index = block_index * kUnitsPerRankIndexEntry;
@@ -232,13 +250,20 @@ uint32_t BitmapIndex::GetIndexOnesCount(size_t array_index) const {
 
 void BitmapIndex::BuildIndex(const uint64_t* bits, size_t num_bits,
                              bool enable_select_0_index,
-                             bool enable_select_1_index) {
+                             bool enable_select_1_index, bool interleave) {
   // Absolute counts are uint32s, so this is the most *set* bits we support
   // for now. Just check the number of *input* bits is less than this
   // to keep things simple.
   DCHECK_LT(num_bits, uint64_t{1} << 32);
+  if (interleave) {
+    BuildInterleavedIndex(bits, num_bits, enable_select_0_index,
+                          enable_select_1_index);
+    return;
+  }
   bits_ = bits;
   num_bits_ = num_bits;
+  blocks_.clear();
+  blocks_.shrink_to_fit();
   rank_index_.clear();
   rank_index_.resize(rank_index_size());
 
@@ -456,4 +481,149 @@ const BitmapIndex::RankIndexEntry& BitmapIndex::FindInvertedRankIndexEntry(
   return rank_index_[lo];
 }
 
+size_t BitmapIndex::InterleavedRank1(size_t end) const {
+  const InterleavedBlock& block = blocks_[end / kBitsPerBlock];
+  const uint32_t offset = end % kBitsPerBlock;
+  const uint32_t word_index = offset / kStorageBitSize;
+  const uint32_t bit_index = offset % kStorageBitSize;
+  const uint32_t sum = block.ones_count + block.relative_ones_count(word_index);
+  if (bit_index == 0) return sum;
+  return sum +
+         __builtin_popcountll(block.words[word_index] & kLowBitsMasks[bit_index]);
+}
+
+size_t BitmapIndex::InterleavedSelect1(size_t bit_index) const {
+  // The bit is in the last block in [lo, hi) with at most bit_index 1s
+  // before it.
+  uint32_t lo = 0;
+  uint32_t hi = blocks_.size();
+  if (!select_1_index_.empty()) {
+    const uint32_t select_index = bit_index / kBitsPerInterleavedSelectBlock;
+    lo = select_1_index_[select_index];
+    hi = select_1_index_[select_index + 1] + 1;
+  }
+  if (hi - lo <= kMaxLinearSearchBlocks) {
+    // Each step only looks at the current block, which is needed anyway if
+    // the search ends there.
+    while (lo + 1 < hi &&
+           blocks_[lo].ones_count +
+                   blocks_[lo].relative_ones_count(kWordsPerBlock) <=
+               bit_index) {
+      ++lo;
+    }
+  } else {
+    while (lo + 1 < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (bit_index < blocks_[mid].ones_count) {
+        hi = mid;
+      } else {
+        lo = mid;
+      }
+    }
+  }
+  const InterleavedBlock& block = blocks_[lo];
+  const uint32_t rembits = bit_index - block.ones_count;
+  // Counts the words before the bit without branching.
+  uint32_t word_index = 0;
+  for (uint32_t k = 1; k < kWordsPerBlock; ++k) {
+    word_index += block.relative_ones_count(k) <= rembits;
+  }
+  return lo * kBitsPerBlock + word_index * kStorageBitSize +
+         nth_bit(block.words[word_index],
+                 rembits - block.relative_ones_count(word_index));
+}
+
+size_t BitmapIndex::InterleavedSelect0(size_t bit_index) const {
+  uint32_t lo = 0;
+  uint32_t hi = blocks_.size();
+  if (!select_0_index_.empty()) {
+    const uint32_t select_index = bit_index / kBitsPerInterleavedSelectBlock;
+    lo = select_0_index_[select_index];
+    hi = select_0_index_[select_index + 1] + 1;
+  }
+  if (hi - lo <= kMaxLinearSearchBlocks) {
+    while (lo + 1 < hi &&
+           BlockZerosCount(lo) + kBitsPerBlock -
+                   blocks_[lo].relative_ones_count(kWordsPerBlock) <=
+               bit_index) {
+      ++lo;
+    }
+  } else {
+    while (lo + 1 < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (bit_index < BlockZerosCount(mid)) {
+        hi = mid;
+      } else {
+        lo = mid;
+      }
+    }
+  }
+  const InterleavedBlock& block = blocks_[lo];
+  const uint32_t remzeros = bit_index - BlockZerosCount(lo);
+  uint32_t word_index = 0;
+  for (uint32_t k = 1; k < kWordsPerBlock; ++k) {
+    word_index +=
+        k * kStorageBitSize - block.relative_ones_count(k) <= remzeros;
+  }
+  return lo * kBitsPerBlock + word_index * kStorageBitSize +
+         nth_bit(~block.words[word_index],
+                 remzeros - (word_index * kStorageBitSize -
+                             block.relative_ones_count(word_index)));
+}
+
+void BitmapIndex::BuildInterleavedIndex(const uint64_t* bits, size_t num_bits,
+                                        bool enable_select_0_index,
+                                        bool enable_select_1_index) {
+  bits_ = nullptr;
+  num_bits_ = num_bits;
+  rank_index_.clear();
+  rank_index_.shrink_to_fit();
+  select_0_index_.clear();
+  select_1_index_.clear();
+  const size_t array_size = ArraySize();
+  const size_t num_blocks = (array_size + kWordsPerBlock - 1) / kWordsPerBlock;
+  blocks_.assign(num_blocks + 1, InterleavedBlock());
+  uint32_t ones_count = 0;
+  uint32_t zeros_count = 0;
+  for (size_t block_index = 0; block_index < num_blocks; ++block_index) {
+    InterleavedBlock& block = blocks_[block_index];
+    block.ones_count = ones_count;
+    uint32_t block_ones_count = 0;
+    for (uint32_t i = 0; i < kWordsPerBlock; ++i) {
+      const size_t word_index = block_index * kWordsPerBlock + i;
+      if (word_index < array_size) block.words[i] = bits[word_index];
+      block_ones_count += __builtin_popcountll(block.words[i]);
+      block.relative_ones_counts |= uint64_t{block_ones_count} << (9 * (i + 1));
+    }
+    // Records the block once for each select index entry in it. Zeros past
+    // num_bits are counted too, but they come after all the zeros that can be
+    // selected.
+    const uint32_t block_zeros_count = kBitsPerBlock - block_ones_count;
+    if (enable_select_1_index) {
+      for (uint32_t skip = -ones_count % kBitsPerInterleavedSelectBlock;
+           skip < block_ones_count; skip += kBitsPerInterleavedSelectBlock) {
+        select_1_index_.push_back(block_index);
+      }
+    }
+    if (enable_select_0_index) {
+      for (uint32_t skip = -zeros_count % kBitsPerInterleavedSelectBlock;
+           skip < block_zeros_count; skip += kBitsPerInterleavedSelectBlock) {
+        select_0_index_.push_back(block_index);
+      }
+    }
+    ones_count += block_ones_count;
+    zeros_count += block_zeros_count;
+  }
+  // Add the extra block with the total count.
+  blocks_.back().ones_count = ones_count;
+  if (enable_select_0_index) {
+    select_0_index_.push_back(num_blocks);
+    select_0_index_.shrink_to_fit();
+  }
+  if (enable_select_1_index) {
+    select_1_index_.push_back(num_blocks);
+    select_1_index_.shrink_to_fit();
+  }
+}
+
 }  // end namespace fst
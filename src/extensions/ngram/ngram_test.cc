@@ -0,0 +1,267 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for NGramFst scoring and BitmapIndex.
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/extensions/ngram/bitmap-index.h>
+#include <fst/extensions/ngram/ngram-fst.h>
+#include <fst/arc.h>
+#include <fst/arcsort.h>
+#include <fst/fst.h>
+#include <fst/vector-fst.h>
+#include <fst/weight.h>
+
+DEFINE_uint64(seed, 403, "random seed");
+DEFINE_int32(repeat, 20, "number of test repetitions");
+
+namespace fst {
+namespace {
+
+using Label = StdArc::Label;
+using StateId = StdArc::StateId;
+using Weight = StdArc::Weight;
+
+// Builds a random trigram backoff model over the labels 1 to num_labels, in
+// the form produced by OpenGrm: a unigram state with arcs for all labels, a
+// start state and bigram and trigram context states, each with a backoff
+// arc to its longest proper suffix context.
+VectorFst<StdArc> RandomModel(int num_labels, std::mt19937_64 *rand) {
+  std::bernoulli_distribution coin(0.5);
+  std::uniform_real_distribution<float> cost(0.1, 5.0);
+  VectorFst<StdArc> model;
+  const auto unigram = model.AddState();
+  const auto start = model.AddState();
+  model.SetStart(start);
+  std::map<Label, StateId> bigrams;
+  for (Label label = 1; label <= num_labels; ++label) {
+    if (coin(*rand)) bigrams[label] = model.AddState();
+  }
+  std::map<std::pair<Label, Label>, StateId> trigrams;
+  for (const auto &[first, state] : bigrams) {
+    for (const auto &[second, next] : bigrams) {
+      if (coin(*rand)) trigrams[{first, second}] = model.AddState();
+    }
+  }
+  // Returns the state reached by reading label after the label last.
+  const auto destination = [&](Label last, Label label) {
+    if (const auto it = trigrams.find({last, label}); it != trigrams.end()) {
+      return it->second;
+    }
+    if (const auto it = bigrams.find(label); it != bigrams.end()) {
+      return it->second;
+    }
+    return unigram;
+  };
+  for (Label label = 1; label <= num_labels; ++label) {
+    model.AddArc(unigram, StdArc(label, label, cost(*rand),
+                                 destination(kNoLabel, label)));
+    if (coin(*rand)) {
+      model.AddArc(start, StdArc(label, label, cost(*rand),
+                                 destination(kNoLabel, label)));
+    }
+  }
+  model.SetFinal(unigram, cost(*rand));
+  model.AddArc(start, StdArc(0, 0, cost(*rand), unigram));
+  for (const auto &[last, state] : bigrams) {
+    model.AddArc(state, StdArc(0, 0, cost(*rand), unigram));
+    for (Label label = 1; label <= num_labels; ++label) {
+      // Arcs into trigram states are required to reach them.
+      if (trigrams.count({last, label}) || coin(*rand)) {
+        model.AddArc(state, StdArc(label, label, cost(*rand),
+                                   destination(last, label)));
+      }
+    }
+    if (coin(*rand)) model.SetFinal(state, cost(*rand));
+  }
+  for (const auto &[context, state] : trigrams) {
+    model.AddArc(state, StdArc(0, 0, cost(*rand), bigrams[context.second]));
+    for (Label label = 1; label <= num_labels; ++label) {
+      if (coin(*rand)) {
+        model.AddArc(state, StdArc(label, label, cost(*rand),
+                                   destination(context.second, label)));
+      }
+    }
+    if (coin(*rand)) model.SetFinal(state, cost(*rand));
+  }
+  ArcSort(&model, ILabelCompare<StdArc>());
+  return model;
+}
+
+// Reads a label from a state of the model by following backoff arcs until a
+// state with an arc for the label is found.
+StateId BackoffNext(const VectorFst<StdArc> &model, StateId state, Label label,
+                    Weight *weight) {
+  while (true) {
+    StateId backoff = kNoStateId;
+    Weight backoff_weight;
+    for (ArcIterator<VectorFst<StdArc>> aiter(model, state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (arc.ilabel == label) {
+        *weight = Times(*weight, arc.weight);
+        return arc.nextstate;
+      } else if (arc.ilabel == 0) {
+        backoff = arc.nextstate;
+        backoff_weight = arc.weight;
+      }
+    }
+    if (backoff == kNoStateId) return kNoStateId;
+    *weight = Times(*weight, backoff_weight);
+    state = backoff;
+  }
+}
+
+// Tests that NGramScorer agrees with a backoff walk of the input model, with
+// single and batched queries and with a cache small enough to evict.
+void TestScorer(std::mt19937_64 *rand) {
+  const int num_labels = std::uniform_int_distribution<>(1, 12)(*rand);
+  const auto model = RandomModel(num_labels, rand);
+  std::vector<StateId> order;
+  const NGramFst<StdArc> ngram(model, &order);
+  CHECK(!ngram.Properties(kError, false));
+  NGramScorer<StdArc> scorer(ngram);
+  NGramScorer<StdArc> small_scorer(ngram, /*cache_size=*/3);
+
+  // Label num_labels + 1 is not in the model.
+  std::uniform_int_distribution<Label> label_dist(1, num_labels + 1);
+  std::uniform_int_distribution<StateId> state_dist(0,
+                                                    model.NumStates() - 1);
+  std::uniform_int_distribution<size_t> length_dist(0, 8);
+  std::vector<StateId> states;
+  std::vector<std::vector<Label>> queries;
+  std::vector<Weight> expected_weights;
+  std::vector<StateId> expected_states;
+  for (int i = 0; i < 200; ++i) {
+    const auto state = state_dist(*rand);
+    std::vector<Label> labels(length_dist(*rand));
+    for (auto &label : labels) label = label_dist(*rand);
+    auto weight = Weight::One();
+    auto nextstate = state;
+    for (const auto label : labels) {
+      nextstate = BackoffNext(model, nextstate, label, &weight);
+      if (nextstate == kNoStateId) break;
+    }
+    if (nextstate == kNoStateId) {
+      weight = Weight::Zero();
+    } else {
+      nextstate = order[nextstate];
+    }
+    states.push_back(order[state]);
+    queries.push_back(std::move(labels));
+    expected_weights.push_back(weight);
+    expected_states.push_back(nextstate);
+  }
+
+  for (size_t i = 0; i < queries.size(); ++i) {
+    for (auto *s : {&scorer, &small_scorer}) {
+      StateId nextstate;
+      const auto weight = s->Score(states[i], queries[i], &nextstate);
+      CHECK(ApproxEqual(weight, expected_weights[i]));
+      CHECK_EQ(nextstate, expected_states[i]);
+    }
+  }
+  for (auto *s : {&scorer, &small_scorer}) {
+    std::vector<Weight> weights;
+    std::vector<StateId> nextstates;
+    s->Score(states, queries, &weights, &nextstates);
+    CHECK_EQ(weights.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+      CHECK(ApproxEqual(weights[i], expected_weights[i]));
+      CHECK_EQ(nextstates[i], expected_states[i]);
+    }
+  }
+}
+
+// Tests rank, select and Get of a BitmapIndex, in every layout, against a
+// linear scan of random bitmaps of the given size and density of ones.
+void TestBitmapIndex(size_t num_bits, double density, std::mt19937_64 *rand) {
+  std::bernoulli_distribution coin(density);
+  std::vector<uint64_t> bits(BitmapIndex::StorageSize(num_bits), 0);
+  std::vector<size_t> ones;
+  std::vector<size_t> zeros;
+  for (size_t i = 0; i < num_bits; ++i) {
+    if (coin(*rand)) {
+      BitmapIndex::Set(bits.data(), i);
+      ones.push_back(i);
+    } else {
+      zeros.push_back(i);
+    }
+  }
+  for (int config = 0; config < 8; ++config) {
+    const BitmapIndex index(bits.data(), num_bits,
+                            /*enable_select_0_index=*/config & 1,
+                            /*enable_select_1_index=*/config & 2,
+                            /*interleave=*/config & 4);
+    CHECK_EQ(index.Bits(), num_bits);
+    CHECK_EQ(index.GetOnesCount(), ones.size());
+    size_t rank = 0;
+    for (size_t i = 0; i <= num_bits; ++i) {
+      CHECK_EQ(index.Rank1(i), rank);
+      CHECK_EQ(index.Rank0(i), i - rank);
+      if (i < num_bits) {
+        CHECK_EQ(index.Get(i), BitmapIndex::Get(bits.data(), i));
+        rank += index.Get(i);
+      }
+    }
+    for (size_t n = 0; n <= ones.size(); ++n) {
+      CHECK_EQ(index.Select1(n), n < ones.size() ? ones[n] : num_bits);
+    }
+    for (size_t n = 0; n <= zeros.size(); ++n) {
+      const size_t first = n < zeros.size() ? zeros[n] : num_bits;
+      const size_t second = n + 1 < zeros.size() ? zeros[n + 1] : num_bits;
+      CHECK_EQ(index.Select0(n), first);
+      const auto both = index.Select0s(n);
+      CHECK_EQ(both.first, first);
+      CHECK_EQ(both.second, second);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  std::mt19937_64 rand(FST_FLAGS_seed);
+  LOG(INFO) << "Seed = " << FST_FLAGS_seed;
+  for (int i = 0; i < FST_FLAGS_repeat; ++i) fst::TestScorer(&rand);
+
+  // Sizes around word, rank block (512 bits), interleaved block (384 bits)
+  // and select sample boundaries.
+  for (const size_t num_bits :
+       {0, 1, 63, 64, 65, 383, 384, 385, 511, 512, 513, 767, 768, 769, 1536,
+        4095, 4096, 4097, 100000}) {
+    for (const double density : {0.0, 0.01, 0.5, 0.99, 1.0}) {
+      fst::TestBitmapIndex(num_bits, density, &rand);
+    }
+  }
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
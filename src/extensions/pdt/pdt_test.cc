@@ -0,0 +1,166 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for PDT shortest path.
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/extensions/pdt/replace.h>
+#include <fst/extensions/pdt/shortest-path.h>
+#include <fst/arc.h>
+#include <fst/equal.h>
+#include <fst/fst.h>
+#include <fst/properties.h>
+#include <fst/queue.h>
+#include <fst/util.h>
+#include <fst/vector-fst.h>
+
+DEFINE_uint64(seed, 403, "random seed");
+DEFINE_int32(repeat, 50, "number of test repetitions");
+
+namespace fst {
+namespace {
+
+using Label = StdArc::Label;
+using StateId = StdArc::StateId;
+using Queue = FifoQueue<StateId>;
+
+// First nonterminal label.
+constexpr Label kRoot = 1000;
+
+// First parenthesis label, above all nonterminals; by default parentheses
+// follow the largest label reached, which may be an unreached nonterminal.
+constexpr Label kParens = 2000;
+
+void ReplaceRtn(
+    const std::vector<std::pair<Label, const Fst<StdArc> *>> &rtn,
+    VectorFst<StdArc> *pdt, std::vector<std::pair<Label, Label>> *parens) {
+  Replace(rtn, pdt, parens,
+          PdtReplaceOptions<StdArc>(kRoot, PdtParserType::LEFT, kParens));
+}
+
+// Builds a PDT from a random RTN. Unless recursive is true, each nonterminal
+// only calls nonterminals numbered higher than itself, so the PDT has a
+// bounded stack.
+void RandomPdt(bool recursive, std::mt19937_64 *rand, VectorFst<StdArc> *pdt,
+               std::vector<std::pair<Label, Label>> *parens) {
+  const int num_nonterminals = std::uniform_int_distribution<>(2, 20)(*rand);
+  std::vector<std::unique_ptr<VectorFst<StdArc>>> fsts;
+  std::vector<std::pair<Label, const Fst<StdArc> *>> rtn;
+  for (int i = 0; i < num_nonterminals; ++i) {
+    auto fst = std::make_unique<VectorFst<StdArc>>();
+    const int num_states = std::uniform_int_distribution<>(2, 30)(*rand);
+    fst->AddStates(num_states);
+    fst->SetStart(0);
+    fst->SetFinal(num_states - 1, (*rand)() % 5);
+    for (StateId s = 0; s < num_states; ++s) {
+      // A path through every state, so that each nonterminal is productive.
+      if (s + 1 < num_states) fst->AddArc(s, StdArc(1, 1, 5, s + 1));
+      const int num_arcs = 1 + (*rand)() % 3;
+      for (int j = 0; j < num_arcs; ++j) {
+        Label label = 1 + (*rand)() % 10;
+        const int first = recursive ? 0 : i + 1;
+        if ((*rand)() % 4 == 0 && first < num_nonterminals) {
+          label = kRoot + first + (*rand)() % (num_nonterminals - first);
+        }
+        fst->AddArc(s, StdArc(label, label, (*rand)() % 10,
+                              (s + 1 + (*rand)() % 3) % num_states));
+      }
+    }
+    rtn.emplace_back(kRoot + i, fst.get());
+    fsts.push_back(std::move(fst));
+  }
+  ReplaceRtn(rtn, pdt, parens);
+}
+
+// Tests that the parallel PDT shortest path equals the sequential one, or
+// that both report an unbounded stack.
+void TestShortestPath(bool recursive, std::mt19937_64 *rand) {
+  VectorFst<StdArc> pdt;
+  std::vector<std::pair<Label, Label>> parens;
+  RandomPdt(recursive, rand, &pdt, &parens);
+  for (const bool keep_parentheses : {false, true}) {
+    for (const bool path_gc : {false, true}) {
+      VectorFst<StdArc> path;
+      ShortestPath(pdt, parens, &path,
+                   PdtShortestPathOptions<StdArc, Queue>(keep_parentheses,
+                                                         path_gc));
+      const bool error = path.Properties(kError, false) == kError;
+      CHECK(recursive || !error);
+      for (const size_t num_threads : {0, 2, 4}) {
+        VectorFst<StdArc> ppath;
+        ShortestPath(pdt, parens, &ppath,
+                     PdtShortestPathOptions<StdArc, Queue>(
+                         keep_parentheses, path_gc, num_threads));
+        CHECK_EQ(ppath.Properties(kError, false) == kError, error);
+        if (!error) CHECK(Equal(path, ppath));
+      }
+    }
+  }
+}
+
+// Tests that a nonterminal calling itself before it can finish is reported
+// as an unbounded stack with any number of threads.
+void TestRecursionError() {
+  VectorFst<StdArc> fst;
+  fst.AddStates(2);
+  fst.SetStart(0);
+  fst.SetFinal(1);
+  fst.AddArc(0, StdArc(kRoot, kRoot, 1, 1));
+  fst.AddArc(0, StdArc(1, 1, 2, 1));
+  const std::vector<std::pair<Label, const Fst<StdArc> *>> rtn = {
+      {kRoot, &fst}};
+  VectorFst<StdArc> pdt;
+  std::vector<std::pair<Label, Label>> parens;
+  ReplaceRtn(rtn, &pdt, &parens);
+  for (const size_t num_threads : {1, 0, 2, 4}) {
+    VectorFst<StdArc> path;
+    ShortestPath(pdt, parens, &path,
+                 PdtShortestPathOptions<StdArc, Queue>(
+                     /*keep_parentheses=*/false, /*path_gc=*/true,
+                     num_threads));
+    CHECK(path.Properties(kError, false));
+  }
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  SET_FLAGS(argv[0], &argc, &argv, true);
+  // Unbounded stacks are reported as errors, which are checked for.
+  SetFlag(&FST_FLAGS_fst_error_fatal, false);
+
+  std::mt19937_64 rand(FST_FLAGS_seed);
+  LOG(INFO) << "Seed = " << FST_FLAGS_seed;
+  for (int i = 0; i < FST_FLAGS_repeat; ++i) {
+    fst::TestShortestPath(/*recursive=*/false, &rand);
+    fst::TestShortestPath(/*recursive=*/true, &rand);
+  }
+  fst::TestRecursionError();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
@@ -36,6 +36,7 @@ DECLARE_bool(keep_parentheses);
 DECLARE_string(queue_type);
 DECLARE_bool(path_gc);
 DECLARE_string(pdt_parentheses);
+DECLARE_int32(threads);
 
 int pdtshortestpath_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -54,6 +55,11 @@ int pdtshortestpath_main(int argc, char **argv) {
     return 1;
   }
 
+  if (FST_FLAGS_threads < 0) {
+    LOG(ERROR) << argv[0] << ": --threads must be non-negative";
+    return 1;
+  }
+
   const std::string in_name =
       (argc > 1 && (strcmp(argv[1], "-") != 0)) ? argv[1] : "";
   const std::string out_name =
@@ -85,7 +91,8 @@ int pdtshortestpath_main(int argc, char **argv) {
   }
 
   const s::PdtShortestPathOptions opts(
-      qt, FST_FLAGS_keep_parentheses, FST_FLAGS_path_gc);
+      qt, FST_FLAGS_keep_parentheses, FST_FLAGS_path_gc,
+      FST_FLAGS_threads);
 
   s::ShortestPath(*ifst, parens, &ofst, opts);
 
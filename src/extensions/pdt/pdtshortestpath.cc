@@ -25,6 +25,9 @@ DEFINE_string(queue_type, "fifo",
               "\"fifo\", \"lifo\", \"state\"");
 DEFINE_bool(path_gc, true, "Garbage collect shortest path data?");
 DEFINE_string(pdt_parentheses, "", "PDT parenthesis label pairs");
+DEFINE_int32(threads, 1,
+             "Number of threads searching sub-graphs (0 for one per hardware "
+             "thread)");
 
 int pdtshortestpath_main(int argc, char **argv);
 
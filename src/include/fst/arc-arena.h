@@ -220,6 +220,14 @@ class ArcArenaStateStore {
     return (it == cache_.end()) ? nullptr : it->second;
   }
 
+  // Discards all states, e.g., between utterances, keeping the arena's
+  // initial allocation for reuse.
+  void Reset() {
+    cache_.clear();
+    states_.clear();
+    arena_.Clear();
+  }
+
  private:
   class StateBuilder {
    public:
@@ -22,6 +22,7 @@
 #ifndef FST_ARC_MAP_H_
 #define FST_ARC_MAP_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -36,11 +37,14 @@
 #include <fst/float-weight.h>
 #include <fst/fst.h>
 #include <fst/impl-to-fst.h>
+#include <fst/matcher.h>
 #include <fst/mutable-fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/string-weight.h>
 #include <fst/symbol-table.h>
 #include <fst/util.h>
+#include <fst/vector-fst.h>
 #include <fst/weight.h>
 #include <unordered_map>
 
@@ -99,6 +103,12 @@ enum MapSymbolsAction {
 //   // This specifies the known properties of an FST mapped by this mapper. It
 //   takes as argument the input FSTs's known properties.
 //   uint64_t Properties(uint64_t props) const;
+//
+//   // Optional. Returns the side (MATCH_INPUT or MATCH_OUTPUT) of the unmapped
+//   // arcs whose labels appear on the side 'side' (MATCH_INPUT or
+//   // MATCH_OUTPUT) of the mapped arcs, or MATCH_NONE if there is none. Used by
+//   // ArcMapViewFst to pass epsilon counts and matching through to its input.
+//   MatchType LabelSource(MatchType side) const;
 // };
 //
 // The ArcMap functions and classes below will use the FinalAction()
@@ -114,6 +124,15 @@ enum MapSymbolsAction {
 // during decoding. We also include map versions that pass the mapper by value
 // or const reference when this suffices.
 
+// Mapper thread-safety trait, used by the parallel in-place maps below (and by
+// ParallelStateMap in state-map.h). An arc mapper is thread-safe if its
+// operator() may be called concurrently on the same object; a state mapper is
+// thread-safe if copies made with its copy constructor may be used
+// concurrently on distinct states. Mappers are assumed not to be unless they
+// specialize this trait.
+template <class M>
+struct IsThreadSafeMapper : std::false_type {};
+
 // Maps an arc type A using a mapper function object C, passed
 // by pointer. This version modifies its Fst input.
 template <class A, class C>
@@ -199,6 +218,65 @@ void ArcMap(MutableFst<A> *fst, C mapper) {
   ArcMap(fst, &mapper);
 }
 
+// Maps the arcs of a VectorFst in place using a mapper function object C,
+// passed by pointer, partitioning the states across num_threads threads (zero
+// means one per hardware thread). This requires a thread-safe mapper (see
+// IsThreadSafeMapper) with final action MAP_NO_SUPERFINAL, since adding a
+// superfinal state is not thread-safe; o.w., this is the sequential ArcMap.
+template <class A, class S, class C>
+void ParallelArcMap(VectorFst<A, S> *fst, C *mapper, size_t num_threads = 0) {
+  if constexpr (!IsThreadSafeMapper<C>::value) {
+    ArcMap(fst, mapper);
+    return;
+  } else {
+    if (mapper->FinalAction() != MAP_NO_SUPERFINAL ||
+        NumWorkerThreads(num_threads) == 1) {
+      ArcMap(fst, mapper);
+      return;
+    }
+    if (mapper->InputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      fst->SetInputSymbols(nullptr);
+    }
+    if (mapper->OutputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      fst->SetOutputSymbols(nullptr);
+    }
+    if (fst->Start() == kNoStateId) return;
+    const auto props = fst->Properties(kFstProperties, false);
+    // Unshares the implementation before it is mutated on several threads.
+    // Concurrent property updates below may be lost; all properties are set
+    // once the threads are done.
+    fst->SetStart(fst->Start());
+    std::atomic<bool> error(false);
+    ParallelFor(fst->NumStates(), num_threads,
+                [fst, mapper, &error](size_t, size_t begin, size_t end) {
+                  for (auto state = begin; state < end; ++state) {
+                    for (MutableArcIterator<VectorFst<A, S>> aiter(fst, state);
+                         !aiter.Done(); aiter.Next()) {
+                      aiter.SetValue((*mapper)(aiter.Value()));
+                    }
+                    const auto final_arc =
+                        (*mapper)(A(0, 0, fst->Final(state), kNoStateId));
+                    if (final_arc.ilabel != 0 || final_arc.olabel != 0) {
+                      error = true;
+                    }
+                    fst->SetFinal(state, final_arc.weight);
+                  }
+                });
+    fst->SetProperties(mapper->Properties(props), kFstProperties);
+    if (error) {
+      FSTERROR() << "ParallelArcMap: Non-zero arc labels for superfinal arc";
+      fst->SetProperties(kError, kError);
+    }
+  }
+}
+
+// Maps the arcs of a VectorFst in place using a mapper function object C,
+// passed by value, on num_threads threads.
+template <class A, class S, class C>
+void ParallelArcMap(VectorFst<A, S> *fst, C mapper, size_t num_threads = 0) {
+  ParallelArcMap(fst, &mapper, num_threads);
+}
+
 // Maps an arc type A to an arc type B using mapper function object C,
 // passed by pointer. This version writes the mapped input FST to an
 // output MutableFst.
@@ -667,6 +745,368 @@ ArcMapFst(const Fst<typename ArcMapper::FromArc> &, ArcMapper *)
     -> ArcMapFst<typename ArcMapper::FromArc, typename ArcMapper::ToArc,
                  ArcMapper>;
 
+template <class A, class B, class C>
+class ArcMapViewFst;
+
+template <class A, class B, class C>
+class ArcMapViewMatcher;
+
+namespace internal {
+
+// Detects the optional LabelSource() method of an ArcMapper.
+template <class C, class = void>
+struct HasLabelSource : std::false_type {};
+
+template <class C>
+struct HasLabelSource<C, std::void_t<decltype(std::declval<const C &>()
+                                                  .LabelSource(MATCH_INPUT))>>
+    : std::true_type {};
+
+// Implementation of the non-caching ArcMapViewFst.
+template <class A, class B, class C>
+class ArcMapViewFstImpl : public FstImpl<B> {
+ public:
+  using Arc = B;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using FstImpl<B>::SetType;
+  using FstImpl<B>::SetProperties;
+  using FstImpl<B>::SetInputSymbols;
+  using FstImpl<B>::SetOutputSymbols;
+
+  friend class ArcIterator<ArcMapViewFst<A, B, C>>;
+  friend class StateIterator<ArcMapViewFst<A, B, C>>;
+  friend class ArcMapViewMatcher<A, B, C>;
+
+  ArcMapViewFstImpl(const Fst<A> &fst, const C &mapper)
+      : fst_(fst.Copy()), mapper_(mapper) {
+    Init();
+  }
+
+  ArcMapViewFstImpl(const ArcMapViewFstImpl &impl)
+      : FstImpl<B>(impl), fst_(impl.fst_->Copy(true)), mapper_(impl.mapper_) {}
+
+  StateId Start() const { return fst_->Start(); }
+
+  Weight Final(StateId s) {
+    const auto final_arc = mapper_(A(0, 0, fst_->Final(s), kNoStateId));
+    if (final_arc.ilabel != 0 || final_arc.olabel != 0) {
+      FSTERROR() << "ArcMapViewFst: Non-zero arc labels for superfinal arc";
+      SetProperties(kError, kError);
+    }
+    return final_arc.weight;
+  }
+
+  size_t NumArcs(StateId s) const { return fst_->NumArcs(s); }
+
+  size_t NumInputEpsilons(StateId s) const {
+    switch (LabelSource(MATCH_INPUT)) {
+      case MATCH_INPUT:
+        return fst_->NumInputEpsilons(s);
+      case MATCH_OUTPUT:
+        return fst_->NumOutputEpsilons(s);
+      default:
+        return CountEpsilons(s, false);
+    }
+  }
+
+  size_t NumOutputEpsilons(StateId s) const {
+    switch (LabelSource(MATCH_OUTPUT)) {
+      case MATCH_INPUT:
+        return fst_->NumInputEpsilons(s);
+      case MATCH_OUTPUT:
+        return fst_->NumOutputEpsilons(s);
+      default:
+        return CountEpsilons(s, true);
+    }
+  }
+
+  uint64_t Properties() const override { return Properties(kFstProperties); }
+
+  // Sets error if found, and returns other FST impl properties.
+  uint64_t Properties(uint64_t mask) const override {
+    if ((mask & kError) && (fst_->Properties(kError, false) ||
+                            (mapper_.Properties(0) & kError))) {
+      SetProperties(kError, kError);
+    }
+    return FstImpl<Arc>::Properties(mask);
+  }
+
+  // Returns the side (MATCH_INPUT or MATCH_OUTPUT) of the input FST whose
+  // labels appear on the side 'side' of the mapped arcs, or MATCH_NONE if
+  // unknown.
+  MatchType LabelSource(MatchType side) const {
+    if constexpr (HasLabelSource<C>::value) {
+      if (side == MATCH_INPUT || side == MATCH_OUTPUT) {
+        return mapper_.LabelSource(side);
+      }
+    }
+    return MATCH_NONE;
+  }
+
+ private:
+  void Init() {
+    SetType("map");
+    if (mapper_.InputSymbolsAction() == MAP_COPY_SYMBOLS) {
+      SetInputSymbols(fst_->InputSymbols());
+    } else if (mapper_.InputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      SetInputSymbols(nullptr);
+    }
+    if (mapper_.OutputSymbolsAction() == MAP_COPY_SYMBOLS) {
+      SetOutputSymbols(fst_->OutputSymbols());
+    } else if (mapper_.OutputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      SetOutputSymbols(nullptr);
+    }
+    if (mapper_.FinalAction() != MAP_NO_SUPERFINAL) {
+      FSTERROR() << "ArcMapViewFst: Mapper requires a superfinal state";
+      SetProperties(kError, kError);
+    } else if (fst_->Start() == kNoStateId) {
+      SetProperties(kNullProperties);
+    } else {
+      const auto props = fst_->Properties(kCopyProperties, false);
+      SetProperties(mapper_.Properties(props));
+    }
+  }
+
+  size_t CountEpsilons(StateId s, bool output_epsilons) const {
+    size_t num_eps = 0;
+    for (ArcIterator<Fst<A>> aiter(*fst_, s); !aiter.Done(); aiter.Next()) {
+      const auto arc = mapper_(aiter.Value());
+      if ((output_epsilons ? arc.olabel : arc.ilabel) == 0) ++num_eps;
+    }
+    return num_eps;
+  }
+
+  std::unique_ptr<const Fst<A>> fst_;
+  const C mapper_;
+};
+
+}  // namespace internal
+
+// Maps an arc type A to an arc type B using mapper function object C. Unlike
+// ArcMapFst, this delayed FST does no caching: its arc iterators map the arcs
+// of the input FST's arc iterators on the fly, so it uses constant memory
+// regardless of how much of the FST is visited. This requires a stateless
+// mapper (with a const operator()) whose final action is MAP_NO_SUPERFINAL, so
+// that the states and arc counts of the input are preserved.
+//
+// If the mapper defines LabelSource() (see the ArcMapper interface above),
+// epsilon counts are read from the input FST and matching is delegated to the
+// input FST's matcher; o.w., epsilons are counted by iteration and the
+// default sorted matcher is used.
+template <class A, class B, class C>
+class ArcMapViewFst : public ImplToFst<internal::ArcMapViewFstImpl<A, B, C>> {
+ public:
+  using Arc = B;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Impl = internal::ArcMapViewFstImpl<A, B, C>;
+
+  friend class ArcIterator<ArcMapViewFst<A, B, C>>;
+  friend class StateIterator<ArcMapViewFst<A, B, C>>;
+  friend class ArcMapViewMatcher<A, B, C>;
+
+  explicit ArcMapViewFst(const Fst<A> &fst, const C &mapper = C())
+      : ImplToFst<Impl>(std::make_shared<Impl>(fst, mapper)) {}
+
+  // See Fst<>::Copy() for doc.
+  ArcMapViewFst(const ArcMapViewFst &fst, bool safe = false)
+      : ImplToFst<Impl>(fst, safe) {}
+
+  // Gets a copy of this ArcMapViewFst. See Fst<>::Copy() for further doc.
+  ArcMapViewFst *Copy(bool safe = false) const override {
+    return new ArcMapViewFst(*this, safe);
+  }
+
+  inline void InitStateIterator(StateIteratorData<B> *data) const override;
+
+  inline void InitArcIterator(StateId s,
+                              ArcIteratorData<B> *data) const override;
+
+  MatcherBase<B> *InitMatcher(MatchType match_type) const override {
+    if (GetImpl()->LabelSource(match_type) == MATCH_NONE) return nullptr;
+    return new ArcMapViewMatcher<A, B, C>(this, match_type);
+  }
+
+ protected:
+  using ImplToFst<Impl>::GetImpl;
+  using ImplToFst<Impl>::GetMutableImpl;
+
+ private:
+  ArcMapViewFst &operator=(const ArcMapViewFst &) = delete;
+};
+
+// Specialization for ArcMapViewFst.
+//
+// This may be derived from.
+template <class A, class B, class C>
+class StateIterator<ArcMapViewFst<A, B, C>> : public StateIteratorBase<B> {
+ public:
+  using StateId = typename B::StateId;
+
+  explicit StateIterator(const ArcMapViewFst<A, B, C> &fst)
+      : siter_(*fst.GetImpl()->fst_) {}
+
+  bool Done() const final { return siter_.Done(); }
+
+  StateId Value() const final { return siter_.Value(); }
+
+  void Next() final { siter_.Next(); }
+
+  void Reset() final { siter_.Reset(); }
+
+ private:
+  StateIterator<Fst<A>> siter_;
+};
+
+// Specialization for ArcMapViewFst. Arcs are mapped when they are accessed and
+// are valid until the next call to Value() or Next().
+//
+// This may be derived from.
+template <class A, class B, class C>
+class ArcIterator<ArcMapViewFst<A, B, C>> : public ArcIteratorBase<B> {
+ public:
+  using StateId = typename B::StateId;
+
+  ArcIterator(const ArcMapViewFst<A, B, C> &fst, StateId s)
+      : mapper_(fst.GetImpl()->mapper_), aiter_(*fst.GetImpl()->fst_, s) {}
+
+  bool Done() const final { return aiter_.Done(); }
+
+  const B &Value() const final {
+    arc_ = mapper_(aiter_.Value());
+    return arc_;
+  }
+
+  void Next() final { aiter_.Next(); }
+
+  size_t Position() const final { return aiter_.Position(); }
+
+  void Reset() final { aiter_.Reset(); }
+
+  void Seek(size_t a) final { aiter_.Seek(a); }
+
+  uint8_t Flags() const final { return aiter_.Flags(); }
+
+  // Only kArcNoCache is passed on: the mapper may need every arc field of the
+  // input arc to compute any single field of the mapped arc.
+  void SetFlags(uint8_t flags, uint8_t mask) final {
+    aiter_.SetFlags(flags, mask & kArcNoCache);
+  }
+
+ private:
+  const C &mapper_;
+  ArcIterator<Fst<A>> aiter_;
+  mutable B arc_;
+};
+
+template <class A, class B, class C>
+inline void ArcMapViewFst<A, B, C>::InitStateIterator(
+    StateIteratorData<B> *data) const {
+  data->base = std::make_unique<StateIterator<ArcMapViewFst<A, B, C>>>(*this);
+}
+
+template <class A, class B, class C>
+inline void ArcMapViewFst<A, B, C>::InitArcIterator(
+    StateId s, ArcIteratorData<B> *data) const {
+  data->base =
+      std::make_unique<ArcIterator<ArcMapViewFst<A, B, C>>>(*this, s);
+}
+
+// Matcher for ArcMapViewFst, which requires a mapper defining LabelSource().
+// Matching is done by the input FST's matcher on the side carrying the
+// labels of the requested side; matched arcs are then mapped.
+template <class A, class B, class C>
+class ArcMapViewMatcher final : public MatcherBase<B> {
+ public:
+  using FST = ArcMapViewFst<A, B, C>;
+  using Arc = B;
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  // This makes a copy of the FST.
+  ArcMapViewMatcher(const FST &fst, MatchType match_type)
+      : ArcMapViewMatcher(fst.Copy(), match_type) {
+    owned_fst_.reset(&fst_);
+  }
+
+  // This doesn't copy the FST.
+  ArcMapViewMatcher(const FST *fst, MatchType match_type)
+      : fst_(*fst),
+        match_type_(match_type),
+        source_type_(fst_.GetImpl()->LabelSource(match_type)),
+        matcher_(source_type_ == MATCH_NONE
+                     ? nullptr
+                     : new Matcher<Fst<A>>(fst_.GetImpl()->fst_.get(),
+                                           source_type_)) {}
+
+  // This makes a copy of the FST.
+  ArcMapViewMatcher(const ArcMapViewMatcher &matcher, bool safe = false)
+      : ArcMapViewMatcher(matcher.fst_.Copy(safe), matcher.match_type_) {
+    owned_fst_.reset(&fst_);
+  }
+
+  ArcMapViewMatcher *Copy(bool safe = false) const override {
+    return new ArcMapViewMatcher(*this, safe);
+  }
+
+  MatchType Type(bool test) const override {
+    if (!matcher_) return MATCH_NONE;
+    const auto type = matcher_->Type(test);
+    if (type == source_type_) return match_type_;
+    return type == MATCH_NONE ? MATCH_NONE : MATCH_UNKNOWN;
+  }
+
+  void SetState(StateId s) final { matcher_->SetState(s); }
+
+  bool Find(Label label) final { return matcher_->Find(label); }
+
+  bool Done() const final { return matcher_->Done(); }
+
+  // Maps the matched arc. The implicit epsilon self-loop of the input matcher
+  // is returned as the self-loop for the requested side.
+  const Arc &Value() const final {
+    const auto &arc = matcher_->Value();
+    if ((source_type_ == MATCH_INPUT ? arc.ilabel : arc.olabel) == kNoLabel) {
+      arc_ = match_type_ == MATCH_INPUT
+                 ? Arc(kNoLabel, 0, Weight::One(), arc.nextstate)
+                 : Arc(0, kNoLabel, Weight::One(), arc.nextstate);
+    } else {
+      arc_ = fst_.GetImpl()->mapper_(arc);
+    }
+    return arc_;
+  }
+
+  void Next() final { matcher_->Next(); }
+
+  const FST &GetFst() const override { return fst_; }
+
+  uint64_t Properties(uint64_t inprops) const override {
+    if (!matcher_) return inprops | kError;
+    return matcher_->Properties(inprops);
+  }
+
+  uint32_t Flags() const override { return matcher_ ? matcher_->Flags() : 0; }
+
+ private:
+  std::unique_ptr<const FST> owned_fst_;
+  const FST &fst_;
+  const MatchType match_type_;
+  const MatchType source_type_;
+  std::unique_ptr<Matcher<Fst<A>>> matcher_;
+  mutable Arc arc_;
+};
+
+// CTAD deduction guide
+// This allows constructing ArcMapViewFsts without specifying all the types.
+template <class ArcMapper>
+ArcMapViewFst(const Fst<typename ArcMapper::FromArc> &, const ArcMapper &)
+    -> ArcMapViewFst<typename ArcMapper::FromArc, typename ArcMapper::ToArc,
+                     ArcMapper>;
+
 // Utility Mappers.
 
 // Mapper that returns its input.
@@ -689,6 +1129,8 @@ class IdentityArcMapper {
   }
 
   constexpr uint64_t Properties(uint64_t props) const { return props; }
+
+  constexpr MatchType LabelSource(MatchType side) const { return side; }
 };
 
 // Mapper that converts all input symbols to epsilon.
@@ -1317,6 +1759,35 @@ class ReverseWeightMapper {
   constexpr uint64_t Properties(uint64_t props) const { return props; }
 };
 
+// The stateless mappers above are thread-safe.
+
+template <class A>
+struct IsThreadSafeMapper<IdentityArcMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<InputEpsilonMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<OutputEpsilonMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<PlusMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<TimesMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<PowerMapper<A>> : std::true_type {};
+
+template <class A>
+struct IsThreadSafeMapper<InvertWeightMapper<A>> : std::true_type {};
+
+template <class A, class B>
+struct IsThreadSafeMapper<RmWeightMapper<A, B>> : std::true_type {};
+
+template <class A, class B>
+struct IsThreadSafeMapper<QuantizeMapper<A, B>> : std::true_type {};
+
 }  // namespace fst
 
 #endif  // FST_ARC_MAP_H_
@@ -23,22 +23,92 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ostream>
 #include <string>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <fst/log.h>
 #include <fst/arc-map.h>
 #include <fst/arc.h>
 #include <fst/cache.h>
+#include <fst/expanded-fst.h>
 #include <fst/fst.h>
+#include <fst/impl-to-fst.h>
+#include <fst/mapped-file.h>
 #include <fst/mutable-fst.h>
 #include <fst/properties.h>
 #include <fst/state-map.h>
+#include <fst/util.h>
+#include <fst/vector-fst.h>
 
 namespace fst {
 
+template <class Arc>
+class ILabelCompare;
+
+template <class Arc>
+class OLabelCompare;
+
+namespace internal {
+
+// Minimum number of arcs for which ArcSortMapper uses a radix sort with the
+// label comparators; below this, the per-sort histograms cost more than a
+// comparison sort.
+inline constexpr size_t kArcSortRadixThreshold = 128;
+
+// Stably sorts arcs by (ilabel, olabel) if ilabel_first, and o.w. by (olabel,
+// ilabel), as ILabelCompare and OLabelCompare do. This is a least significant
+// byte first radix sort; byte positions in which all labels agree are skipped.
+template <class Arc>
+void RadixSortArcs(std::vector<Arc> *arcs, bool ilabel_first,
+                   std::vector<Arc> *buffer) {
+  using Label = typename Arc::Label;
+  using Key = std::make_unsigned_t<Label>;
+  static constexpr size_t kKeyBytes = sizeof(Label);
+  static constexpr size_t kNumPasses = 2 * kKeyBytes;
+  // Flipping the sign bit orders signed labels as unsigned keys.
+  static constexpr Key kSignBit = Key(1) << (CHAR_BIT * sizeof(Key) - 1);
+  // Passes go through the secondary label's bytes, then the primary label's.
+  const auto digit = [ilabel_first](const Arc &arc, size_t pass) -> uint8_t {
+    const bool primary = pass >= kKeyBytes;
+    const auto label = primary == ilabel_first ? arc.ilabel : arc.olabel;
+    const auto key = static_cast<Key>(label) ^ kSignBit;
+    return static_cast<uint8_t>(key >> (CHAR_BIT * (pass % kKeyBytes)));
+  };
+  std::vector<size_t> counts(kNumPasses * 256, 0);
+  for (const auto &arc : *arcs) {
+    for (size_t pass = 0; pass < kNumPasses; ++pass) {
+      ++counts[pass * 256 + digit(arc, pass)];
+    }
+  }
+  const auto narcs = arcs->size();
+  buffer->resize(narcs);
+  for (size_t pass = 0; pass < kNumPasses; ++pass) {
+    auto *offsets = counts.data() + pass * 256;
+    if (offsets[digit(arcs->front(), pass)] == narcs) continue;
+    size_t offset = 0;
+    for (size_t d = 0; d < 256; ++d) {
+      const auto count = offsets[d];
+      offsets[d] = offset;
+      offset += count;
+    }
+    for (const auto &arc : *arcs) (*buffer)[offsets[digit(arc, pass)]++] = arc;
+    arcs->swap(*buffer);
+  }
+}
+
+}  // namespace internal
+
 template <class Arc, class Compare>
 class ArcSortMapper {
  public:
@@ -67,6 +137,14 @@ class ArcSortMapper {
     for (ArcIterator<Fst<Arc>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
       arcs_.push_back(aiter.Value());
     }
+    if constexpr (std::is_same_v<Compare, ILabelCompare<Arc>> ||
+                  std::is_same_v<Compare, OLabelCompare<Arc>>) {
+      if (arcs_.size() >= internal::kArcSortRadixThreshold) {
+        internal::RadixSortArcs(
+            &arcs_, std::is_same_v<Compare, ILabelCompare<Arc>>, &buffer_);
+        return;
+      }
+    }
     std::stable_sort(arcs_.begin(), arcs_.end(), comp_);
   }
 
@@ -86,11 +164,15 @@ class ArcSortMapper {
   const Fst<Arc> &fst_;
   const Compare &comp_;
   std::vector<Arc> arcs_;
-  ssize_t i_;  // current arc position
+  std::vector<Arc> buffer_;  // Scratch space for radix sorting.
+  ssize_t i_;                // current arc position
 
   ArcSortMapper &operator=(const ArcSortMapper &) = delete;
 };
 
+template <class Arc, class Compare>
+struct IsThreadSafeMapper<ArcSortMapper<Arc, Compare>> : std::true_type {};
+
 // Sorts the arcs in an FST according to function object 'comp' of type Compare.
 // This version modifies its input. Comparison function objects ILabelCompare
 // and OLabelCompare are provided by the library. In general, Compare must meet
@@ -111,6 +193,23 @@ void ArcSort(MutableFst<Arc> *fst, Compare comp) {
   StateMap(fst, mapper);
 }
 
+// Sorts the arcs in a VectorFst according to function object 'comp' of type
+// Compare, as above, partitioning the states across num_threads threads (zero
+// means one per hardware thread).
+//
+// Complexity:
+//
+// - Time: O(v d log d / t)
+// - Space: O(t d)
+//
+// where v = # of states, d = maximum out-degree and t = # of threads.
+template <class Arc, class S, class Compare>
+void ParallelArcSort(VectorFst<Arc, S> *fst, Compare comp,
+                     size_t num_threads = 0) {
+  ArcSortMapper<Arc, Compare> mapper(*fst, comp);
+  ParallelStateMap(fst, &mapper, num_threads);
+}
+
 using ArcSortFstOptions = CacheOptions;
 
 // Sorts the arcs in an FST according to function object 'comp' of type Compare.
@@ -187,6 +286,412 @@ class ArcIterator<ArcSortFst<Arc, Compare>>
                                                                         s) {}
 };
 
+// Identifies stream data as an arc sort permutation.
+inline constexpr int32_t kArcSortPermutationMagicNumber = 1713398537;
+
+// A per-state permutation of the arcs of an expanded FST into the order given
+// by a comparison function object, stored as Index-typed (e.g., 16- or 32-bit)
+// arc positions within each state. This lets ArcSortViewFst present the arcs
+// of a read-only FST in sorted order at a cost of sizeof(Index) bytes per arc
+// plus 8 bytes per state, rather than a copy of the arcs. The permutation can
+// be written to a stream and read back, memory-mapping it if possible.
+template <class Index = uint32_t>
+class ArcSortPermutation {
+ public:
+  static_assert(std::is_unsigned_v<Index>, "Index must be unsigned");
+
+  // Computes the permutation that stably sorts the arcs of each state of 'fst'
+  // according to 'comp'. An error is raised if a state has more arcs than can
+  // be addressed by Index.
+  template <class FST, class Compare>
+  ArcSortPermutation(const FST &fst, const Compare &comp)
+      : nstates_(fst.NumStates()), narcs_(0), error_(false) {
+    using Arc = typename FST::Arc;
+    offsets_region_.reset(MappedFile::AllocateType<uint64_t>(nstates_ + 1));
+    auto *offsets = static_cast<uint64_t *>(offsets_region_->mutable_data());
+    for (size_t s = 0; s < nstates_; ++s) {
+      offsets[s] = narcs_;
+      const auto num_arcs = fst.NumArcs(s);
+      if (num_arcs > static_cast<size_t>(std::numeric_limits<Index>::max()) +
+                         1) {
+        FSTERROR() << "ArcSortPermutation: State " << s << " has " << num_arcs
+                   << " arcs, more than can be indexed by a "
+                   << CHAR_BIT * sizeof(Index) << "-bit index";
+        error_ = true;
+      }
+      narcs_ += num_arcs;
+    }
+    offsets[nstates_] = narcs_;
+    offsets_ = offsets;
+    perm_region_.reset(MappedFile::AllocateType<Index>(narcs_));
+    auto *perms = static_cast<Index *>(perm_region_->mutable_data());
+    perm_ = perms;
+    if (error_) return;
+    std::vector<Arc> arcs;
+    for (size_t s = 0; s < nstates_; ++s) {
+      arcs.clear();
+      for (ArcIterator<FST> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        arcs.push_back(aiter.Value());
+      }
+      auto *perm = perms + offsets[s];
+      std::iota(perm, perm + arcs.size(), Index(0));
+      std::stable_sort(perm, perm + arcs.size(),
+                       [&arcs, &comp](Index lhs, Index rhs) {
+                         return comp(arcs[lhs], arcs[rhs]);
+                       });
+    }
+  }
+
+  // Number of states covered.
+  size_t NumStates() const { return nstates_; }
+
+  // Number of arcs at state s.
+  size_t NumArcs(size_t s) const { return offsets_[s + 1] - offsets_[s]; }
+
+  // Positions of the arcs of state s in the input FST, in sorted order.
+  const Index *Permutation(size_t s) const { return perm_ + offsets_[s]; }
+
+  bool Error() const { return error_; }
+
+  static ArcSortPermutation *Read(std::istream &strm,
+                                  const FstReadOptions &opts) {
+    int32_t magic_number = 0;
+    ReadType(strm, &magic_number);
+    if (magic_number != kArcSortPermutationMagicNumber) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Bad header: " << opts.source;
+      return nullptr;
+    }
+    int32_t index_size = 0;
+    bool aligned = false;
+    auto perm = fst::WrapUnique(new ArcSortPermutation());
+    ReadType(strm, &index_size);
+    ReadType(strm, &perm->nstates_);
+    ReadType(strm, &perm->narcs_);
+    ReadType(strm, &aligned);
+    if (!strm || index_size != sizeof(Index)) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Bad index size: "
+                 << opts.source;
+      return nullptr;
+    }
+    if (perm->nstates_ >=
+            std::numeric_limits<uint64_t>::max() / sizeof(uint64_t) ||
+        perm->narcs_ > std::numeric_limits<uint64_t>::max() / sizeof(Index)) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Bad size: " << opts.source;
+      return nullptr;
+    }
+    if (aligned && !AlignInput(strm)) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Alignment failed: "
+                 << opts.source;
+      return nullptr;
+    }
+    perm->offsets_region_.reset(MappedFile::Map(
+        strm, opts.mode == FstReadOptions::MAP, opts.source,
+        (perm->nstates_ + 1) * sizeof(uint64_t), opts.populate,
+        opts.huge_pages));
+    if (!strm || !perm->offsets_region_) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Read failed: " << opts.source;
+      return nullptr;
+    }
+    perm->offsets_ =
+        static_cast<uint64_t *>(perm->offsets_region_->mutable_data());
+    if (aligned && !AlignInput(strm)) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Alignment failed: "
+                 << opts.source;
+      return nullptr;
+    }
+    perm->perm_region_.reset(MappedFile::Map(
+        strm, opts.mode == FstReadOptions::MAP, opts.source,
+        perm->narcs_ * sizeof(Index), opts.populate, opts.huge_pages));
+    if (!strm || !perm->perm_region_) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Read failed: " << opts.source;
+      return nullptr;
+    }
+    perm->perm_ = static_cast<Index *>(perm->perm_region_->mutable_data());
+    if (!perm->Valid()) {
+      LOG(ERROR) << "ArcSortPermutation::Read: Bad offsets or arc positions: "
+                 << opts.source;
+      return nullptr;
+    }
+    return perm.release();
+  }
+
+  bool Write(std::ostream &strm, const FstWriteOptions &opts) const {
+    WriteType(strm, kArcSortPermutationMagicNumber);
+    WriteType(strm, static_cast<int32_t>(sizeof(Index)));
+    WriteType(strm, nstates_);
+    WriteType(strm, narcs_);
+    WriteType(strm, opts.align);
+    if (opts.align && !AlignOutput(strm)) {
+      LOG(ERROR) << "ArcSortPermutation::Write: Alignment failed: "
+                 << opts.source;
+      return false;
+    }
+    strm.write(reinterpret_cast<const char *>(offsets_),
+               (nstates_ + 1) * sizeof(uint64_t));
+    if (opts.align && !AlignOutput(strm)) {
+      LOG(ERROR) << "ArcSortPermutation::Write: Alignment failed: "
+                 << opts.source;
+      return false;
+    }
+    strm.write(reinterpret_cast<const char *>(perm_), narcs_ * sizeof(Index));
+    strm.flush();
+    if (!strm) {
+      LOG(ERROR) << "ArcSortPermutation::Write: Write failed: " << opts.source;
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  ArcSortPermutation() : nstates_(0), narcs_(0), error_(false) {}
+
+  // Checks that the offsets partition the arcs in order and that each state
+  // permutes arc positions that exist at that state.
+  bool Valid() const {
+    if (offsets_[0] != 0 || offsets_[nstates_] != narcs_) return false;
+    for (size_t s = 0; s < nstates_; ++s) {
+      if (offsets_[s + 1] < offsets_[s]) return false;
+      const auto num_arcs = NumArcs(s);
+      if (num_arcs > static_cast<size_t>(std::numeric_limits<Index>::max()) +
+                         1) {
+        return false;
+      }
+      const auto *perm = Permutation(s);
+      for (size_t i = 0; i < num_arcs; ++i) {
+        if (perm[i] >= num_arcs) return false;
+      }
+    }
+    return true;
+  }
+
+  uint64_t nstates_;
+  uint64_t narcs_;
+  bool error_;
+  std::unique_ptr<MappedFile> offsets_region_;
+  std::unique_ptr<MappedFile> perm_region_;
+  const uint64_t *offsets_ = nullptr;  // nstates_ + 1 arc offsets.
+  const Index *perm_ = nullptr;        // Per-state arc positions.
+};
+
+template <class F, class Compare, class Index>
+class ArcSortViewFst;
+
+namespace internal {
+
+// Implementation of ArcSortViewFst.
+template <class F, class Compare, class Index>
+class ArcSortViewFstImpl : public FstImpl<typename F::Arc> {
+ public:
+  using Arc = typename F::Arc;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using FstImpl<Arc>::SetType;
+  using FstImpl<Arc>::SetProperties;
+  using FstImpl<Arc>::SetInputSymbols;
+  using FstImpl<Arc>::SetOutputSymbols;
+
+  friend class ArcIterator<ArcSortViewFst<F, Compare, Index>>;
+
+  ArcSortViewFstImpl(const F &fst,
+                     std::shared_ptr<const ArcSortPermutation<Index>> perm,
+                     const Compare &comp)
+      : fst_(fst.Copy()), perm_(std::move(perm)) {
+    SetType("arcsort");
+    SetInputSymbols(fst_->InputSymbols());
+    SetOutputSymbols(fst_->OutputSymbols());
+    const auto props = fst_->Properties(kCopyProperties, false);
+    SetProperties(comp.Properties(props));
+    if (perm_->Error() || !Matches()) {
+      FSTERROR() << "ArcSortViewFst: Permutation does not match the FST";
+      SetProperties(kError, kError);
+      // Arcs are then visited in input order.
+      perm_.reset();
+    }
+  }
+
+  ArcSortViewFstImpl(const ArcSortViewFstImpl &impl)
+      : FstImpl<Arc>(impl), fst_(impl.fst_->Copy(true)), perm_(impl.perm_) {}
+
+  StateId Start() const { return fst_->Start(); }
+
+  Weight Final(StateId s) const { return fst_->Final(s); }
+
+  size_t NumArcs(StateId s) const { return fst_->NumArcs(s); }
+
+  size_t NumInputEpsilons(StateId s) const {
+    return fst_->NumInputEpsilons(s);
+  }
+
+  size_t NumOutputEpsilons(StateId s) const {
+    return fst_->NumOutputEpsilons(s);
+  }
+
+  StateId NumStates() const { return fst_->NumStates(); }
+
+  uint64_t Properties() const override { return Properties(kFstProperties); }
+
+  // Sets error if found, and returns other FST impl properties.
+  uint64_t Properties(uint64_t mask) const override {
+    if ((mask & kError) && fst_->Properties(kError, false)) {
+      SetProperties(kError, kError);
+    }
+    return FstImpl<Arc>::Properties(mask);
+  }
+
+  const F &GetFst() const { return *fst_; }
+
+  // Null if the permutation does not match the input FST.
+  const ArcSortPermutation<Index> *GetPermutation() const {
+    return perm_.get();
+  }
+
+ private:
+  // Does the permutation have as many arcs at each state as the input FST?
+  bool Matches() const {
+    if (perm_->NumStates() != static_cast<size_t>(fst_->NumStates())) {
+      return false;
+    }
+    for (StateId s = 0; s < fst_->NumStates(); ++s) {
+      if (perm_->NumArcs(s) != fst_->NumArcs(s)) return false;
+    }
+    return true;
+  }
+
+  std::unique_ptr<const F> fst_;
+  std::shared_ptr<const ArcSortPermutation<Index>> perm_;
+};
+
+}  // namespace internal
+
+// Sorts the arcs in an expanded FST according to function object 'comp' of
+// type Compare. Unlike ArcSortFst, this version copies no arcs: it presents
+// the arcs of the input FST through a precomputed ArcSortPermutation, which
+// may be shared among copies, written out and read back (memory-mapped if
+// possible) alongside the input FST. This suits large read-only FSTs (e.g.,
+// a ConstFst) needed in more than one sort order.
+//
+// Complexity:
+//
+// - Time: O(V d log d) to compute the permutation, O(1) per arc visited.
+// - Space: O(V + E) indices for the permutation.
+//
+// where V = # of states, E = # of arcs and d = maximum out-degree.
+template <class F, class Compare, class Index = uint32_t>
+class ArcSortViewFst
+    : public ImplToExpandedFst<internal::ArcSortViewFstImpl<F, Compare, Index>> {
+ public:
+  using Arc = typename F::Arc;
+  using StateId = typename Arc::StateId;
+
+  using Impl = internal::ArcSortViewFstImpl<F, Compare, Index>;
+  using Permutation = ArcSortPermutation<Index>;
+
+  friend class ArcIterator<ArcSortViewFst<F, Compare, Index>>;
+  friend class StateIterator<ArcSortViewFst<F, Compare, Index>>;
+
+  // Computes the permutation.
+  ArcSortViewFst(const F &fst, const Compare &comp)
+      : ImplToExpandedFst<Impl>(std::make_shared<Impl>(
+            fst, std::make_shared<const Permutation>(fst, comp), comp)) {}
+
+  // Uses a precomputed permutation, which must have been computed for 'fst'
+  // and 'comp'.
+  ArcSortViewFst(const F &fst, std::shared_ptr<const Permutation> perm,
+                 const Compare &comp = Compare())
+      : ImplToExpandedFst<Impl>(
+            std::make_shared<Impl>(fst, std::move(perm), comp)) {}
+
+  // See Fst<>::Copy() for doc.
+  ArcSortViewFst(const ArcSortViewFst &fst, bool safe = false)
+      : ImplToExpandedFst<Impl>(fst, safe) {}
+
+  // Gets a copy of this ArcSortViewFst. See Fst<>::Copy() for further doc.
+  ArcSortViewFst *Copy(bool safe = false) const override {
+    return new ArcSortViewFst(*this, safe);
+  }
+
+  void InitStateIterator(StateIteratorData<Arc> *data) const override {
+    GetImpl()->GetFst().InitStateIterator(data);
+  }
+
+  inline void InitArcIterator(StateId s,
+                              ArcIteratorData<Arc> *data) const override;
+
+  // Null if the permutation does not match the input FST.
+  const Permutation *GetPermutation() const {
+    return GetImpl()->GetPermutation();
+  }
+
+ private:
+  using ImplToFst<Impl, ExpandedFst<Arc>>::GetImpl;
+
+  ArcSortViewFst &operator=(const ArcSortViewFst &) = delete;
+};
+
+// Specialization for ArcSortViewFst.
+template <class F, class Compare, class Index>
+class StateIterator<ArcSortViewFst<F, Compare, Index>>
+    : public StateIterator<F> {
+ public:
+  explicit StateIterator(const ArcSortViewFst<F, Compare, Index> &fst)
+      : StateIterator<F>(fst.GetImpl()->GetFst()) {}
+};
+
+// Specialization for ArcSortViewFst.
+//
+// This may be derived from.
+template <class F, class Compare, class Index>
+class ArcIterator<ArcSortViewFst<F, Compare, Index>>
+    : public ArcIteratorBase<typename F::Arc> {
+ public:
+  using Arc = typename F::Arc;
+  using StateId = typename Arc::StateId;
+
+  ArcIterator(const ArcSortViewFst<F, Compare, Index> &fst, StateId s)
+      : aiter_(fst.GetImpl()->GetFst(), s), perm_(nullptr), narcs_(0), i_(0) {
+    if (const auto *perm = fst.GetImpl()->GetPermutation()) {
+      perm_ = perm->Permutation(s);
+      narcs_ = perm->NumArcs(s);
+    } else {
+      narcs_ = fst.GetImpl()->GetFst().NumArcs(s);
+    }
+  }
+
+  bool Done() const final { return i_ >= narcs_; }
+
+  const Arc &Value() const final {
+    aiter_.Seek(perm_ ? perm_[i_] : i_);
+    return aiter_.Value();
+  }
+
+  void Next() final { ++i_; }
+
+  size_t Position() const final { return i_; }
+
+  void Reset() final { i_ = 0; }
+
+  void Seek(size_t a) final { i_ = a; }
+
+  uint8_t Flags() const final { return kArcValueFlags; }
+
+  void SetFlags(uint8_t, uint8_t) final {}
+
+ private:
+  mutable ArcIterator<F> aiter_;
+  const Index *perm_;  // Null if arcs are visited in input order.
+  size_t narcs_;
+  size_t i_;
+};
+
+template <class F, class Compare, class Index>
+inline void ArcSortViewFst<F, Compare, Index>::InitArcIterator(
+    StateId s, ArcIteratorData<Arc> *data) const {
+  data->base =
+      std::make_unique<ArcIterator<ArcSortViewFst<F, Compare, Index>>>(*this,
+                                                                      s);
+}
+
 // Compare class for comparing input labels of arcs.
 template <class Arc>
 class ILabelCompare {
@@ -27,6 +27,7 @@
 #include <list>
 #include <memory>
 #include <new>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -47,35 +48,68 @@ DECLARE_int64(fst_default_cache_gc_limit);
 namespace fst {
 
 // Options for controlling caching behavior; higher level than CacheImplOptions.
+//
+// If an arena is given, the cached states and arcs are allocated from it (by
+// cache stores whose state allocator supports arenas, as the default one does)
+// and are only released when the caller resets the arena. This makes the cache
+// of a delayed FST built for each utterance of a decoding loop essentially free
+// to allocate and to release: reset the arena once the FST has been destroyed.
+// GC then bounds the number of cached states but returns no memory. The arena
+// is not owned, and is not passed on to thread-safe copies of the FST.
 struct CacheOptions {
-  bool gc;          // Enables GC.
-  size_t gc_limit;  // Number of bytes allowed before GC.
+  bool gc;                 // Enables GC.
+  size_t gc_limit;         // Number of bytes allowed before GC.
+  ResettableArena *arena;  // Arena for states and arcs (not owned) or null.
 
   explicit CacheOptions(
       bool gc = FST_FLAGS_fst_default_cache_gc,
-      size_t gc_limit = FST_FLAGS_fst_default_cache_gc_limit)
-      : gc(gc), gc_limit(gc_limit) {}
+      size_t gc_limit = FST_FLAGS_fst_default_cache_gc_limit,
+      ResettableArena *arena = nullptr)
+      : gc(gc), gc_limit(gc_limit), arena(arena) {}
 };
 
 // Options for controlling caching behavior, at a lower level than
 // CacheOptions; templated on the cache store and allows passing the store.
 template <class CacheStore>
 struct CacheImplOptions {
-  bool gc;            // Enables GC.
-  size_t gc_limit;    // Number of bytes allowed before GC.
-  CacheStore *store;  // Cache store.
-  bool own_store;     // Should CacheImpl takes ownership of the store?
+  bool gc;                 // Enables GC.
+  size_t gc_limit;         // Number of bytes allowed before GC.
+  CacheStore *store;       // Cache store.
+  bool own_store;          // Should CacheImpl takes ownership of the store?
+  ResettableArena *arena;  // Arena for a new store (see CacheOptions) or null.
 
   explicit CacheImplOptions(
       bool gc = FST_FLAGS_fst_default_cache_gc,
       size_t gc_limit = FST_FLAGS_fst_default_cache_gc_limit,
-      CacheStore *store = nullptr)
-      : gc(gc), gc_limit(gc_limit), store(store), own_store(true) {}
+      CacheStore *store = nullptr, ResettableArena *arena = nullptr)
+      : gc(gc),
+        gc_limit(gc_limit),
+        store(store),
+        own_store(true),
+        arena(arena) {}
 
   explicit CacheImplOptions(const CacheOptions &opts)
-      : gc(opts.gc), gc_limit(opts.gc_limit), store(nullptr), own_store(true) {}
+      : gc(opts.gc),
+        gc_limit(opts.gc_limit),
+        store(nullptr),
+        own_store(true),
+        arena(opts.arena) {}
 };
 
+namespace internal {
+
+// Returns a cache store allocator drawing from the arena, if any and if the
+// allocator type supports it.
+template <class Allocator>
+Allocator MakeCacheAllocator(ResettableArena *arena) {
+  if constexpr (std::is_constructible_v<Allocator, ResettableArena *>) {
+    if (arena) return Allocator(arena);
+  }
+  return Allocator();
+}
+
+}  // namespace internal
+
 // Cache flags.
 inline constexpr uint8_t kCacheFinal = 0x01;   // Final weight has been cached.
 inline constexpr uint8_t kCacheArcs = 0x02;    // Arcs have been cached.
@@ -316,7 +350,12 @@ class VectorCacheStore {
   using StateList = std::list<StateId, PoolAllocator<StateId>>;
 
   // Required constructors/assignment operators.
-  explicit VectorCacheStore(const CacheOptions &opts) : cache_gc_(opts.gc) {
+  explicit VectorCacheStore(const CacheOptions &opts)
+      : cache_gc_(opts.gc),
+        state_alloc_(internal::MakeCacheAllocator<
+                     typename State::StateAllocator>(opts.arena)),
+        arc_alloc_(internal::MakeCacheAllocator<typename State::ArcAllocator>(
+            opts.arena)) {
     Clear();
     Reset();
   }
@@ -443,7 +482,11 @@ class HashCacheStore {
                           PoolAllocator<std::pair<const StateId, State *>>>;
 
   // Required constructors/assignment operators.
-  explicit HashCacheStore(const CacheOptions &opts) {
+  explicit HashCacheStore(const CacheOptions &opts)
+      : state_alloc_(internal::MakeCacheAllocator<
+                     typename State::StateAllocator>(opts.arena)),
+        arc_alloc_(internal::MakeCacheAllocator<typename State::ArcAllocator>(
+            opts.arena)) {
     Clear();
     Reset();
   }
@@ -887,12 +930,14 @@ class CacheBaseImpl : public FstImpl<typename State::Arc> {
         cache_limit_(opts.gc_limit),
         cache_store_(
             opts.store ? opts.store
-                       : new CacheStore(CacheOptions(opts.gc, opts.gc_limit))),
+                       : new CacheStore(CacheOptions(opts.gc, opts.gc_limit,
+                                                     opts.arena))),
         new_cache_store_(!opts.store),
         own_cache_store_(opts.store ? opts.own_store : true) {}
 
   // Preserve gc parameters. If preserve_cache is true, also preserves
-  // cache data.
+  // cache data. The arena, if any, is not used by the copy, which may be
+  // accessed from another thread.
   CacheBaseImpl(const CacheBaseImpl<State, CacheStore> &impl,
                 bool preserve_cache = false)
       : FstImpl<Arc>(),
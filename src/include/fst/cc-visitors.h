@@ -20,10 +20,21 @@
 #ifndef FST_CC_VISITORS_H_
 #define FST_CC_VISITORS_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <fst/arcfilter.h>
+#include <fst/dfs-visit.h>
 #include <fst/fst.h>
+#include <fst/parallel.h>
+#include <fst/properties.h>
 #include <fst/union-find.h>
 
 namespace fst {
@@ -261,6 +272,602 @@ inline void SccVisitor<Arc>::FinishState(StateId s, StateId p, const Arc *) {
   }
 }
 
+namespace internal {
+
+// Adjacency lists of the states of an FST restricted to the arcs accepted by
+// a filter, stored contiguously. The reverse graph lists, for each state, the
+// sources of the arcs entering it. Built on num_threads threads (zero means
+// one per hardware thread).
+template <class StateId>
+class StateGraph {
+ public:
+  template <class Arc, class ArcFilter>
+  StateGraph(const Fst<Arc> &fst, size_t nstates, bool reverse,
+             ArcFilter filter, size_t num_threads)
+      : nstates_(nstates),
+        ends_(std::make_unique<std::atomic<size_t>[]>(nstates + 1)) {
+    num_threads = NumWorkerThreads(num_threads);
+    std::vector<std::unique_ptr<const Fst<Arc>>> fsts(num_threads);
+    for (auto &copy : fsts) copy.reset(fst.Copy(true));
+    const std::vector<ArcFilter> filters(num_threads, filter);
+    Build(reverse, num_threads,
+          [&fsts, &filters](size_t block, StateId s, auto add) {
+            ArcIterator<Fst<Arc>> aiter(*fsts[block], s);
+            if constexpr (std::is_same_v<ArcFilter, AnyArcFilter<Arc>>) {
+              aiter.SetFlags(kArcNextStateValue, kArcValueFlags);
+            }
+            for (; !aiter.Done(); aiter.Next()) {
+              const auto &arc = aiter.Value();
+              if (filters[block](arc)) add(arc.nextstate);
+            }
+          });
+  }
+
+  // Constructs the reverse of a graph.
+  StateGraph(const StateGraph &graph, size_t num_threads)
+      : nstates_(graph.NumStates()),
+        ends_(std::make_unique<std::atomic<size_t>[]>(nstates_ + 1)) {
+    Build(/*reverse=*/true, NumWorkerThreads(num_threads),
+          [&graph](size_t, StateId s, auto add) {
+            for (auto *t = graph.Begin(s); t != graph.End(s); ++t) add(*t);
+          });
+  }
+
+  size_t NumStates() const { return nstates_; }
+
+  const StateId *Begin(StateId s) const {
+    return states_.data() +
+           (s == 0 ? 0 : ends_[s - 1].load(std::memory_order_relaxed));
+  }
+
+  const StateId *End(StateId s) const {
+    return states_.data() + ends_[s].load(std::memory_order_relaxed);
+  }
+
+  size_t Degree(StateId s) const { return End(s) - Begin(s); }
+
+ private:
+  // Lists the destinations of the arcs of each state or, if reverse, the
+  // sources of the arcs entering it, where for_each_arc(block, s, add) calls
+  // add(t) for each arc from s to t. After counting, ends_[s] is the start of
+  // the list of state s; filling the lists in advances it to their end.
+  template <class ForEachArc>
+  void Build(bool reverse, size_t num_threads, ForEachArc for_each_arc) {
+    ends_[0] = 0;
+    if (reverse) {
+      for (size_t s = 1; s <= nstates_; ++s) ends_[s] = 0;
+      ParallelFor(nstates_, num_threads,
+                  [this, &for_each_arc](size_t block, size_t begin,
+                                        size_t end) {
+                    for (auto s = begin; s < end; ++s) {
+                      for_each_arc(block, s, [this](StateId t) {
+                        ends_[t + 1].fetch_add(1, std::memory_order_relaxed);
+                      });
+                    }
+                  });
+    } else {
+      ParallelFor(nstates_, num_threads,
+                  [this, &for_each_arc](size_t block, size_t begin,
+                                        size_t end) {
+                    for (auto s = begin; s < end; ++s) {
+                      size_t narcs = 0;
+                      for_each_arc(block, s, [&narcs](StateId) { ++narcs; });
+                      ends_[s + 1].store(narcs, std::memory_order_relaxed);
+                    }
+                  });
+    }
+    for (size_t s = 1; s <= nstates_; ++s) ends_[s] += ends_[s - 1];
+    states_.resize(ends_[nstates_]);
+    ParallelFor(nstates_, num_threads,
+                [this, reverse, &for_each_arc](size_t block, size_t begin,
+                                               size_t end) {
+                  for (auto s = begin; s < end; ++s) {
+                    if (reverse) {
+                      for_each_arc(block, s, [this, s](StateId t) {
+                        states_[ends_[t].fetch_add(
+                            1, std::memory_order_relaxed)] = s;
+                      });
+                    } else {
+                      auto pos = ends_[s].load(std::memory_order_relaxed);
+                      for_each_arc(block, s, [this, &pos](StateId t) {
+                        states_[pos++] = t;
+                      });
+                      ends_[s].store(pos, std::memory_order_relaxed);
+                    }
+                  }
+                });
+  }
+
+  size_t nstates_;
+  std::unique_ptr<std::atomic<size_t>[]> ends_;
+  std::vector<StateId> states_;
+};
+
+// Remainders with fewer states than this are decomposed by a serial Tarjan
+// search.
+inline constexpr size_t kMinParallelSccStates = 1 << 14;
+
+// Finds the strongly-connected components of a state graph, given with its
+// reverse, following Slota et al., "BFS and Coloring-based Parallel
+// Algorithms for Strongly Connected Components and Related Problems", IPDPS
+// 2014. States left without entering or leaving arcs are repeatedly trimmed
+// as singleton components; a forward-backward search from a high-degree
+// pivot removes the (typically giant) component containing it; coloring
+// rounds, each propagating the largest state label forward and collecting
+// each label's component by a backward search from its origin, remove the
+// rest until the remainder is small enough for a serial Tarjan search.
+template <class StateId>
+class ParallelSccFinder {
+ public:
+  ParallelSccFinder(const StateGraph<StateId> &graph,
+                    const StateGraph<StateId> &rgraph, size_t num_threads)
+      : graph_(graph),
+        rgraph_(rgraph),
+        nstates_(graph.NumStates()),
+        num_threads_(NumWorkerThreads(num_threads)),
+        removed_(nstates_),
+        comp_(nstates_, kNoStateId),
+        indegree_(std::make_unique<std::atomic<size_t>[]>(nstates_)),
+        outdegree_(std::make_unique<std::atomic<size_t>[]>(nstates_)) {}
+
+  // Computes scc[s], the SCC number of each state s. SCCs are numbered in
+  // topological order, level by level of the condensation and by
+  // representative state within a level. Returns the number of SCCs.
+  StateId Find(std::vector<StateId> *scc);
+
+  // Whether any state is on a cycle; valid after Find().
+  bool Cyclic() const { return cyclic_; }
+
+  // Whether state s is on a cycle; valid after Find().
+  bool OnCycle(StateId s) const {
+    return size_[comp_[s]] > 1 ||
+           std::find(graph_.Begin(s), graph_.End(s), s) != graph_.End(s);
+  }
+
+ private:
+  // Returns the states in 'states' for which pred() holds, in order.
+  template <class Predicate>
+  std::vector<StateId> Select(const std::vector<StateId> &states,
+                              Predicate pred) const;
+
+  // Trims the states left without entering or leaving arcs once 'states',
+  // which must be marked removed, are gone.
+  void Trim(std::vector<StateId> states);
+
+  // Returns the states in 'states' not yet removed; removed states without a
+  // component are trimmed singletons.
+  std::vector<StateId> Remaining(const std::vector<StateId> &states);
+
+  // Removes the component of the state in 'states' with the most remaining
+  // entering and leaving arcs.
+  void ForwardBackward(const std::vector<StateId> &states);
+
+  // Removes the components found by a coloring round over 'states'.
+  void Color(const std::vector<StateId> &states);
+
+  // Removes the components of 'states' serially.
+  void Tarjan(const std::vector<StateId> &states);
+
+  // Numbers the components in topological order.
+  StateId Number(std::vector<StateId> *scc);
+
+  const StateGraph<StateId> &graph_;
+  const StateGraph<StateId> &rgraph_;
+  const size_t nstates_;
+  const size_t num_threads_;
+  AtomicBitVector removed_;
+  std::vector<StateId> comp_;  // Representative state of each state's SCC.
+  std::vector<StateId> size_;  // SCC size, by representative state.
+  // Remaining entering and leaving arcs of each state.
+  std::unique_ptr<std::atomic<size_t>[]> indegree_;
+  std::unique_ptr<std::atomic<size_t>[]> outdegree_;
+  std::unique_ptr<std::atomic<StateId>[]> color_;
+  bool cyclic_ = false;
+};
+
+template <class StateId>
+StateId ParallelSccFinder<StateId>::Find(std::vector<StateId> *scc) {
+  std::vector<StateId> states(nstates_);
+  std::iota(states.begin(), states.end(), 0);
+  ParallelFor(nstates_, num_threads_,
+              [this](size_t, size_t begin, size_t end) {
+                for (auto s = begin; s < end; ++s) {
+                  indegree_[s] = rgraph_.Degree(s);
+                  outdegree_[s] = graph_.Degree(s);
+                }
+              });
+  Trim(Select(states, [this](StateId s) {
+    return (indegree_[s] == 0 || outdegree_[s] == 0) && removed_.TestAndSet(s);
+  }));
+  states = Remaining(states);
+  if (states.size() >= kMinParallelSccStates) {
+    ForwardBackward(states);
+    states = Remaining(states);
+  }
+  while (states.size() >= kMinParallelSccStates) {
+    const auto nremaining = states.size();
+    Color(states);
+    states = Remaining(states);
+    // Long chains of components take a coloring round each.
+    if (states.size() > nremaining - nremaining / 16) break;
+  }
+  Tarjan(states);
+  return Number(scc);
+}
+
+template <class StateId>
+template <class Predicate>
+std::vector<StateId> ParallelSccFinder<StateId>::Select(
+    const std::vector<StateId> &states, Predicate pred) const {
+  std::vector<std::vector<StateId>> selected(num_threads_);
+  const auto nblocks = ParallelFor(
+      states.size(), states.size() < kMinParallelFrontier ? 1 : num_threads_,
+      [&states, &selected, &pred](size_t block, size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+          if (pred(states[i])) selected[block].push_back(states[i]);
+        }
+      });
+  for (size_t block = 1; block < nblocks; ++block) {
+    selected[0].insert(selected[0].end(), selected[block].begin(),
+                       selected[block].end());
+  }
+  return std::move(selected[0]);
+}
+
+template <class StateId>
+void ParallelSccFinder<StateId>::Trim(std::vector<StateId> states) {
+  ParallelBfs<StateId>(
+      std::move(states), &removed_, num_threads_,
+      [this](size_t, StateId s, auto visit) {
+        for (auto *t = graph_.Begin(s); t != graph_.End(s); ++t) {
+          if (indegree_[*t].fetch_sub(1, std::memory_order_relaxed) == 1) {
+            visit(*t);
+          }
+        }
+        for (auto *t = rgraph_.Begin(s); t != rgraph_.End(s); ++t) {
+          if (outdegree_[*t].fetch_sub(1, std::memory_order_relaxed) == 1) {
+            visit(*t);
+          }
+        }
+      });
+}
+
+template <class StateId>
+std::vector<StateId> ParallelSccFinder<StateId>::Remaining(
+    const std::vector<StateId> &states) {
+  return Select(states, [this](StateId s) {
+    if (!removed_.Get(s)) return true;
+    if (comp_[s] == kNoStateId) comp_[s] = s;
+    return false;
+  });
+}
+
+template <class StateId>
+void ParallelSccFinder<StateId>::ForwardBackward(
+    const std::vector<StateId> &states) {
+  auto pivot = states.front();
+  size_t max_degree = 0;
+  for (const auto s : states) {
+    const auto degree = indegree_[s] * outdegree_[s];
+    if (degree > max_degree) {
+      pivot = s;
+      max_degree = degree;
+    }
+  }
+  AtomicBitVector reached(nstates_);
+  AtomicBitVector reaching(nstates_);
+  reached.TestAndSet(pivot);
+  reaching.TestAndSet(pivot);
+  const auto search = [this, pivot](const StateGraph<StateId> &graph,
+                                    AtomicBitVector *visited,
+                                    size_t num_threads) {
+    ParallelBfs<StateId>({pivot}, visited, num_threads,
+                         [this, &graph](size_t, StateId s, auto visit) {
+                           for (auto *t = graph.Begin(s); t != graph.End(s);
+                                ++t) {
+                             if (!removed_.Get(*t)) visit(*t);
+                           }
+                         });
+  };
+  // The two searches run concurrently, each on half of the threads.
+  const auto forward_threads = std::max<size_t>(num_threads_ / 2, 1);
+  const auto backward_threads =
+      std::max<size_t>(num_threads_ - forward_threads, 1);
+  ParallelFor(2, num_threads_ > 1 ? 2 : 1,
+              [&](size_t, size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                  if (i == 0) {
+                    search(graph_, &reached, forward_threads);
+                  } else {
+                    search(rgraph_, &reaching, backward_threads);
+                  }
+                }
+              });
+  Trim(Select(states, [this, pivot, &reached, &reaching](StateId s) {
+    if (!reached.Get(s) || !reaching.Get(s)) return false;
+    removed_.TestAndSet(s);
+    comp_[s] = pivot;
+    return true;
+  }));
+}
+
+template <class StateId>
+void ParallelSccFinder<StateId>::Color(const std::vector<StateId> &states) {
+  if (!color_) color_ = std::make_unique<std::atomic<StateId>[]>(nstates_);
+  ParallelFor(states.size(), num_threads_,
+              [this, &states](size_t, size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                  color_[states[i]].store(states[i],
+                                          std::memory_order_relaxed);
+                }
+              });
+  // Propagates the largest color forward until no color changes; a state
+  // whose color grows is queued once for the next pass.
+  AtomicBitVector queued(nstates_);
+  std::vector<std::vector<StateId>> next(num_threads_);
+  auto frontier = states;
+  while (!frontier.empty()) {
+    const auto nblocks = ParallelFor(
+        frontier.size(),
+        frontier.size() < kMinParallelFrontier ? 1 : num_threads_,
+        [this, &frontier, &next, &queued](size_t block, size_t begin,
+                                          size_t end) {
+          auto &changed = next[block];
+          changed.clear();
+          for (auto i = begin; i < end; ++i) {
+            const auto s = frontier[i];
+            const auto color = color_[s].load(std::memory_order_relaxed);
+            for (auto *t = graph_.Begin(s); t != graph_.End(s); ++t) {
+              if (removed_.Get(*t)) continue;
+              auto tcolor = color_[*t].load(std::memory_order_relaxed);
+              while (tcolor < color) {
+                if (color_[*t].compare_exchange_weak(
+                        tcolor, color, std::memory_order_relaxed)) {
+                  if (queued.TestAndSet(*t)) changed.push_back(*t);
+                  break;
+                }
+              }
+            }
+          }
+        });
+    frontier.clear();
+    for (size_t block = 0; block < nblocks; ++block) {
+      frontier.insert(frontier.end(), next[block].begin(), next[block].end());
+    }
+    for (const auto s : frontier) queued.Clear(s);
+  }
+  // The component of each state keeping its own color is the set of states
+  // of that color reaching it.
+  ParallelBfs<StateId>(
+      Select(states,
+             [this](StateId s) {
+               return color_[s].load(std::memory_order_relaxed) == s &&
+                      removed_.TestAndSet(s);
+             }),
+      &removed_, num_threads_, [this](size_t, StateId s, auto visit) {
+        const auto color = color_[s].load(std::memory_order_relaxed);
+        for (auto *t = rgraph_.Begin(s); t != rgraph_.End(s); ++t) {
+          if (color_[*t].load(std::memory_order_relaxed) == color) visit(*t);
+        }
+      });
+  Trim(Select(states, [this](StateId s) {
+    if (!removed_.Get(s) || comp_[s] != kNoStateId) return false;
+    comp_[s] = color_[s].load(std::memory_order_relaxed);
+    return true;
+  }));
+}
+
+template <class StateId>
+void ParallelSccFinder<StateId>::Tarjan(const std::vector<StateId> &states) {
+  if (states.empty()) return;
+  std::vector<StateId> dfnumber(nstates_, kNoStateId);
+  std::vector<StateId> lowlink(nstates_);
+  std::vector<bool> onstack(nstates_);
+  std::vector<StateId> scc_stack;
+  // DFS stack of states with their next arcs.
+  std::vector<std::pair<StateId, const StateId *>> dfs_stack;
+  StateId nvisited = 0;
+  const auto discover = [&](StateId s) {
+    dfnumber[s] = lowlink[s] = nvisited++;
+    scc_stack.push_back(s);
+    onstack[s] = true;
+    dfs_stack.emplace_back(s, graph_.Begin(s));
+  };
+  for (const auto root : states) {
+    if (dfnumber[root] != kNoStateId) continue;
+    discover(root);
+    while (!dfs_stack.empty()) {
+      const auto s = dfs_stack.back().first;
+      if (dfs_stack.back().second != graph_.End(s)) {
+        const auto t = *dfs_stack.back().second++;
+        if (removed_.Get(t)) continue;
+        if (dfnumber[t] == kNoStateId) {
+          discover(t);
+        } else if (onstack[t] && dfnumber[t] < lowlink[s]) {
+          lowlink[s] = dfnumber[t];
+        }
+        continue;
+      }
+      dfs_stack.pop_back();
+      if (!dfs_stack.empty()) {
+        const auto p = dfs_stack.back().first;
+        if (lowlink[s] < lowlink[p]) lowlink[p] = lowlink[s];
+      }
+      if (lowlink[s] == dfnumber[s]) {
+        StateId t;
+        do {
+          t = scc_stack.back();
+          scc_stack.pop_back();
+          onstack[t] = false;
+          comp_[t] = s;
+        } while (t != s);
+      }
+    }
+  }
+}
+
+template <class StateId>
+StateId ParallelSccFinder<StateId>::Number(std::vector<StateId> *scc) {
+  // Groups the states by component.
+  std::vector<size_t> offsets(nstates_ + 1, 0);
+  for (size_t s = 0; s < nstates_; ++s) ++offsets[comp_[s] + 1];
+  size_.resize(nstates_);
+  for (size_t s = 0; s < nstates_; ++s) {
+    size_[s] = offsets[s + 1];
+    offsets[s + 1] += offsets[s];
+  }
+  std::vector<StateId> members(nstates_);
+  {
+    std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+    for (size_t s = 0; s < nstates_; ++s) members[pos[comp_[s]]++] = s;
+  }
+  // Counts the arcs entering each component from other components.
+  std::atomic<bool> self_loop(false);
+  for (size_t s = 0; s < nstates_; ++s) indegree_[s] = 0;
+  ParallelFor(nstates_, num_threads_,
+              [this, &self_loop](size_t, size_t begin, size_t end) {
+                for (auto s = begin; s < end; ++s) {
+                  for (auto *t = graph_.Begin(s); t != graph_.End(s); ++t) {
+                    if (comp_[*t] != comp_[s]) {
+                      indegree_[comp_[*t]].fetch_add(
+                          1, std::memory_order_relaxed);
+                    } else if (*t == s) {
+                      self_loop.store(true, std::memory_order_relaxed);
+                    }
+                  }
+                }
+              });
+  cyclic_ = self_loop;
+  std::vector<StateId> frontier;
+  for (size_t s = 0; s < nstates_; ++s) {
+    if (size_[s] > 1) cyclic_ = true;
+    if (comp_[s] == s && indegree_[s] == 0) frontier.push_back(s);
+  }
+  // Numbers the components by a breadth-first topological sort of the
+  // condensation.
+  std::vector<StateId> number(nstates_, kNoStateId);
+  std::vector<std::vector<StateId>> next(num_threads_);
+  StateId nscc = 0;
+  while (!frontier.empty()) {
+    for (const auto c : frontier) number[c] = nscc++;
+    const auto nblocks = ParallelFor(
+        frontier.size(),
+        frontier.size() < kMinParallelFrontier ? 1 : num_threads_,
+        [this, &frontier, &next, &offsets, &members](size_t block,
+                                                     size_t begin,
+                                                     size_t end) {
+          auto &ready = next[block];
+          ready.clear();
+          for (auto i = begin; i < end; ++i) {
+            const auto c = frontier[i];
+            for (auto j = offsets[c]; j < offsets[c + 1]; ++j) {
+              const auto s = members[j];
+              for (auto *t = graph_.Begin(s); t != graph_.End(s); ++t) {
+                const auto d = comp_[*t];
+                if (d != c &&
+                    indegree_[d].fetch_sub(1, std::memory_order_relaxed) ==
+                        1) {
+                  ready.push_back(d);
+                }
+              }
+            }
+          }
+        });
+    frontier.clear();
+    for (size_t block = 0; block < nblocks; ++block) {
+      frontier.insert(frontier.end(), next[block].begin(), next[block].end());
+    }
+    std::sort(frontier.begin(), frontier.end());
+  }
+  scc->resize(nstates_);
+  for (size_t s = 0; s < nstates_; ++s) (*scc)[s] = number[comp_[s]];
+  return nscc;
+}
+
+}  // namespace internal
+
+// Computes the strongly-connected components, accessible and coaccessible
+// states and property bits as SccVisitor with DfsVisit does, but with
+// parallel breadth-first searches over an index of the arcs accepted by the
+// filter, on num_threads threads (zero means one per hardware thread); see
+// internal::ParallelSccFinder. The SCC numbers are in topological order but
+// may differ from SccVisitor's. FSTs without a known number of states are
+// visited serially.
+//
+// Complexity:
+//
+//   Time:  O(V + E) per coloring round, of which there are few unless the
+//          condensation has long paths of nontrivial components
+//   Space: O(V + E)
+//
+// where V = # of states and E = # of arcs.
+template <class Arc, class ArcFilter = AnyArcFilter<Arc>>
+void ParallelScc(const Fst<Arc> &fst, std::vector<typename Arc::StateId> *scc,
+                 std::vector<bool> *access, std::vector<bool> *coaccess,
+                 uint64_t *props, ArcFilter filter = ArcFilter(),
+                 size_t num_threads = 0) {
+  using StateId = typename Arc::StateId;
+  const auto nstates = fst.NumStatesIfKnown();
+  if (!nstates) {
+    SccVisitor<Arc> scc_visitor(scc, access, coaccess, props);
+    DfsVisit(fst, &scc_visitor, filter);
+    return;
+  }
+  if (scc) scc->clear();
+  if (access) access->clear();
+  if (coaccess) coaccess->clear();
+  *props |= kAcyclic | kInitialAcyclic | kAccessible | kCoAccessible;
+  *props &= ~(kCyclic | kInitialCyclic | kNotAccessible | kNotCoAccessible);
+  const auto start = fst.Start();
+  if (start == kNoStateId) return;
+  const internal::StateGraph<StateId> graph(fst, *nstates, false, filter,
+                                            num_threads);
+  const internal::StateGraph<StateId> rgraph(graph, num_threads);
+  std::vector<StateId> sccs;
+  internal::ParallelSccFinder<StateId> finder(graph, rgraph, num_threads);
+  finder.Find(scc ? scc : &sccs);
+  if (finder.Cyclic()) {
+    *props |= kCyclic;
+    *props &= ~kAcyclic;
+  }
+  if (finder.OnCycle(start)) {
+    *props |= kInitialCyclic;
+    *props &= ~kInitialAcyclic;
+  }
+  const auto search = [num_threads](std::vector<StateId> states,
+                                    const internal::StateGraph<StateId> &graph,
+                                    internal::AtomicBitVector *visited) {
+    for (const auto s : states) visited->TestAndSet(s);
+    internal::ParallelBfs<StateId>(
+        std::move(states), visited, num_threads,
+        [&graph](size_t, StateId s, auto visit) {
+          for (auto *t = graph.Begin(s); t != graph.End(s); ++t) visit(*t);
+        });
+  };
+  internal::AtomicBitVector accessible(*nstates);
+  search({start}, graph, &accessible);
+  internal::AtomicBitVector coaccessible(*nstates);
+  std::vector<StateId> finals;
+  for (StateId s = 0; s < *nstates; ++s) {
+    if (fst.Final(s) != Arc::Weight::Zero()) finals.push_back(s);
+  }
+  search(std::move(finals), rgraph, &coaccessible);
+  if (access) access->resize(*nstates);
+  if (coaccess) coaccess->resize(*nstates);
+  for (StateId s = 0; s < *nstates; ++s) {
+    if (access) (*access)[s] = accessible.Get(s);
+    if (coaccess) (*coaccess)[s] = coaccessible.Get(s);
+    if (!accessible.Get(s)) {
+      *props |= kNotAccessible;
+      *props &= ~kAccessible;
+    }
+    if (!coaccessible.Get(s)) {
+      *props |= kNotCoAccessible;
+      *props &= ~kCoAccessible;
+    }
+  }
+}
+
 }  // namespace fst
 
 #endif  // FST_CC_VISITORS_H_
@@ -23,6 +23,8 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
+#include <array>
 #include <climits>
 #include <cstddef>
 #include <cstdint>
@@ -253,6 +255,13 @@ class CompactArcStore {
   CompactArcStore(const Iterator begin, const Iterator end,
                   const ArcCompactor &arc_compactor);
 
+  // Constructs a view of the ncompacts compacted transitions at compacts, for
+  // a fixed out-degree arc compactor, starting with the initial state. The
+  // transitions are not copied; they must lie in region, which is shared.
+  template <class ArcCompactor>
+  CompactArcStore(std::shared_ptr<MappedFile> region, const Element *compacts,
+                  size_t ncompacts, const ArcCompactor &arc_compactor);
+
   ~CompactArcStore() = default;
 
   template <class ArcCompactor>
@@ -283,10 +292,24 @@ class CompactArcStore {
 
   bool Error() const { return error_; }
 
+  // Notes an access to state s, when read out-of-core.
+  void Touch(ssize_t s) const {
+    if (chunk_cache_) chunk_cache_->Touch(s);
+  }
+
+  // Returns the chunk cache when read with FstReadOptions::chunk_states from a
+  // mapped file, and nullptr otherwise.
+  const MappedChunkCache *GetChunkCache() const { return chunk_cache_.get(); }
+
   // Returns a string identifying the type of data storage container.
   static const std::string &Type();
 
  private:
+  // Keeps only chunks of chunk_states states and their compacts resident, when
+  // either is mapped; fixed_size is the arc compactor size.
+  void InitChunkCache(size_t chunk_states, size_t max_chunks,
+                      bool count_accesses, ssize_t fixed_size);
+
   std::shared_ptr<MappedFile> states_region_;
   std::shared_ptr<MappedFile> compacts_region_;
   // Unowned pointer into states_region_.
@@ -298,6 +321,8 @@ class CompactArcStore {
   size_t narcs_ = 0;
   ssize_t start_ = kNoStateId;
   bool error_ = false;
+  // Resident chunks, if any; shared by copies.
+  std::shared_ptr<MappedChunkCache> chunk_cache_;
 };
 
 template <class Element, class Unsigned>
@@ -444,6 +469,27 @@ CompactArcStore<Element, Unsigned>::CompactArcStore(
   }
 }
 
+template <class Element, class Unsigned>
+template <class ArcCompactor>
+CompactArcStore<Element, Unsigned>::CompactArcStore(
+    std::shared_ptr<MappedFile> region, const Element *compacts,
+    size_t ncompacts, const ArcCompactor &arc_compactor)
+    : compacts_region_(std::move(region)),
+      compacts_(const_cast<Element *>(compacts)),
+      ncompacts_(ncompacts) {
+  if (arc_compactor.Size() == -1 || ncompacts_ % arc_compactor.Size()) {
+    FSTERROR() << "CompactArcStore: Size of compacts incompatible with arc "
+               << "compactor";
+    error_ = true;
+    return;
+  }
+  nstates_ = ncompacts_ / arc_compactor.Size();
+  if (nstates_ > 0) start_ = 0;
+  for (size_t i = 0; i < ncompacts_; ++i) {
+    if (arc_compactor.Expand(i, compacts_[i]).ilabel != kNoLabel) ++narcs_;
+  }
+}
+
 template <class Element, class Unsigned>
 template <class ArcCompactor>
 CompactArcStore<Element, Unsigned> *CompactArcStore<Element, Unsigned>::Read(
@@ -459,8 +505,9 @@ CompactArcStore<Element, Unsigned> *CompactArcStore<Element, Unsigned>::Read(
       return nullptr;
     }
     auto b = (data->nstates_ + 1) * sizeof(Unsigned);
-    data->states_region_.reset(MappedFile::Map(
-        strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+    data->states_region_.reset(
+        MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source,
+                        b, opts.populate, opts.huge_pages));
     if (!strm || !data->states_region_) {
       LOG(ERROR) << "CompactArcStore::Read: Read failed: " << opts.source;
       return nullptr;
@@ -479,16 +526,61 @@ CompactArcStore<Element, Unsigned> *CompactArcStore<Element, Unsigned>::Read(
   }
   size_t b = data->ncompacts_ * sizeof(Element);
   data->compacts_region_.reset(
-      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.populate, opts.huge_pages));
   if (!strm || !data->compacts_region_) {
     LOG(ERROR) << "CompactArcStore::Read: Read failed: " << opts.source;
     return nullptr;
   }
   data->compacts_ =
       static_cast<Element *>(data->compacts_region_->mutable_data());
+  if (opts.chunk_states > 0 && data->nstates_ > 0) {
+    data->InitChunkCache(opts.chunk_states, opts.max_resident_chunks,
+                         opts.chunk_stats, arc_compactor.Size());
+  }
   return data.release();
 }
 
+template <class Element, class Unsigned>
+void CompactArcStore<Element, Unsigned>::InitChunkCache(size_t chunk_states,
+                                                        size_t max_chunks,
+                                                        bool count_accesses,
+                                                        ssize_t fixed_size) {
+  if (!(states_region_ && states_region_->IsMapped()) &&
+      !compacts_region_->IsMapped()) {
+    return;
+  }
+  // Chunks are loaded explicitly, so the kernel need not read ahead.
+  if (states_region_) {
+    states_region_->Advise(0, (nstates_ + 1) * sizeof(Unsigned),
+                           MappedFile::RANDOM);
+  }
+  compacts_region_->Advise(0, ncompacts_ * sizeof(Element),
+                           MappedFile::RANDOM);
+  // Captures the regions rather than the store, which copies share the cache
+  // with.
+  chunk_cache_ = std::make_shared<MappedChunkCache>(
+      nstates_, chunk_states, max_chunks, count_accesses,
+      [states_region = states_region_, compacts_region = compacts_region_,
+       states = states_, nstates = nstates_, chunk_states,
+       fixed_size](size_t chunk, MappedFile::Advice advice) {
+        const size_t begin = chunk * chunk_states;
+        const size_t end = std::min(begin + chunk_states, nstates);
+        size_t compacts_begin = begin * fixed_size;
+        size_t compacts_end = end * fixed_size;
+        if (states) {
+          compacts_begin = states[begin];
+          compacts_end = states[end];
+          states_region->Advise(begin * sizeof(Unsigned),
+                                (end + 1 - begin) * sizeof(Unsigned), advice);
+        }
+        compacts_region->Advise(compacts_begin * sizeof(Element),
+                                (compacts_end - compacts_begin) *
+                                    sizeof(Element),
+                                advice);
+      });
+}
+
 template <class Element, class Unsigned>
 bool CompactArcStore<Element, Unsigned>::Write(
     std::ostream &strm, const FstWriteOptions &opts) const {
@@ -806,9 +898,20 @@ class CompactArcState<ArcCompactor, U,
     return arc_compactor_->Expand(s_, compacts_[i], flags);
   }
 
+  // Decodes arcs [begin, end) into arcs in a single loop over the compact
+  // elements, which vectorizes for simple arc compactors.
+  void GetArcs(size_t begin, size_t end, uint8_t flags, Arc *arcs) const {
+    const auto *compacts = compacts_ + begin;
+    const auto n = end - begin;
+    for (size_t i = 0; i < n; ++i) {
+      arcs[i] = arc_compactor_->Expand(s_, compacts[i], flags);
+    }
+  }
+
  private:
   void Init(const Compactor *compactor) {
     const auto *store = compactor->GetCompactStore();
+    store->Touch(s_);
     U offset;
     if (!compactor->HasFixedOutdegree()) {  // Variable out-degree compactor.
       offset = store->States(s_);
@@ -1389,6 +1492,256 @@ class ArcIterator<CompactFst<Arc, Compactor, CacheStore>> {
   uint8_t flags_;
 };
 
+// Specialization of SortedMatcher for CompactFsts using a CompactArcStore.
+// Rather than going through an arc iterator, it searches the labels of the
+// compact elements of the state directly, and decodes the arcs it returns in
+// batches of up to kDecodeBatch.
+template <class Arc, class ArcCompactor, class Unsigned, class CacheStore>
+class SortedMatcher<CompactFst<
+    Arc,
+    CompactArcCompactor<
+        ArcCompactor, Unsigned,
+        CompactArcStore<typename ArcCompactor::Element, Unsigned>>,
+    CacheStore>> : public MatcherBase<Arc> {
+ public:
+  using FST = CompactFst<
+      Arc,
+      CompactArcCompactor<
+          ArcCompactor, Unsigned,
+          CompactArcStore<typename ArcCompactor::Element, Unsigned>>,
+      CacheStore>;
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  using State = typename FST::Compactor::State;
+
+  static constexpr size_t kDecodeBatch = 8;
+
+  // Labels >= binary_label will be searched for by binary search;
+  // o.w. linear search is used.
+  // This makes a copy of the FST.
+  SortedMatcher(const FST &fst, MatchType match_type, Label binary_label = 1)
+      : SortedMatcher(fst.Copy(), match_type, binary_label) {
+    owned_fst_.reset(&fst_);
+  }
+
+  // Labels >= binary_label will be searched for by binary search;
+  // o.w. linear search is used.
+  // This doesn't copy the FST.
+  SortedMatcher(const FST *fst, MatchType match_type, Label binary_label = 1)
+      : fst_(*fst),
+        match_type_(match_type),
+        binary_label_(binary_label),
+        loop_(kNoLabel, 0, Weight::One(), kNoStateId) {
+    switch (match_type_) {
+      case MATCH_INPUT:
+      case MATCH_NONE:
+        break;
+      case MATCH_OUTPUT:
+        std::swap(loop_.ilabel, loop_.olabel);
+        break;
+      default:
+        FSTERROR() << "SortedMatcher: Bad match type";
+        match_type_ = MATCH_NONE;
+        error_ = true;
+    }
+  }
+
+  // This makes a copy of the FST.
+  SortedMatcher(const SortedMatcher &matcher, bool safe = false)
+      : owned_fst_(matcher.fst_.Copy(safe)),
+        fst_(*owned_fst_),
+        match_type_(matcher.match_type_),
+        binary_label_(matcher.binary_label_),
+        loop_(matcher.loop_),
+        error_(matcher.error_) {}
+
+  SortedMatcher *Copy(bool safe = false) const override {
+    return new SortedMatcher(*this, safe);
+  }
+
+  MatchType Type(bool test) const override {
+    if (match_type_ == MATCH_NONE) return match_type_;
+    const auto true_prop =
+        match_type_ == MATCH_INPUT ? kILabelSorted : kOLabelSorted;
+    const auto false_prop =
+        match_type_ == MATCH_INPUT ? kNotILabelSorted : kNotOLabelSorted;
+    const auto props = fst_.Properties(true_prop | false_prop, test);
+    if (props & true_prop) {
+      return match_type_;
+    } else if (props & false_prop) {
+      return MATCH_NONE;
+    } else {
+      return MATCH_UNKNOWN;
+    }
+  }
+
+  void SetState(StateId s) final {
+    if (state_id_ == s) return;
+    state_id_ = s;
+    if (match_type_ == MATCH_NONE) {
+      FSTERROR() << "SortedMatcher: Bad match type";
+      error_ = true;
+    }
+    fst_.GetCompactor()->SetState(s, &state_);
+    narcs_ = state_.NumArcs();
+    pos_ = end_ = narcs_;
+    loop_.nextstate = s;
+  }
+
+  bool Find(Label match_label) final {
+    exact_match_ = true;
+    if (error_) {
+      current_loop_ = false;
+      match_label_ = kNoLabel;
+      pos_ = end_ = narcs_;
+      return false;
+    }
+    current_loop_ = match_label == 0;
+    match_label_ = match_label == kNoLabel ? 0 : match_label;
+    if (Search()) {
+      // Limits decoding to the matching arcs.
+      for (end_ = pos_ + 1; end_ < narcs_ && GetLabel(end_) == match_label_;
+           ++end_) {
+      }
+      return true;
+    } else {
+      end_ = pos_;
+      return current_loop_;
+    }
+  }
+
+  // Positions matcher to the first position where inserting match_label would
+  // maintain the sort order.
+  void LowerBound(Label label) {
+    exact_match_ = false;
+    current_loop_ = false;
+    if (error_) {
+      match_label_ = kNoLabel;
+      pos_ = end_ = narcs_;
+      return;
+    }
+    match_label_ = label;
+    Search();
+    end_ = narcs_;
+  }
+
+  // After Find(), returns false if no more exact matches.
+  // After LowerBound(), returns false if no more arcs.
+  bool Done() const final { return !current_loop_ && pos_ >= end_; }
+
+  const Arc &Value() const final {
+    if (current_loop_) return loop_;
+    if (pos_ < decoded_begin_ || pos_ >= decoded_end_) {
+      decoded_begin_ = pos_;
+      decoded_end_ = std::min(pos_ + kDecodeBatch, end_);
+      state_.GetArcs(decoded_begin_, decoded_end_, kArcValueFlags,
+                     decoded_.data());
+    }
+    return decoded_[pos_ - decoded_begin_];
+  }
+
+  void Next() final {
+    if (current_loop_) {
+      current_loop_ = false;
+    } else {
+      ++pos_;
+    }
+  }
+
+  Weight Final(StateId s) const final { return MatcherBase<Arc>::Final(s); }
+
+  ssize_t Priority(StateId s) final { return MatcherBase<Arc>::Priority(s); }
+
+  const FST &GetFst() const override { return fst_; }
+
+  uint64_t Properties(uint64_t inprops) const override {
+    return inprops | (error_ ? kError : 0);
+  }
+
+  size_t Position() const { return pos_; }
+
+ private:
+  Label GetLabel(size_t i) const {
+    if (match_type_ == MATCH_INPUT) {
+      return state_.GetArc(i, kArcILabelValue).ilabel;
+    } else {
+      return state_.GetArc(i, kArcOLabelValue).olabel;
+    }
+  }
+
+  bool BinarySearch();
+  bool LinearSearch();
+
+  // Returns true iff match to match_label_, positioning the matcher at the
+  // lower bound.
+  bool Search() {
+    // Decoded arcs are only valid up to the end of the previous match.
+    decoded_begin_ = decoded_end_ = 0;
+    return match_label_ >= binary_label_ ? BinarySearch() : LinearSearch();
+  }
+
+  std::unique_ptr<const FST> owned_fst_;  // FST ptr if owned.
+  const FST &fst_;                        // FST for matching.
+  StateId state_id_ = kNoStateId;         // Matcher state.
+  State state_;                           // Compact elements of the state.
+  MatchType match_type_;                  // Type of match to perform.
+  Label binary_label_;                    // Least label for binary search.
+  Label match_label_ = kNoLabel;          // Current label to be matched.
+  size_t narcs_ = 0;                      // Current state arc count.
+  size_t pos_ = 0;                        // Current arc.
+  size_t end_ = 0;                        // End of the current match.
+  Arc loop_;                              // For non-consuming symbols.
+  bool current_loop_ = false;             // Current arc is the implicit loop.
+  bool exact_match_ = false;              // Exact match or lower bound?
+  bool error_ = false;                    // Error encountered?
+  // Decoded arcs [decoded_begin_, decoded_end_).
+  mutable std::array<Arc, kDecodeBatch> decoded_;
+  mutable size_t decoded_begin_ = 0;
+  mutable size_t decoded_end_ = 0;
+};
+
+template <class Arc, class ArcCompactor, class Unsigned, class CacheStore>
+inline bool SortedMatcher<CompactFst<
+    Arc,
+    CompactArcCompactor<
+        ArcCompactor, Unsigned,
+        CompactArcStore<typename ArcCompactor::Element, Unsigned>>,
+    CacheStore>>::BinarySearch() {
+  size_t size = narcs_;
+  if (size == 0) {
+    pos_ = 0;
+    return false;
+  }
+  size_t high = size - 1;
+  while (size > 1) {
+    const size_t half = size / 2;
+    const size_t mid = high - half;
+    if (GetLabel(mid) >= match_label_) high = mid;
+    size -= half;
+  }
+  pos_ = high;
+  const auto label = GetLabel(high);
+  if (label == match_label_) return true;
+  if (label < match_label_) ++pos_;
+  return false;
+}
+
+template <class Arc, class ArcCompactor, class Unsigned, class CacheStore>
+inline bool SortedMatcher<CompactFst<
+    Arc,
+    CompactArcCompactor<
+        ArcCompactor, Unsigned,
+        CompactArcStore<typename ArcCompactor::Element, Unsigned>>,
+    CacheStore>>::LinearSearch() {
+  for (pos_ = 0; pos_ < narcs_; ++pos_) {
+    const auto label = GetLabel(pos_);
+    if (label == match_label_) return true;
+    if (label > match_label_) break;
+  }
+  return false;
+}
+
 // ArcCompactor for unweighted string FSTs.
 template <class A>
 class StringCompactor {
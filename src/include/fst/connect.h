@@ -21,21 +21,106 @@
 #define FST_CONNECT_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <utility>
 #include <vector>
 
 #include <fst/cc-visitors.h>
 #include <fst/dfs-visit.h>
+#include <fst/expanded-fst.h>
 #include <fst/fst.h>
 #include <fst/mutable-fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 
 namespace fst {
 
+namespace internal {
+
+// Computes the accessible and coaccessible states of an FST without a DFS:
+// accessibility by a breadth-first search from the initial state, and
+// coaccessibility by a breadth-first search from the final states over an
+// index of the reversed arcs. The two searches run concurrently, each on half
+// of num_threads threads (zero means one per hardware thread).
+template <class Arc>
+void BfsConnectStates(const ExpandedFst<Arc> &fst, std::vector<bool> *access,
+                      std::vector<bool> *coaccess, size_t num_threads) {
+  using StateId = typename Arc::StateId;
+  const size_t nstates = fst.NumStates();
+  num_threads = NumWorkerThreads(num_threads);
+  const auto forward_threads = std::max<size_t>(num_threads / 2, 1);
+  const auto backward_threads =
+      std::max<size_t>(num_threads - forward_threads, 1);
+  // Thread-safe copies for each thread of the forward search and for the
+  // backward search.
+  std::vector<std::unique_ptr<const Fst<Arc>>> fsts(forward_threads + 1);
+  for (auto &copy : fsts) copy.reset(fst.Copy(true));
+  const auto *forward_fsts = fsts.data();
+  const auto *backward_fst = fsts.back().get();
+  AtomicBitVector accessible(nstates);
+  AtomicBitVector coaccessible(nstates);
+  const auto forward = [&]() {
+    const auto start = forward_fsts[0]->Start();
+    if (start == kNoStateId) return;
+    accessible.TestAndSet(start);
+    ParallelBfs<StateId>({start}, &accessible, forward_threads,
+                         [forward_fsts](size_t block, StateId s, auto visit) {
+                           ArcIterator<Fst<Arc>> aiter(*forward_fsts[block], s);
+                           aiter.SetFlags(kArcNextStateValue, kArcValueFlags);
+                           for (; !aiter.Done(); aiter.Next()) {
+                             visit(aiter.Value().nextstate);
+                           }
+                         });
+  };
+  const auto backward = [&]() {
+    const StateGraph<StateId> rgraph(*backward_fst, nstates,
+                                     /*reverse=*/true, AnyArcFilter<Arc>(),
+                                     backward_threads);
+    std::vector<StateId> finals;
+    for (size_t s = 0; s < nstates; ++s) {
+      if (backward_fst->Final(s) != Arc::Weight::Zero()) {
+        coaccessible.TestAndSet(s);
+        finals.push_back(s);
+      }
+    }
+    ParallelBfs<StateId>(std::move(finals), &coaccessible, backward_threads,
+                         [&rgraph](size_t, StateId s, auto visit) {
+                           for (auto *t = rgraph.Begin(s); t != rgraph.End(s);
+                                ++t) {
+                             visit(*t);
+                           }
+                         });
+  };
+  if (num_threads > 1) {
+    ParallelFor(2, 2, [&forward, &backward](size_t block, size_t, size_t) {
+      if (block == 0) {
+        forward();
+      } else {
+        backward();
+      }
+    });
+  } else {
+    forward();
+    backward();
+  }
+  access->resize(nstates);
+  coaccess->resize(nstates);
+  for (size_t s = 0; s < nstates; ++s) {
+    (*access)[s] = accessible.Get(s);
+    (*coaccess)[s] = coaccessible.Get(s);
+  }
+}
+
+}  // namespace internal
+
 // Trims an FST, removing states and arcs that are not on successful paths.
-// This version modifies its input.
+// This version modifies its input. With more than one of num_threads threads
+// (zero means one per hardware thread), the accessible and coaccessible states
+// are found by concurrent breadth-first searches (see
+// internal::BfsConnectStates) rather than by a depth-first search.
 //
 // Complexity:
 //
@@ -44,13 +129,18 @@ namespace fst {
 //
 // where V = # of states and E = # of arcs.
 template <class Arc>
-void Connect(MutableFst<Arc> *fst) {
+void Connect(MutableFst<Arc> *fst, size_t num_threads = 1) {
   using StateId = typename Arc::StateId;
   std::vector<bool> access;
   std::vector<bool> coaccess;
-  uint64_t props = 0;
-  SccVisitor<Arc> scc_visitor(nullptr, &access, &coaccess, &props);
-  DfsVisit(*fst, &scc_visitor);
+  num_threads = NumWorkerThreads(num_threads);
+  if (num_threads > 1) {
+    internal::BfsConnectStates(*fst, &access, &coaccess, num_threads);
+  } else {
+    uint64_t props = 0;
+    SccVisitor<Arc> scc_visitor(nullptr, &access, &coaccess, &props);
+    DfsVisit(*fst, &scc_visitor);
+  }
   std::vector<StateId> dstates;
   dstates.reserve(access.size());
   for (StateId s = 0; s < access.size(); ++s) {
@@ -21,11 +21,14 @@
 #ifndef FST_CONST_FST_H_
 #define FST_CONST_FST_H_
 
+#include <algorithm>
 #include <climits>
 #include <cstddef>
 #include <cstdint>
+#include <fstream>
 #include <ios>
 #include <istream>
+#include <limits>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -39,7 +42,9 @@
 #include <fst/fst.h>
 #include <fst/impl-to-fst.h>
 #include <fst/mapped-file.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
+#include <fst/symbol-table.h>
 #include <fst/test-properties.h>
 #include <fst/util.h>
 #include <string_view>
@@ -78,23 +83,44 @@ class ConstFstImpl : public FstImpl<A> {
     SetProperties(kNullProperties | kStaticProperties);
   }
 
-  explicit ConstFstImpl(const Fst<Arc> &fst);
+  // If num_threads is not 1 and the input is expanded, the states are copied
+  // using that many threads (0 for one per hardware thread).
+  explicit ConstFstImpl(const Fst<Arc> &fst, size_t num_threads = 1);
 
   StateId Start() const { return start_; }
 
-  Weight Final(StateId s) const { return states_[s].final_weight; }
+  Weight Final(StateId s) const {
+    Touch(s);
+    return states_[s].final_weight;
+  }
 
   StateId NumStates() const { return nstates_; }
 
-  size_t NumArcs(StateId s) const { return states_[s].narcs; }
+  size_t NumArcs(StateId s) const {
+    Touch(s);
+    return states_[s].narcs;
+  }
 
-  size_t NumInputEpsilons(StateId s) const { return states_[s].niepsilons; }
+  size_t NumInputEpsilons(StateId s) const {
+    Touch(s);
+    return states_[s].niepsilons;
+  }
 
-  size_t NumOutputEpsilons(StateId s) const { return states_[s].noepsilons; }
+  size_t NumOutputEpsilons(StateId s) const {
+    Touch(s);
+    return states_[s].noepsilons;
+  }
 
   static ConstFstImpl *Read(std::istream &strm, const FstReadOptions &opts);
 
-  const Arc *Arcs(StateId s) const { return arcs_ + states_[s].pos; }
+  const Arc *Arcs(StateId s) const {
+    Touch(s);
+    return arcs_ + states_[s].pos;
+  }
+
+  // Returns the chunk cache when read with FstReadOptions::chunk_states from a
+  // mapped file, and nullptr otherwise.
+  const MappedChunkCache *GetChunkCache() const { return chunk_cache_.get(); }
 
   // Provide information needed for generic state iterator.
   void InitStateIterator(StateIteratorData<Arc> *data) const {
@@ -104,6 +130,7 @@ class ConstFstImpl : public FstImpl<A> {
 
   // Provide information needed for the generic arc iterator.
   void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const {
+    Touch(s);
     data->base = nullptr;
     data->arcs = arcs_ + states_[s].pos;
     data->narcs = states_[s].narcs;
@@ -113,6 +140,8 @@ class ConstFstImpl : public FstImpl<A> {
  private:
   // Used to find narcs_ and nstates_ in Write.
   friend class ConstFst<Arc, Unsigned>;
+  // Used to write the file representation.
+  friend class ConstFstBuilder<Arc, Unsigned>;
 
   // States implemented by array *states_ below, arcs by (single) *arcs_.
   struct ConstState {
@@ -125,6 +154,19 @@ class ConstFstImpl : public FstImpl<A> {
     ConstState() : final_weight(Weight::Zero()) {}
   };
 
+  // Copies the states and arcs of an expanded FST, given nstates_, counting
+  // and then copying the arcs of blocks of states in parallel.
+  void ParallelCopy(const Fst<Arc> &fst, size_t num_threads);
+
+  // Keeps only chunks of chunk_states states and their arcs resident, when
+  // either is mapped.
+  void InitChunkCache(size_t chunk_states, size_t max_chunks,
+                      bool count_accesses);
+
+  void Touch(StateId s) const {
+    if (chunk_cache_) chunk_cache_->Touch(s);
+  }
+
   // Properties always true of this FST class.
   static constexpr uint64_t kStaticProperties = kExpanded;
   // Current unaligned file format version. The unaligned version was added and
@@ -142,13 +184,15 @@ class ConstFstImpl : public FstImpl<A> {
   size_t narcs_ = 0;                           // Number of arcs.
   StateId nstates_ = 0;                        // Number of states.
   StateId start_ = kNoStateId;                 // Initial state.
+  std::unique_ptr<MappedChunkCache> chunk_cache_;  // Resident chunks, if any.
 
   ConstFstImpl(const ConstFstImpl &) = delete;
   ConstFstImpl &operator=(const ConstFstImpl &) = delete;
 };
 
 template <class Arc, class Unsigned>
-ConstFstImpl<Arc, Unsigned>::ConstFstImpl(const Fst<Arc> &fst) {
+ConstFstImpl<Arc, Unsigned>::ConstFstImpl(const Fst<Arc> &fst,
+                                          size_t num_threads) {
   std::string type = "const";
   if (sizeof(Unsigned) != sizeof(uint32_t)) {
     type += std::to_string(CHAR_BIT * sizeof(Unsigned));
@@ -157,29 +201,34 @@ ConstFstImpl<Arc, Unsigned>::ConstFstImpl(const Fst<Arc> &fst) {
   SetInputSymbols(fst.InputSymbols());
   SetOutputSymbols(fst.OutputSymbols());
   start_ = fst.Start();
-  // Counts states and arcs.
-  for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
-    ++nstates_;
-    narcs_ += fst.NumArcs(siter.Value());
-  }
-  states_region_.reset(MappedFile::AllocateType<ConstState>(nstates_));
-  arcs_region_.reset(MappedFile::AllocateType<Arc>(narcs_));
-  states_ = static_cast<ConstState *>(states_region_->mutable_data());
-  arcs_ = static_cast<Arc *>(arcs_region_->mutable_data());
-  size_t pos = 0;
-  for (StateId s = 0; s < nstates_; ++s) {
-    states_[s].final_weight = fst.Final(s);
-    states_[s].pos = pos;
-    states_[s].narcs = 0;
-    states_[s].niepsilons = 0;
-    states_[s].noepsilons = 0;
-    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
-      const auto &arc = aiter.Value();
-      ++states_[s].narcs;
-      if (arc.ilabel == 0) ++states_[s].niepsilons;
-      if (arc.olabel == 0) ++states_[s].noepsilons;
-      arcs_[pos] = arc;
-      ++pos;
+  if (NumWorkerThreads(num_threads) > 1 && fst.Properties(kExpanded, false)) {
+    nstates_ = CountStates(fst);
+    ParallelCopy(fst, num_threads);
+  } else {
+    // Counts states and arcs.
+    for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+      ++nstates_;
+      narcs_ += fst.NumArcs(siter.Value());
+    }
+    states_region_.reset(MappedFile::AllocateType<ConstState>(nstates_));
+    arcs_region_.reset(MappedFile::AllocateType<Arc>(narcs_));
+    states_ = static_cast<ConstState *>(states_region_->mutable_data());
+    arcs_ = static_cast<Arc *>(arcs_region_->mutable_data());
+    size_t pos = 0;
+    for (StateId s = 0; s < nstates_; ++s) {
+      states_[s].final_weight = fst.Final(s);
+      states_[s].pos = pos;
+      states_[s].narcs = 0;
+      states_[s].niepsilons = 0;
+      states_[s].noepsilons = 0;
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const auto &arc = aiter.Value();
+        ++states_[s].narcs;
+        if (arc.ilabel == 0) ++states_[s].niepsilons;
+        if (arc.olabel == 0) ++states_[s].noepsilons;
+        arcs_[pos] = arc;
+        ++pos;
+      }
     }
   }
   const auto props =
@@ -191,6 +240,48 @@ ConstFstImpl<Arc, Unsigned>::ConstFstImpl(const Fst<Arc> &fst) {
   SetProperties(props | kStaticProperties);
 }
 
+template <class Arc, class Unsigned>
+void ConstFstImpl<Arc, Unsigned>::ParallelCopy(const Fst<Arc> &fst,
+                                               size_t num_threads) {
+  states_region_.reset(MappedFile::AllocateType<ConstState>(nstates_));
+  states_ = static_cast<ConstState *>(states_region_->mutable_data());
+  // Counts the arcs of each block of states; the blocks are the same in both
+  // passes since the partition only depends on the arguments.
+  std::vector<size_t> offsets(NumWorkerThreads(num_threads) + 1, 0);
+  const auto nblocks = ParallelFor(
+      nstates_, num_threads, [&](size_t b, size_t begin, size_t end) {
+        std::unique_ptr<const Fst<Arc>> copy(fst.Copy(true));
+        size_t narcs = 0;
+        for (auto s = begin; s < end; ++s) narcs += copy->NumArcs(s);
+        offsets[b + 1] = narcs;
+      });
+  for (size_t b = 0; b < nblocks; ++b) offsets[b + 1] += offsets[b];
+  narcs_ = offsets[nblocks];
+  arcs_region_.reset(MappedFile::AllocateType<Arc>(narcs_));
+  arcs_ = static_cast<Arc *>(arcs_region_->mutable_data());
+  ParallelFor(nstates_, num_threads, [&](size_t b, size_t begin, size_t end) {
+    std::unique_ptr<const Fst<Arc>> copy(fst.Copy(true));
+    auto pos = offsets[b];
+    for (auto s = begin; s < end; ++s) {
+      auto &state = states_[s];
+      state.final_weight = copy->Final(s);
+      state.pos = pos;
+      state.narcs = 0;
+      state.niepsilons = 0;
+      state.noepsilons = 0;
+      for (ArcIterator<Fst<Arc>> aiter(*copy, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        ++state.narcs;
+        if (arc.ilabel == 0) ++state.niepsilons;
+        if (arc.olabel == 0) ++state.noepsilons;
+        arcs_[pos] = arc;
+        ++pos;
+      }
+    }
+  });
+}
+
 template <class Arc, class Unsigned>
 ConstFstImpl<Arc, Unsigned> *ConstFstImpl<Arc, Unsigned>::Read(
     std::istream &strm, const FstReadOptions &opts) {
@@ -210,7 +301,8 @@ ConstFstImpl<Arc, Unsigned> *ConstFstImpl<Arc, Unsigned>::Read(
   }
   size_t b = impl->nstates_ * sizeof(ConstState);
   impl->states_region_.reset(
-      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.populate, opts.huge_pages));
   if (!strm || !impl->states_region_) {
     LOG(ERROR) << "ConstFst::Read: Read failed: " << opts.source;
     return nullptr;
@@ -223,15 +315,43 @@ ConstFstImpl<Arc, Unsigned> *ConstFstImpl<Arc, Unsigned>::Read(
   }
   b = impl->narcs_ * sizeof(Arc);
   impl->arcs_region_.reset(
-      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.populate, opts.huge_pages));
   if (!strm || !impl->arcs_region_) {
     LOG(ERROR) << "ConstFst::Read: Read failed: " << opts.source;
     return nullptr;
   }
   impl->arcs_ = static_cast<Arc *>(impl->arcs_region_->mutable_data());
+  if (opts.chunk_states > 0 && impl->nstates_ > 0) {
+    impl->InitChunkCache(opts.chunk_states, opts.max_resident_chunks,
+                         opts.chunk_stats);
+  }
   return impl.release();
 }
 
+template <class Arc, class Unsigned>
+void ConstFstImpl<Arc, Unsigned>::InitChunkCache(size_t chunk_states,
+                                                 size_t max_chunks,
+                                                 bool count_accesses) {
+  if (!states_region_->IsMapped() && !arcs_region_->IsMapped()) return;
+  // Chunks are loaded explicitly, so the kernel need not read ahead.
+  states_region_->Advise(0, nstates_ * sizeof(ConstState), MappedFile::RANDOM);
+  arcs_region_->Advise(0, narcs_ * sizeof(Arc), MappedFile::RANDOM);
+  chunk_cache_ = std::make_unique<MappedChunkCache>(
+      nstates_, chunk_states, max_chunks, count_accesses,
+      [this, chunk_states](size_t chunk, MappedFile::Advice advice) {
+        const size_t begin = chunk * chunk_states;
+        const size_t end =
+            std::min(begin + chunk_states, static_cast<size_t>(nstates_));
+        const size_t arcs_begin = states_[begin].pos;
+        const size_t arcs_end = states_[end - 1].pos + states_[end - 1].narcs;
+        states_region_->Advise(begin * sizeof(ConstState),
+                               (end - begin) * sizeof(ConstState), advice);
+        arcs_region_->Advise(arcs_begin * sizeof(Arc),
+                             (arcs_end - arcs_begin) * sizeof(Arc), advice);
+      });
+}
+
 }  // namespace internal
 
 // Simple concrete immutable FST. This class attaches interface to
@@ -260,6 +380,11 @@ class ConstFst : public ImplToExpandedFst<internal::ConstFstImpl<A, Unsigned>> {
   explicit ConstFst(const Fst<Arc> &fst)
       : ImplToExpandedFst<Impl>(std::make_shared<Impl>(fst)) {}
 
+  // Copies the input using num_threads threads (0 for one per hardware
+  // thread) when it is expanded.
+  ConstFst(const Fst<Arc> &fst, size_t num_threads)
+      : ImplToExpandedFst<Impl>(std::make_shared<Impl>(fst, num_threads)) {}
+
   ConstFst(const ConstFst &fst, bool unused_safe = false)
       : ImplToExpandedFst<Impl>(fst.GetSharedImpl()) {}
 
@@ -301,6 +426,12 @@ class ConstFst : public ImplToExpandedFst<internal::ConstFstImpl<A, Unsigned>> {
     GetImpl()->InitArcIterator(s, data);
   }
 
+  // Returns the chunk cache when read out-of-core (see
+  // FstReadOptions::chunk_states), and nullptr otherwise.
+  const MappedChunkCache *GetChunkCache() const {
+    return GetImpl()->GetChunkCache();
+  }
+
  private:
   explicit ConstFst(std::shared_ptr<Impl> impl)
       : ImplToExpandedFst<Impl>(impl) {}
@@ -412,6 +543,251 @@ bool ConstFst<Arc, Unsigned>::WriteFst(const FST &fst, std::ostream &strm,
   return true;
 }
 
+// Writes a ConstFst file incrementally, so that FSTs generated state by state
+// need not be held in memory. The number of states is given in advance, so
+// that the state and arc arrays can each be written in place as states are
+// added in order, each followed by its arcs; memory use is bounded by the
+// write buffers. Finish() then rewrites the header with the start state,
+// number of arcs and properties. Only the properties that AddArc() and
+// SetFinal() maintain for a MutableFst are known, as for a VectorFst built the
+// same way. The output file must be seekable.
+template <class A, class Unsigned>
+class ConstFstBuilder {
+ public:
+  using Arc = A;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  ConstFstBuilder(std::string_view source, StateId num_states,
+                  const SymbolTable *isymbols = nullptr,
+                  const SymbolTable *osymbols = nullptr,
+                  bool align = FST_FLAGS_fst_align);
+
+  // Starts the next state, numbered consecutively from 0, and returns it.
+  StateId AddState(const Weight &final_weight = Weight::Zero());
+
+  // Adds an arc leaving the last state added.
+  void AddArc(const Arc &arc);
+
+  void SetStart(StateId s) {
+    start_ = s;
+    properties_ = SetStartProperties(properties_);
+  }
+
+  // Writes the remaining states and arcs and the final header, returning
+  // false on error. Exactly the given number of states must have been added.
+  bool Finish();
+
+  bool Error() const { return error_; }
+
+ private:
+  using Impl = internal::ConstFstImpl<Arc, Unsigned>;
+  using ConstState = typename Impl::ConstState;
+
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  // Writes the header, with the current start state, counts and properties.
+  void WriteHeader();
+
+  // Writes the buffered states or arcs at their positions in the file.
+  void FlushStates();
+  void FlushArcs();
+
+  // Ends the current state, if any.
+  void EndState();
+
+  std::ofstream strm_;
+  std::string source_;
+  std::unique_ptr<SymbolTable> isymbols_;
+  std::unique_ptr<SymbolTable> osymbols_;
+  bool align_;
+  StateId num_states_;
+  StateId start_ = kNoStateId;
+  uint64_t properties_ = kNullProperties | Impl::kStaticProperties;
+  std::streamoff states_offset_ = 0;
+  std::streamoff arcs_offset_ = 0;
+  StateId nstates_ = 0;    // Number of states added.
+  size_t narcs_ = 0;       // Number of arcs added.
+  size_t nflushed_states_ = 0;
+  size_t nflushed_arcs_ = 0;
+  ConstState state_;       // Current state.
+  Arc prev_arc_;           // Last arc of the current state, if any.
+  std::vector<ConstState> state_buffer_;
+  std::vector<Arc> arc_buffer_;
+  bool error_ = false;
+};
+
+template <class Arc, class Unsigned>
+ConstFstBuilder<Arc, Unsigned>::ConstFstBuilder(std::string_view source,
+                                                StateId num_states,
+                                                const SymbolTable *isymbols,
+                                                const SymbolTable *osymbols,
+                                                bool align)
+    : strm_(std::string(source), std::ios_base::out | std::ios_base::binary),
+      source_(source),
+      isymbols_(isymbols ? isymbols->Copy() : nullptr),
+      osymbols_(osymbols ? osymbols->Copy() : nullptr),
+      align_(align),
+      num_states_(num_states) {
+  if (num_states_ < 0) {
+    FSTERROR() << "ConstFstBuilder: Bad number of states: " << num_states_;
+    error_ = true;
+    return;
+  }
+  if (!strm_) {
+    LOG(ERROR) << "ConstFstBuilder: Can't open file: " << source_;
+    error_ = true;
+    return;
+  }
+  WriteHeader();
+  if (align_ && !AlignOutput(strm_)) {
+    LOG(ERROR) << "ConstFstBuilder: Could not align file after header: "
+               << source_;
+    error_ = true;
+    return;
+  }
+  states_offset_ = strm_.tellp();
+  arcs_offset_ = states_offset_ + num_states_ * sizeof(ConstState);
+  if (align_) {
+    const auto alignment = MappedFile::kArchAlignment;
+    arcs_offset_ = (arcs_offset_ + alignment - 1) / alignment * alignment;
+  }
+  state_buffer_.reserve(kBufferSize);
+  arc_buffer_.reserve(kBufferSize);
+}
+
+template <class Arc, class Unsigned>
+void ConstFstBuilder<Arc, Unsigned>::WriteHeader() {
+  FstHeader hdr;
+  hdr.SetFstType(Impl().Type());
+  hdr.SetArcType(Arc::Type());
+  hdr.SetVersion(align_ ? Impl::kAlignedFileVersion : Impl::kFileVersion);
+  hdr.SetProperties(properties_);
+  int32_t file_flags = 0;
+  if (isymbols_) file_flags |= FstHeader::HAS_ISYMBOLS;
+  if (osymbols_) file_flags |= FstHeader::HAS_OSYMBOLS;
+  if (align_) file_flags |= FstHeader::IS_ALIGNED;
+  hdr.SetFlags(file_flags);
+  hdr.SetStart(start_);
+  hdr.SetNumStates(num_states_);
+  hdr.SetNumArcs(narcs_);
+  hdr.Write(strm_, source_);
+  if (isymbols_) isymbols_->Write(strm_);
+  if (osymbols_) osymbols_->Write(strm_);
+}
+
+template <class Arc, class Unsigned>
+typename Arc::StateId ConstFstBuilder<Arc, Unsigned>::AddState(
+    const Weight &final_weight) {
+  if (nstates_ >= num_states_) {
+    FSTERROR() << "ConstFstBuilder::AddState: More than " << num_states_
+               << " states added: " << source_;
+    error_ = true;
+    return kNoStateId;
+  }
+  EndState();
+  state_.final_weight = final_weight;
+  state_.pos = narcs_;
+  state_.narcs = 0;
+  state_.niepsilons = 0;
+  state_.noepsilons = 0;
+  properties_ = AddStateProperties(properties_);
+  properties_ =
+      SetFinalProperties(properties_, Weight::Zero(), final_weight);
+  return nstates_++;
+}
+
+template <class Arc, class Unsigned>
+void ConstFstBuilder<Arc, Unsigned>::AddArc(const Arc &arc) {
+  if (nstates_ == 0) {
+    FSTERROR() << "ConstFstBuilder::AddArc: No state added";
+    error_ = true;
+    return;
+  }
+  // State positions and arc counts are stored as Unsigned.
+  if (narcs_ >= std::numeric_limits<Unsigned>::max()) {
+    FSTERROR() << "ConstFstBuilder::AddArc: More than "
+               << +std::numeric_limits<Unsigned>::max()
+               << " arcs added: " << source_;
+    error_ = true;
+    return;
+  }
+  properties_ = AddArcProperties(properties_, nstates_ - 1, arc,
+                                 state_.narcs > 0 ? &prev_arc_ : nullptr);
+  ++state_.narcs;
+  if (arc.ilabel == 0) ++state_.niepsilons;
+  if (arc.olabel == 0) ++state_.noepsilons;
+  prev_arc_ = arc;
+  arc_buffer_.push_back(arc);
+  ++narcs_;
+  if (arc_buffer_.size() == kBufferSize) FlushArcs();
+}
+
+template <class Arc, class Unsigned>
+void ConstFstBuilder<Arc, Unsigned>::EndState() {
+  if (nstates_ == 0) return;
+  state_buffer_.push_back(state_);
+  if (state_buffer_.size() == kBufferSize) FlushStates();
+}
+
+template <class Arc, class Unsigned>
+void ConstFstBuilder<Arc, Unsigned>::FlushStates() {
+  if (error_ || state_buffer_.empty()) return;
+  strm_.seekp(states_offset_ + nflushed_states_ * sizeof(ConstState));
+  strm_.write(reinterpret_cast<const char *>(state_buffer_.data()),
+              state_buffer_.size() * sizeof(ConstState));
+  nflushed_states_ += state_buffer_.size();
+  state_buffer_.clear();
+}
+
+template <class Arc, class Unsigned>
+void ConstFstBuilder<Arc, Unsigned>::FlushArcs() {
+  if (error_ || arc_buffer_.empty()) return;
+  strm_.seekp(arcs_offset_ + nflushed_arcs_ * sizeof(Arc));
+  strm_.write(reinterpret_cast<const char *>(arc_buffer_.data()),
+              arc_buffer_.size() * sizeof(Arc));
+  nflushed_arcs_ += arc_buffer_.size();
+  arc_buffer_.clear();
+}
+
+template <class Arc, class Unsigned>
+bool ConstFstBuilder<Arc, Unsigned>::Finish() {
+  EndState();
+  FlushStates();
+  FlushArcs();
+  if (error_) return false;
+  if (nstates_ != num_states_) {
+    FSTERROR() << "ConstFstBuilder::Finish: Expected " << num_states_
+               << " states, added " << nstates_ << ": " << source_;
+    error_ = true;
+    return false;
+  }
+  if (start_ >= num_states_) {
+    FSTERROR() << "ConstFstBuilder::Finish: Bad start state: " << start_;
+    error_ = true;
+    return false;
+  }
+  // Writes the padding between the states and arcs, which is needed even if
+  // there are no arcs.
+  const std::streamoff states_end =
+      states_offset_ + num_states_ * sizeof(ConstState);
+  if (arcs_offset_ > states_end) {
+    strm_.seekp(states_end);
+    const std::string padding(arcs_offset_ - states_end, 0);
+    strm_.write(padding.data(), padding.size());
+  }
+  strm_.seekp(0);
+  WriteHeader();
+  strm_.flush();
+  if (!strm_) {
+    LOG(ERROR) << "ConstFstBuilder::Finish: Write failed: " << source_;
+    error_ = true;
+    return false;
+  }
+  strm_.close();
+  return true;
+}
+
 // Specialization for ConstFst; see generic version in fst.h for sample usage
 // (but use the ConstFst type instead). This version should inline.
 template <class Arc, class Unsigned>
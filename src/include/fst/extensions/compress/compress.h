@@ -229,10 +229,7 @@ class Compressor {
   // Updates buffer_code_.
   template <class CVar>
   void WriteToBuffer(CVar input) {
-    std::vector<bool> current_code;
-    Elias<CVar>::DeltaEncode(input, &current_code);
-    buffer_code_.insert(buffer_code_.cend(), current_code.begin(),
-                        current_code.end());
+    Elias<CVar>::DeltaEncode(input, &buffer_code_);
   }
 
  private:
@@ -291,7 +288,7 @@ class Compressor {
     }
   };
 
-  std::vector<bool> buffer_code_;
+  BitWriter buffer_code_;
   std::vector<Weight> arc_weight_;
   std::vector<Weight> final_weight_;
 };
@@ -681,22 +678,15 @@ template <class Arc>
   std::unique_ptr<EncodeMapper<Arc>> encoder(
       EncodeMapper<Arc>::Read(strm, "Decoding", DECODE));
   if (encoder == nullptr) return false;
-  std::vector<bool> bool_code;
-  uint8_t block;
-  uint8_t msb = 128;
   int64_t data_size;
   ReadType(strm, &data_size);
-  for (int64_t i = 0; i < data_size; ++i) {
-    ReadType(strm, &block);
-    for (int j = 0; j < 8; ++j) {
-      uint8_t temp = msb & block;
-      bool_code.push_back(temp == 128);
-      block = block << 1;
-    }
-  }
   std::vector<StateId> int_code;
-  Elias<StateId>::BatchDecode(bool_code, &int_code);
-  bool_code.clear();
+  BitReader reader(strm, data_size);
+  Elias<StateId>::BatchDecode(&reader, &int_code);
+  if (reader.Error()) {
+    LOG(ERROR) << "Decompress: Bad compressed Fst: " << source;
+    return false;
+  }
   uint8_t unweighted;
   ReadType(strm, &unweighted);
   if (unweighted == 0) {
@@ -720,22 +710,7 @@ void Compressor<Arc>::WriteWeight(const std::vector<Weight> &input,
 
 template <class Arc>
 void Compressor<Arc>::WriteToStream(std::ostream &strm) {
-  while (buffer_code_.size() % 8 != 0) buffer_code_.push_back(true);
-  int64_t data_size = buffer_code_.size() / 8;
-  WriteType(strm, data_size);
-  int64_t i = 0;
-  uint8_t block;
-  for (auto it = buffer_code_.begin(); it != buffer_code_.end(); ++it) {
-    if (i % 8 == 0) {
-      if (i > 0) WriteType(strm, block);
-      block = 0;
-    } else {
-      block = block << 1;
-    }
-    block |= *it;
-    ++i;
-  }
-  WriteType(strm, block);
+  buffer_code_.WriteToStream(strm);
 }
 
 template <class Arc>
@@ -20,12 +20,165 @@
 #ifndef FST_EXTENSIONS_COMPRESS_ELIAS_H_
 #define FST_EXTENSIONS_COMPRESS_ELIAS_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
 #include <stack>
 #include <vector>
 
 #include <fst/compat.h>
+#include <fst/util.h>
 namespace fst {
 
+// Returns the number of significant bits of a positive integer.
+inline int BitLength(uint64_t n) { return 64 - __builtin_clzll(n); }
+
+// Accumulates a bit stream, most significant bit first, in 64-bit words.
+class BitWriter {
+ public:
+  // Appends the nbits (at most 64) low-order bits of bits, most significant
+  // first.
+  void Write(uint64_t bits, int nbits) {
+    if (nbits == 0) return;
+    if (nbits < 64) bits &= (uint64_t{1} << nbits) - 1;
+    const int free = 64 - used_;
+    if (nbits < free) {
+      current_ |= bits << (free - nbits);
+      used_ += nbits;
+    } else {
+      words_.push_back(current_ | (bits >> (nbits - free)));
+      used_ = nbits - free;
+      current_ = used_ == 0 ? 0 : bits << (64 - used_);
+    }
+  }
+
+  size_t NumBits() const { return words_.size() * 64 + used_; }
+
+  // Pads the bits with ones to a whole number of bytes, then writes the number
+  // of bytes as an int64_t followed by the bytes.
+  void WriteToStream(std::ostream &strm) {
+    Write(0xff, (8 - NumBits() % 8) % 8);
+    const int64_t data_size = NumBits() / 8;
+    WriteType(strm, data_size);
+    std::vector<char> bytes;
+    bytes.reserve(std::min<size_t>(data_size, kBlockSize));
+    for (size_t i = 0; i <= words_.size(); ++i) {
+      const auto word = i < words_.size() ? words_[i] : current_;
+      const int nbytes = i < words_.size() ? 8 : used_ / 8;
+      for (int j = 0; j < nbytes; ++j) {
+        bytes.push_back(static_cast<char>(word >> (56 - 8 * j)));
+      }
+      if (bytes.size() >= kBlockSize || i == words_.size()) {
+        strm.write(bytes.data(), bytes.size());
+        bytes.clear();
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 1 << 16;
+
+  std::vector<uint64_t> words_;  // Full words.
+  uint64_t current_ = 0;         // Partial word, filled from the top.
+  int used_ = 0;                 // Number of bits used in current_.
+};
+
+// Reads a bit stream of a given number of bytes written by BitWriter, in
+// blocks, without materializing it.
+class BitReader {
+ public:
+  BitReader(std::istream &strm, int64_t nbytes)
+      : strm_(strm), remaining_(std::max<int64_t>(nbytes, 0)) {}
+
+  // Are there no bits left?
+  bool Done() {
+    Refill();
+    return avail_ == 0;
+  }
+
+  // Did the reader run out of bits while reading, or was the stream marked as
+  // corrupt?
+  bool Error() const { return error_; }
+
+  // Marks the stream as corrupt.
+  void SetError() { error_ = true; }
+
+  // Reads nbits (at most 64) bits as an integer.
+  uint64_t Read(int nbits) {
+    if (nbits == 0) return 0;
+    if (nbits > 56) {
+      const auto high = Read(nbits - 32);
+      return (high << 32) | Read(32);
+    }
+    if (avail_ < nbits) Refill();
+    if (avail_ < nbits) {
+      error_ = true;
+      return 0;
+    }
+    const auto bits = word_ >> (64 - nbits);
+    word_ <<= nbits;
+    avail_ -= nbits;
+    return bits;
+  }
+
+  // Consumes zero bits up to the next one bit, returning their number.
+  int64_t SkipZeros() {
+    int64_t nzeros = 0;
+    while (true) {
+      if (word_ != 0) {
+        const int n = __builtin_clzll(word_);
+        word_ <<= n;
+        avail_ -= n;
+        return nzeros + n;
+      }
+      nzeros += avail_;
+      avail_ = 0;
+      Refill();
+      if (avail_ == 0) {
+        error_ = true;
+        return nzeros;
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 1 << 16;
+
+  // Tops up the current word from the block buffer, reading the next block
+  // when it is exhausted.
+  void Refill() {
+    while (avail_ <= 56) {
+      if (pos_ == buffer_.size()) {
+        if (remaining_ == 0) return;
+        buffer_.resize(std::min<int64_t>(remaining_, kBlockSize));
+        strm_.read(buffer_.data(), buffer_.size());
+        if (!strm_) {
+          error_ = true;
+          remaining_ = 0;
+          buffer_.clear();
+          pos_ = 0;
+          return;
+        }
+        remaining_ -= buffer_.size();
+        pos_ = 0;
+      }
+      word_ |= uint64_t{static_cast<uint8_t>(buffer_[pos_++])}
+               << (56 - avail_);
+      avail_ += 8;
+    }
+  }
+
+  std::istream &strm_;
+  int64_t remaining_;         // Bytes not yet read from the stream.
+  std::vector<char> buffer_;  // Current block.
+  size_t pos_ = 0;            // Position in the current block.
+  uint64_t word_ = 0;         // Unread bits, aligned to the top.
+  int avail_ = 0;             // Number of unread bits in word_.
+  bool error_ = false;
+};
+
 template <class Var>
 class Elias {
  public:
@@ -38,6 +191,38 @@ class Elias {
   // Batch decoding of a set of integers.
   static void BatchDecode(const std::vector<bool> &input,
                           std::vector<Var> *output);
+
+  // Elias Delta encoding for a single non-negative integer, appending the code
+  // to a bit writer. Produces the same bits as the above.
+  static void DeltaEncode(const Var &input, BitWriter *writer) {
+    const uint64_t n = static_cast<uint64_t>(input) + 1;
+    const int length = BitLength(n);
+    // Gamma code of the length: the leading zeros are implied by the width.
+    writer->Write(length, 2 * BitLength(length) - 1);
+    writer->Write(n, length - 1);
+  }
+
+  // Batch decoding of the integers in a bit stream, with the same output as
+  // the above. Stops early, with the reader in the error state, if the stream
+  // is truncated or corrupt.
+  static void BatchDecode(BitReader *reader, std::vector<Var> *output) {
+    while (!reader->Done()) {
+      const auto nzeros = reader->SkipZeros();
+      // The length of a 64-bit integer has at most 7 bits.
+      if (reader->Error() || nzeros > 6) {
+        reader->SetError();
+        return;
+      }
+      const auto length = reader->Read(nzeros + 1);
+      if (reader->Error() || length < 1 || length > 64) {
+        reader->SetError();
+        return;
+      }
+      const auto n = (uint64_t{1} << (length - 1)) | reader->Read(length - 1);
+      if (reader->Error()) return;
+      output->push_back(static_cast<Var>(n - 1));
+    }
+  }
 };
 
 template <class Var>
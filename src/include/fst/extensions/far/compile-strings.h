@@ -36,6 +36,7 @@
 #include <fst/compact-fst.h>
 #include <fstream>
 #include <fst/fst.h>
+#include <fst/string-set.h>
 #include <fst/string.h>
 #include <fst/symbol-table.h>
 #include <fst/util.h>
@@ -148,6 +149,31 @@ class StringReader {
 // number, or zero if the file is not seekable.
 int KeySize(std::string_view source);
 
+// Compiles the lines of a stream, which must be sorted in label order, into
+// the minimal acceptor of the set of lines; returns null on error.
+template <class Arc>
+std::unique_ptr<VectorFst<Arc>> CompileStringSet(
+    std::istream &istrm, const std::string &source, TokenType token_type,
+    const SymbolTable *syms, typename Arc::Label unknown_label,
+    bool keep_symbols) {
+  StringSetCompiler<Arc> compiler(token_type, syms, unknown_label);
+  std::string line;
+  for (size_t nline = 1; std::getline(istrm, line); ++nline) {
+    if (!compiler.Add(line)) {
+      LOG(ERROR) << "CompileStringSet: Bad string at line " << nline
+                 << " of " << source;
+      return nullptr;
+    }
+  }
+  auto fst = std::make_unique<VectorFst<Arc>>();
+  compiler.Finish(fst.get());
+  if (keep_symbols) {
+    fst->SetInputSymbols(syms);
+    fst->SetOutputSymbols(syms);
+  }
+  return fst;
+}
+
 }  // namespace internal
 
 template <class Arc>
@@ -167,6 +193,10 @@ void CompileStrings(const std::vector<std::string> &sources,
     FSTERROR() << "CompileStrings: Unknown FST type: " << fst_type;
     return;
   }
+  if (compact && entry_type == FarEntryType::SET) {
+    FSTERROR() << "CompileStrings: Compact FST type does not hold string sets";
+    return;
+  }
   std::unique_ptr<const SymbolTable> syms;
   typename Arc::Label unknown_label = kNoLabel;
   if (!symbols_source.empty()) {
@@ -195,7 +225,7 @@ void CompileStrings(const std::vector<std::string> &sources,
       return;
     }
     const int key_size = generate_keys ? generate_keys
-                                       : (entry_type == FarEntryType::FILE
+                                       : (entry_type != FarEntryType::LINE
                                               ? 1
                                               : internal::KeySize(in_source));
     if (key_size == 0) {
@@ -212,7 +242,42 @@ void CompileStrings(const std::vector<std::string> &sources,
       }
     }
     std::istream &istrm = fstrm.is_open() ? fstrm : std::cin;
+    // Returns the key of FST number n.
+    const auto make_key = [&]() {
+      std::ostringstream keybuf;
+      keybuf.width(key_size);
+      keybuf.fill('0');
+      keybuf << n;
+      std::string key;
+      if (generate_keys > 0) {
+        key = keybuf.str();
+      } else {
+        auto source =
+            fst::make_unique_for_overwrite<char[]>(in_source.size() + 1);
+        strcpy(source.get(), in_source.c_str());  // NOLINT(runtime/printf)
+        key = basename(source.get());
+        if (entry_type == FarEntryType::LINE) {
+          key += "-";
+          key += keybuf.str();
+        }
+      }
+      return key_prefix + key + key_suffix;
+    };
     bool keep_syms = keep_symbols;
+    if (entry_type == FarEntryType::SET) {
+      ++n;
+      const auto fst = internal::CompileStringSet<Arc>(
+          istrm, in_source.empty() ? "stdin" : in_source, token_type,
+          syms.get(), unknown_label, keep_syms);
+      if (!fst) {
+        FSTERROR() << "CompileStrings: Compiling string set in file "
+                   << in_source << " failed with token_type = " << token_type;
+        return;
+      }
+      writer.Add(make_key(), *fst);
+      if (generate_keys == 0) n = 0;
+      continue;
+    }
     for (internal::StringReader<Arc> reader(
              istrm, in_source.empty() ? "stdin" : in_source, entry_type,
              token_type, syms.get(), unknown_label);
@@ -236,24 +301,7 @@ void CompileStrings(const std::vector<std::string> &sources,
                                                                : "unknown"));
         return;
       }
-      std::ostringstream keybuf;
-      keybuf.width(key_size);
-      keybuf.fill('0');
-      keybuf << n;
-      std::string key;
-      if (generate_keys > 0) {
-        key = keybuf.str();
-      } else {
-        auto source =
-            fst::make_unique_for_overwrite<char[]>(in_source.size() + 1);
-        strcpy(source.get(), in_source.c_str());  // NOLINT(runtime/printf)
-        key = basename(source.get());
-        if (entry_type != FarEntryType::FILE) {
-          key += "-";
-          key += keybuf.str();
-        }
-      }
-      writer.Add(key_prefix + key + key_suffix, *fst);
+      writer.Add(make_key(), *fst);
     }
     if (generate_keys == 0) n = 0;
   }
@@ -15,6 +15,8 @@
 #ifndef FST_EXTENSIONS_FAR_CONVERT_H_
 #define FST_EXTENSIONS_FAR_CONVERT_H_
 
+#include <cstddef>
+
 #include <fst/log.h>
 #include <fst/extensions/far/far.h>
 #include <fst/extensions/far/getters.h>
@@ -26,21 +28,28 @@
 
 namespace fst {
 
+// If num_threads is not one, entries are converted on num_threads threads
+// (zero means one per hardware thread).
 template <class Arc>
 void Convert(FarReader<Arc> &reader, FarWriter<Arc> &writer,
-             std::string_view fst_type) {
-  internal::Map(reader, writer,
-                [&fst_type](std::string_view key, const Fst<Arc> *ifst) {
-                  if (fst_type.empty() || ifst->Type() == fst_type) {
-                    return fst::WrapUnique(ifst->Copy());
-                  }
-                  auto ofst = fst::WrapUnique(Convert(*ifst, fst_type));
-                  if (!ofst) {
-                    FSTERROR() << "FarConvert: Cannot convert FST with key "
-                               << key << " to " << fst_type;
-                  }
-                  return ofst;
-                });
+             std::string_view fst_type, size_t num_threads = 1) {
+  const auto functor = [&fst_type](std::string_view key,
+                                   const Fst<Arc> *ifst) {
+    if (fst_type.empty() || ifst->Type() == fst_type) {
+      return fst::WrapUnique(ifst->Copy());
+    }
+    auto ofst = fst::WrapUnique(Convert(*ifst, fst_type));
+    if (!ofst) {
+      FSTERROR() << "FarConvert: Cannot convert FST with key " << key
+                 << " to " << fst_type;
+    }
+    return ofst;
+  };
+  if (num_threads == 1) {
+    internal::Map(reader, writer, functor);
+  } else {
+    internal::ParallelMap(reader, writer, functor, num_threads);
+  }
 }
 
 }  // namespace fst
@@ -15,6 +15,7 @@
 #ifndef FST_EXTENSIONS_FAR_ENCODE_H_
 #define FST_EXTENSIONS_FAR_ENCODE_H_
 
+#include <cstddef>
 #include <memory>
 
 #include <fst/extensions/far/far.h>
@@ -38,15 +39,21 @@ void Encode(FarReader<Arc> &reader, FarWriter<Arc> &writer,
                 });
 }
 
+// Decoding only reads the mapper, so unlike encoding it can be done on
+// num_threads threads (zero means one per hardware thread).
 template <class Arc>
 void Decode(FarReader<Arc> &reader, FarWriter<Arc> &writer,
-            const EncodeMapper<Arc> &mapper) {
-  internal::Map(reader, writer,
-                [&mapper](std::string_view key, const Fst<Arc> *ifst) {
-                  auto ofst = std::make_unique<VectorFst<Arc>>(*ifst);
-                  Decode(ofst.get(), mapper);
-                  return ofst;
-                });
+            const EncodeMapper<Arc> &mapper, size_t num_threads = 1) {
+  const auto functor = [&mapper](std::string_view key, const Fst<Arc> *ifst) {
+    auto ofst = std::make_unique<VectorFst<Arc>>(*ifst);
+    Decode(ofst.get(), mapper);
+    return ofst;
+  };
+  if (num_threads == 1) {
+    internal::Map(reader, writer, functor);
+  } else {
+    internal::ParallelMap(reader, writer, functor, num_threads);
+  }
 }
 
 }  // namespace fst
@@ -34,9 +34,11 @@
 #include <vector>
 
 #include <fst/log.h>
+#include <fst/extensions/far/packed-strings.h>
 #include <fst/extensions/far/stlist.h>
 #include <fst/extensions/far/sttable.h>
 #include <fst/arc.h>
+#include <fst/compact-fst.h>
 #include <fstream>
 #include <fst/fst.h>
 #include <fst/properties.h>
@@ -46,13 +48,16 @@
 
 namespace fst {
 
-enum class FarEntryType { LINE, FILE };
+// LINE: one FST per line; FILE: one FST per file; SET: one FST per file,
+// accepting the set of its lines.
+enum class FarEntryType { LINE, FILE, SET };
 
 enum class FarType {
   DEFAULT = 0,
   STTABLE = 1,
   STLIST = 2,
   FST = 3,
+  PACKED = 4,  // Unweighted strings only, read as CompactStringFsts.
 };
 
 // Checks for FST magic number in an input stream (to be opened given the source
@@ -93,6 +98,9 @@ class FarHeader {
       if (!ReadSTListHeader(source, &fsthdr)) return false;
       arctype_ = fsthdr.ArcType().empty() ? ErrorArc::Type() : fsthdr.ArcType();
       return true;
+    } else if (IsPackedStrings(source)) {  // Checks if packed strings.
+      fartype_ = FarType::PACKED;
+      return ReadPackedStringsArcType(source, &arctype_);
     } else if (IsFst(source)) {  // Checks if FST.
       fartype_ = FarType::FST;
       std::ifstream istrm(source,
@@ -269,6 +277,60 @@ class FstFarWriter final : public FarWriter<A> {
   bool written_;
 };
 
+// Writes FSTs that are unweighted string acceptors as a packed string table,
+// with much less space per entry than in an STTable. Other FSTs are an error.
+template <class A>
+class PackedStringFarWriter final : public FarWriter<A> {
+ public:
+  using Arc = A;
+  using Label = typename Arc::Label;
+
+  static PackedStringFarWriter *Create(std::string_view source) {
+    auto *writer = PackedStringWriter<Label>::Create(source, Arc::Type());
+    if (!writer) return nullptr;
+    return new PackedStringFarWriter(writer);
+  }
+
+  void Add(std::string_view key, const Fst<Arc> &fst) final {
+    if (!GetLabels(fst)) {
+      FSTERROR() << "PackedStringFarWriter::Add: FST is not an unweighted "
+                 << "string acceptor: " << key;
+      error_ = true;
+      return;
+    }
+    writer_->Add(key, labels_.data(), labels_.size());
+  }
+
+  FarType Type() const final { return FarType::PACKED; }
+
+  bool Error() const final { return error_ || writer_->Error(); }
+
+ private:
+  explicit PackedStringFarWriter(PackedStringWriter<Label> *writer)
+      : writer_(writer), error_(false) {}
+
+  // Stores the labels of the string accepted by fst, returning false if it is
+  // not an unweighted string acceptor.
+  bool GetLabels(const Fst<Arc> &fst) {
+    static constexpr auto props = kAcceptor | kString | kUnweighted;
+    labels_.clear();
+    if (fst.Properties(props, true) != props) return false;
+    auto s = fst.Start();
+    if (s == kNoStateId) return false;
+    while (fst.Final(s) == Arc::Weight::Zero()) {
+      ArcIterator<Fst<Arc>> aiter(fst, s);
+      const auto &arc = aiter.Value();
+      labels_.push_back(arc.ilabel);
+      s = arc.nextstate;
+    }
+    return true;
+  }
+
+  std::unique_ptr<PackedStringWriter<Label>> writer_;
+  std::vector<Label> labels_;
+  bool error_;
+};
+
 template <class Arc>
 FarWriter<Arc> *FarWriter<Arc>::Create(std::string_view source, FarType type) {
   switch (type) {
@@ -281,6 +343,8 @@ FarWriter<Arc> *FarWriter<Arc>::Create(std::string_view source, FarType type) {
       return STListFarWriter<Arc>::Create(source);
     case FarType::FST:
       return FstFarWriter<Arc>::Create(source);
+    case FarType::PACKED:
+      return PackedStringFarWriter<Arc>::Create(source);
     default:
       LOG(ERROR) << "FarWriter::Create: Unknown FAR type";
       return nullptr;
@@ -493,6 +557,82 @@ class FstFarReader final : public FarReader<A> {
   mutable bool error_;
 };
 
+// Reads a packed string table, whose entries are CompactStringFsts sharing
+// the table data, which is memory-mapped where possible, rather than copying
+// it.
+template <class A>
+class PackedStringFarReader final : public FarReader<A> {
+ public:
+  using Arc = A;
+  using Label = typename Arc::Label;
+  using StringFst = CompactStringFst<Arc>;
+
+  static PackedStringFarReader *Open(std::string_view source) {
+    auto reader =
+        fst::WrapUnique(PackedStringReader<Label>::Open(source, Arc::Type()));
+    if (!reader) return nullptr;
+    return new PackedStringFarReader(std::move(reader));
+  }
+
+  static PackedStringFarReader *Open(const std::vector<std::string> &sources) {
+    auto reader =
+        fst::WrapUnique(PackedStringReader<Label>::Open(sources, Arc::Type()));
+    if (!reader) return nullptr;
+    return new PackedStringFarReader(std::move(reader));
+  }
+
+  void Reset() final {
+    reader_->Reset();
+    fst_.reset();
+  }
+
+  bool Find(std::string_view key) final {
+    fst_.reset();
+    return reader_->Find(key);
+  }
+
+  bool Done() const final { return error_ || reader_->Done(); }
+
+  void Next() final {
+    reader_->Next();
+    fst_.reset();
+  }
+
+  const std::string &GetKey() const final { return reader_->GetKey(); }
+
+  const Fst<Arc> *GetFst() const final {
+    if (!fst_) {
+      auto store = std::make_shared<Store>(reader_->GetRegion(),
+                                           reader_->GetLabels(),
+                                           reader_->NumLabels(),
+                                           *arc_compactor_);
+      if (store->Error()) error_ = true;
+      fst_ = std::make_unique<StringFst>(
+          std::make_shared<Compactor>(arc_compactor_, std::move(store)));
+    }
+    return fst_.get();
+  }
+
+  FarType Type() const final { return FarType::PACKED; }
+
+  bool Error() const final { return error_; }
+
+ private:
+  using Compactor = typename StringFst::Compactor;
+  using Store = typename Compactor::CompactStore;
+
+  explicit PackedStringFarReader(
+      std::unique_ptr<PackedStringReader<Label>> reader)
+      : reader_(std::move(reader)),
+        arc_compactor_(std::make_shared<StringCompactor<Arc>>()),
+        error_(false) {}
+
+  std::unique_ptr<PackedStringReader<Label>> reader_;
+  std::shared_ptr<StringCompactor<Arc>> arc_compactor_;
+  mutable std::unique_ptr<StringFst> fst_;
+  mutable bool error_;
+};
+
 template <class Arc>
 FarReader<Arc> *FarReader<Arc>::Open(const std::string &source) {
   if (source.empty())
@@ -501,6 +641,8 @@ FarReader<Arc> *FarReader<Arc>::Open(const std::string &source) {
     return STTableFarReader<Arc>::Open(source);
   else if (IsSTList(source))
     return STListFarReader<Arc>::Open(source);
+  else if (IsPackedStrings(source))
+    return PackedStringFarReader<Arc>::Open(source);
   else if (IsFst(source))
     return FstFarReader<Arc>::Open(source);
   return nullptr;
@@ -514,6 +656,8 @@ FarReader<Arc> *FarReader<Arc>::Open(const std::vector<std::string> &sources) {
     return STTableFarReader<Arc>::Open(sources);
   else if (!sources.empty() && IsSTList(sources[0]))
     return STListFarReader<Arc>::Open(sources);
+  else if (!sources.empty() && IsPackedStrings(sources[0]))
+    return PackedStringFarReader<Arc>::Open(sources);
   else if (!sources.empty() && IsFst(sources[0]))
     return FstFarReader<Arc>::Open(sources);
   return nullptr;
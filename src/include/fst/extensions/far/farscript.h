@@ -21,6 +21,7 @@
 #ifndef FST_EXTENSIONS_FAR_FARSCRIPT_H_
 #define FST_EXTENSIONS_FAR_FARSCRIPT_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <tuple>
@@ -85,17 +86,17 @@ void CompileStrings(const std::vector<std::string> &sources,
                     const std::string &key_suffix);
 
 using FarConvertArgs =
-    std::tuple<FarReaderClass &, FarWriterClass &, std::string_view>;
+    std::tuple<FarReaderClass &, FarWriterClass &, std::string_view, size_t>;
 
 template <class Arc>
 void Convert(FarConvertArgs *args) {
   FarReader<Arc> &reader = *std::get<0>(*args).GetFarReader<Arc>();
   FarWriter<Arc> &writer = *std::get<1>(*args).GetFarWriter<Arc>();
-  ::fst::Convert<Arc>(reader, writer, std::get<2>(*args));
+  ::fst::Convert<Arc>(reader, writer, std::get<2>(*args), std::get<3>(*args));
 }
 
 void Convert(FarReaderClass &reader, FarWriterClass &writer,
-             std::string_view fst_type);
+             std::string_view fst_type, size_t num_threads = 1);
 
 // Note: it is safe to pass these strings as references because this struct is
 // only used to pass them deeper in the call graph. Be sure you understand why
@@ -119,19 +120,19 @@ void Create(const std::vector<std::string> &sources, FarWriterClass &writer,
             int32_t generate_keys, const std::string &key_prefix,
             const std::string &key_suffix);
 
-using FarDecodeArgs =
-    std::tuple<FarReaderClass &, FarWriterClass &, const EncodeMapperClass &>;
+using FarDecodeArgs = std::tuple<FarReaderClass &, FarWriterClass &,
+                                 const EncodeMapperClass &, size_t>;
 
 template <class Arc>
 void Decode(FarDecodeArgs *args) {
   FarReader<Arc> &reader = *std::get<0>(*args).GetFarReader<Arc>();
   FarWriter<Arc> &writer = *std::get<1>(*args).GetFarWriter<Arc>();
   const EncodeMapper<Arc> &mapper = *std::get<2>(*args).GetEncodeMapper<Arc>();
-  Decode(reader, writer, mapper);
+  Decode(reader, writer, mapper, std::get<3>(*args));
 }
 
 void Decode(FarReaderClass &reader, FarWriterClass &writer,
-            const EncodeMapperClass &encoder);
+            const EncodeMapperClass &encoder, size_t num_threads = 1);
 
 using FarEncodeArgs =
     std::tuple<FarReaderClass &, FarWriterClass &, EncodeMapperClass *>;
@@ -18,6 +18,8 @@
 #ifndef FST_EXTENSIONS_FAR_ISOMORPHIC_H_
 #define FST_EXTENSIONS_FAR_ISOMORPHIC_H_
 
+#include <cstddef>
+
 #include <fst/log.h>
 #include <fst/extensions/far/far.h>
 #include <fst/extensions/far/map-reduce.h>
@@ -28,21 +30,26 @@
 
 namespace fst {
 
+// If num_threads is not one, pairs of FSTs are compared on num_threads threads
+// (zero means one per hardware thread).
 template <class Arc>
 bool Isomorphic(FarReader<Arc> &reader1, FarReader<Arc> &reader2,
                 float delta = kDelta, std::string_view begin_key = "",
-                std::string_view end_key = "") {
-  return internal::MapAllReduce(
-      reader1, reader2,
-      [delta](std::string_view key, const Fst<Arc> *fst1,
-              const Fst<Arc> *fst2) {
-        if (!Isomorphic(*fst1, *fst2, delta)) {
-          LOG(ERROR) << "Isomorphic: FSTs for key " << key << "are not equal";
-          return false;
-        }
-        return true;
-      },
-      begin_key, end_key);
+                std::string_view end_key = "", size_t num_threads = 1) {
+  const auto functor = [delta](std::string_view key, const Fst<Arc> *fst1,
+                               const Fst<Arc> *fst2) {
+    if (!Isomorphic(*fst1, *fst2, delta)) {
+      LOG(ERROR) << "Isomorphic: FSTs for key " << key << "are not equal";
+      return false;
+    }
+    return true;
+  };
+  if (num_threads == 1) {
+    return internal::MapAllReduce(reader1, reader2, functor, begin_key,
+                                  end_key);
+  }
+  return internal::ParallelMapAllReduce(reader1, reader2, functor,
+                                        num_threads, begin_key, end_key);
 }
 
 }  // namespace fst
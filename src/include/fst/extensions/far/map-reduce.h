@@ -20,12 +20,17 @@
 #ifndef FST_EXTENSIONS_FAR_MAP_REDUCE_H_
 #define FST_EXTENSIONS_FAR_MAP_REDUCE_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <fst/log.h>
 #include <fst/extensions/far/far.h>
 #include <fst/arc.h>
 #include <fst/fst.h>
+#include <fst/parallel.h>
 #include <string_view>
 
 namespace fst {
@@ -107,6 +112,116 @@ bool MapAllReduce(FarReader<Arc> &reader1, FarReader<Arc> &reader2,
   return true;
 }
 
+// Default number of entries per thread read ahead by the parallel variants.
+inline constexpr size_t kParallelMapEntriesPerThread = 64;
+
+// Same as Map, but the functor is applied on num_threads threads (zero means
+// one per hardware thread). Entries are read in windows of at most window
+// entries (zero means kParallelMapEntriesPerThread per thread), which are
+// mapped concurrently and then written in key order, so the output is the same
+// as for Map. The functor must be safe to call concurrently.
+template <class Arc, class Functor>
+void ParallelMap(FarReader<Arc> &reader, FarWriter<Arc> &writer,
+                 Functor functor, size_t num_threads, size_t window = 0) {
+  if (window == 0) {
+    window = kParallelMapEntriesPerThread * NumWorkerThreads(num_threads);
+  }
+  std::vector<std::string> keys;
+  std::vector<std::unique_ptr<const Fst<Arc>>> ifsts;
+  std::vector<std::unique_ptr<Fst<Arc>>> ofsts;
+  while (!reader.Done()) {
+    keys.clear();
+    ifsts.clear();
+    for (; !reader.Done() && keys.size() < window; reader.Next()) {
+      keys.push_back(reader.GetKey());
+      ifsts.emplace_back(reader.GetFst()->Copy(true));
+    }
+    ofsts.clear();
+    ofsts.resize(keys.size());
+    ParallelFor(keys.size(), num_threads,
+                [&](size_t, size_t begin, size_t end) {
+                  for (auto i = begin; i < end; ++i) {
+                    ofsts[i] = functor(keys[i], ifsts[i].get());
+                  }
+                });
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (!ofsts[i]) return;
+      writer.Add(keys[i], *ofsts[i]);
+    }
+  }
+}
+
+// Same as MapAllReduce, but the functor is applied on num_threads threads
+// (zero means one per hardware thread) to windows of at most window pairs of
+// entries (zero means kParallelMapEntriesPerThread per thread). Keys are
+// checked in order as they are read. The functor must be safe to call
+// concurrently.
+template <class Arc, class Functor>
+bool ParallelMapAllReduce(FarReader<Arc> &reader1, FarReader<Arc> &reader2,
+                          Functor functor, size_t num_threads,
+                          std::string_view begin_key = "",
+                          std::string_view end_key = "", size_t window = 0) {
+  if (!begin_key.empty()) {
+    const bool find_begin1 = reader1.Find(begin_key);
+    const bool find_begin2 = reader2.Find(begin_key);
+    if (!find_begin1 || !find_begin2) {
+      const bool ret = !find_begin1 && !find_begin2;
+      if (!ret) {
+        LOG(ERROR) << "MapAllReduce: Key " << begin_key << " missing from "
+                   << (find_begin1 ? "second" : "first") << " FAR";
+      }
+      return ret;
+    }
+  }
+  if (window == 0) {
+    window = kParallelMapEntriesPerThread * NumWorkerThreads(num_threads);
+  }
+  std::vector<std::string> keys;
+  std::vector<std::unique_ptr<const Fst<Arc>>> fsts1;
+  std::vector<std::unique_ptr<const Fst<Arc>>> fsts2;
+  // Applies the functor to the pending pairs.
+  const auto reduce = [&]() {
+    std::vector<char> results(keys.size(), true);
+    ParallelFor(keys.size(), num_threads,
+                [&](size_t, size_t begin, size_t end) {
+                  for (auto i = begin; i < end; ++i) {
+                    results[i] =
+                        functor(keys[i], fsts1[i].get(), fsts2[i].get());
+                  }
+                });
+    keys.clear();
+    fsts1.clear();
+    fsts2.clear();
+    return std::find(results.begin(), results.end(), false) == results.end();
+  };
+  for (; !reader1.Done() && !reader2.Done(); reader1.Next(), reader2.Next()) {
+    const auto &key1 = reader1.GetKey();
+    const auto &key2 = reader2.GetKey();
+    if (!end_key.empty() && end_key < key1 && end_key < key2) {
+      return reduce();
+    }
+    if (key1 != key2) {
+      LOG(ERROR) << "MapAllReduce: Mismatched keys " << key1 << " and " << key2;
+      return false;
+    }
+    keys.push_back(key1);
+    fsts1.emplace_back(reader1.GetFst()->Copy(true));
+    fsts2.emplace_back(reader2.GetFst()->Copy(true));
+    if (keys.size() == window && !reduce()) return false;
+  }
+  if (!reduce()) return false;
+  if (reader1.Done() && !reader2.Done()) {
+    LOG(ERROR) << "MapAllReduce: Key " << reader2.GetKey()
+               << " missing from first FAR";
+    return false;
+  } else if (reader2.Done() && !reader1.Done()) {
+    LOG(ERROR) << "MapAllReduce: Key " << reader1.GetKey()
+               << " missing from second FAR";
+    return false;
+  }
+  return true;
+}
+
 }  // namespace internal
 }  // namespace fst
 
@@ -0,0 +1,396 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// A string-to-label-string table file format storing all strings in a single
+// label array, which can be memory-mapped.
+//
+// The file consists of:
+//
+//   magic number, file version, arc type
+//   labels: the labels of each string followed by kNoLabel (aligned)
+//   offsets: position of each string in labels, then the number of labels
+//     (aligned)
+//   key offsets: position of each key in keys, then the size of keys
+//   keys: the concatenated keys
+//   positions of labels and of offsets in the file, number of strings
+//
+// Both offset arrays are of int64_t, and the keys are in lexicographic order.
+
+#ifndef FST_EXTENSIONS_FAR_PACKED_STRINGS_H_
+#define FST_EXTENSIONS_FAR_PACKED_STRINGS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fst/log.h>
+#include <fstream>
+#include <fst/fst.h>
+#include <fst/mapped-file.h>
+#include <fst/util.h>
+#include <string_view>
+
+namespace fst {
+
+inline constexpr int32_t kPackedStringsMagicNumber = 1563491873;
+inline constexpr int32_t kPackedStringsFileVersion = 1;
+
+// Packed string table writing class for strings of labels of type Label. The
+// labels are written as they are added, and the index when the writer is
+// destroyed.
+template <class Label>
+class PackedStringWriter {
+ public:
+  PackedStringWriter(std::string_view source, std::string_view arc_type)
+      : stream_(std::string(source),
+                std::ios_base::out | std::ios_base::binary),
+        error_(false) {
+    WriteType(stream_, kPackedStringsMagicNumber);
+    WriteType(stream_, kPackedStringsFileVersion);
+    WriteType(stream_, arc_type);
+    if (!AlignOutput(stream_)) error_ = true;
+    labels_pos_ = stream_.tellp();
+    if (stream_.fail()) {
+      FSTERROR() << "PackedStringWriter::PackedStringWriter: Error writing to "
+                 << "file: " << source;
+      error_ = true;
+    }
+  }
+
+  static PackedStringWriter *Create(std::string_view source,
+                                    std::string_view arc_type) {
+    if (source.empty()) {
+      LOG(ERROR) << "PackedStringWriter: Writing to standard out unsupported.";
+      return nullptr;
+    }
+    return new PackedStringWriter(source, arc_type);
+  }
+
+  // Adds the string of n labels, none of which may be kNoLabel.
+  void Add(std::string_view key, const Label *labels, size_t n) {
+    if (key.empty()) {
+      FSTERROR() << "PackedStringWriter::Add: Key empty: " << key;
+      error_ = true;
+    } else if (key < last_key_) {
+      FSTERROR() << "PackedStringWriter::Add: Key out of order: " << key;
+      error_ = true;
+    }
+    if (error_) return;
+    last_key_.assign(key.data(), key.size());
+    offsets_.push_back(nlabels_);
+    key_offsets_.push_back(keys_.size());
+    keys_.append(key.data(), key.size());
+    stream_.write(reinterpret_cast<const char *>(labels), n * sizeof(Label));
+    WriteType(stream_, static_cast<Label>(kNoLabel));
+    nlabels_ += n + 1;
+  }
+
+  bool Error() const { return error_ || stream_.fail(); }
+
+  ~PackedStringWriter() {
+    const int64_t nstrings = offsets_.size();
+    offsets_.push_back(nlabels_);
+    key_offsets_.push_back(keys_.size());
+    AlignOutput(stream_);
+    const int64_t offsets_pos = stream_.tellp();
+    WriteIndex(offsets_);
+    WriteIndex(key_offsets_);
+    stream_.write(keys_.data(), keys_.size());
+    WriteType(stream_, labels_pos_);
+    WriteType(stream_, offsets_pos);
+    WriteType(stream_, nstrings);
+  }
+
+ private:
+  void WriteIndex(const std::vector<int64_t> &index) {
+    stream_.write(reinterpret_cast<const char *>(index.data()),
+                  index.size() * sizeof(int64_t));
+  }
+
+  std::ofstream stream_;
+  int64_t labels_pos_ = 0;
+  int64_t nlabels_ = 0;
+  std::vector<int64_t> offsets_;      // Position of each string in labels.
+  std::vector<int64_t> key_offsets_;  // Position of each key in keys_.
+  std::string keys_;                  // Concatenated keys.
+  std::string last_key_;              // Last key.
+  bool error_;
+
+  PackedStringWriter(const PackedStringWriter &) = delete;
+  PackedStringWriter &operator=(const PackedStringWriter &) = delete;
+};
+
+namespace internal {
+
+// A packed string table file, whose data, from the labels to the keys, is
+// read or mapped as a single region.
+template <class Label>
+class PackedStringTable {
+ public:
+  // Returns null on error.
+  static std::unique_ptr<PackedStringTable> Open(const std::string &source,
+                                                 std::string_view arc_type,
+                                                 bool memorymap) {
+    std::ifstream strm(source, std::ios_base::in | std::ios_base::binary);
+    if (!strm) {
+      LOG(ERROR) << "PackedStringTable: Could not open file: " << source;
+      return nullptr;
+    }
+    int32_t magic_number = 0;
+    ReadType(strm, &magic_number);
+    int32_t file_version = 0;
+    ReadType(strm, &file_version);
+    std::string file_arc_type;
+    ReadType(strm, &file_arc_type);
+    if (magic_number != kPackedStringsMagicNumber) {
+      LOG(ERROR) << "PackedStringTable: Wrong file type: " << source;
+      return nullptr;
+    }
+    if (file_version != kPackedStringsFileVersion) {
+      LOG(ERROR) << "PackedStringTable: Wrong file version: " << source;
+      return nullptr;
+    }
+    if (file_arc_type != arc_type) {
+      LOG(ERROR) << "PackedStringTable: Arc type " << file_arc_type
+                 << " does not match " << arc_type << ": " << source;
+      return nullptr;
+    }
+    int64_t labels_pos = -1;
+    int64_t offsets_pos = -1;
+    int64_t nstrings = -1;
+    strm.seekg(-3 * static_cast<int>(sizeof(int64_t)), std::ios_base::end);
+    const int64_t end = strm.tellg();
+    ReadType(strm, &labels_pos);
+    ReadType(strm, &offsets_pos);
+    ReadType(strm, &nstrings);
+    // Size of the labels, including padding, and of the offset arrays.
+    const int64_t labels_size = offsets_pos - labels_pos;
+    const int64_t index_size =
+        2 * (nstrings + 1) * static_cast<int64_t>(sizeof(int64_t));
+    if (strm.fail() || labels_pos < 0 || nstrings < 0 || labels_size < 0 ||
+        offsets_pos + index_size > end) {
+      LOG(ERROR) << "PackedStringTable: Error reading file: " << source;
+      return nullptr;
+    }
+    auto table = fst::WrapUnique(new PackedStringTable(nstrings));
+    strm.seekg(labels_pos);
+    table->region_.reset(
+        MappedFile::Map(strm, memorymap, source, end - labels_pos));
+    if (!strm || !table->region_) {
+      LOG(ERROR) << "PackedStringTable: Read failed: " << source;
+      return nullptr;
+    }
+    const auto *data = static_cast<const char *>(table->region_->data());
+    table->labels_ = reinterpret_cast<const Label *>(data);
+    table->offsets_ = reinterpret_cast<const int64_t *>(data + labels_size);
+    table->key_offsets_ = table->offsets_ + nstrings + 1;
+    table->keys_ =
+        reinterpret_cast<const char *>(table->key_offsets_ + nstrings + 1);
+    const int64_t nlabels = table->offsets_[nstrings];
+    if (nlabels < 0 ||
+        nlabels * static_cast<int64_t>(sizeof(Label)) > labels_size ||
+        offsets_pos + index_size + table->key_offsets_[nstrings] != end) {
+      LOG(ERROR) << "PackedStringTable: Ill-formed file: " << source;
+      return nullptr;
+    }
+    return table;
+  }
+
+  size_t NumStrings() const { return nstrings_; }
+
+  std::string_view Key(size_t i) const {
+    return std::string_view(keys_ + key_offsets_[i],
+                            key_offsets_[i + 1] - key_offsets_[i]);
+  }
+
+  // Returns the position of the first key >= key.
+  size_t LowerBound(std::string_view key) const {
+    size_t low = 0;
+    size_t high = nstrings_;
+    while (low < high) {
+      const auto mid = (low + high) / 2;
+      if (Key(mid) < key) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  // Labels of string i, including the terminating kNoLabel.
+  const Label *Labels(size_t i) const { return labels_ + offsets_[i]; }
+
+  size_t NumLabels(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+
+  const std::shared_ptr<MappedFile> &Region() const { return region_; }
+
+ private:
+  explicit PackedStringTable(size_t nstrings) : nstrings_(nstrings) {}
+
+  size_t nstrings_;
+  std::shared_ptr<MappedFile> region_;
+  // Unowned pointers into region_.
+  const Label *labels_ = nullptr;
+  const int64_t *offsets_ = nullptr;
+  const int64_t *key_offsets_ = nullptr;
+  const char *keys_ = nullptr;
+};
+
+}  // namespace internal
+
+// Packed string table reading class for strings of labels of type Label.
+// Several files are read as the union of their entries, in key order.
+template <class Label>
+class PackedStringReader {
+ public:
+  static PackedStringReader *Open(std::string_view source,
+                                  std::string_view arc_type,
+                                  bool memorymap = true) {
+    if (source.empty()) {
+      LOG(ERROR) << "PackedStringReader: Operation not supported on standard "
+                 << "input";
+      return nullptr;
+    }
+    return Open(std::vector<std::string>{std::string(source)}, arc_type,
+                memorymap);
+  }
+
+  static PackedStringReader *Open(const std::vector<std::string> &sources,
+                                  std::string_view arc_type,
+                                  bool memorymap = true) {
+    auto reader = fst::WrapUnique(new PackedStringReader());
+    for (const auto &source : sources) {
+      auto table = internal::PackedStringTable<Label>::Open(source, arc_type,
+                                                            memorymap);
+      if (!table) return nullptr;
+      reader->tables_.push_back(std::move(table));
+    }
+    reader->positions_.resize(reader->tables_.size(), 0);
+    reader->SetCurrent();
+    return reader.release();
+  }
+
+  void Reset() {
+    std::fill(positions_.begin(), positions_.end(), 0);
+    SetCurrent();
+  }
+
+  // Sets the current position to the first entry >= key, returning true if
+  // its key matches.
+  bool Find(std::string_view key) {
+    for (size_t i = 0; i < tables_.size(); ++i) {
+      positions_[i] = tables_[i]->LowerBound(key);
+    }
+    SetCurrent();
+    return !Done() && key_ == key;
+  }
+
+  bool Done() const { return current_ == tables_.size(); }
+
+  void Next() {
+    ++positions_[current_];
+    SetCurrent();
+  }
+
+  const std::string &GetKey() const { return key_; }
+
+  // Labels of the current string, including the terminating kNoLabel. They
+  // lie in GetRegion(), which remains valid as long as it is shared.
+  const Label *GetLabels() const {
+    return tables_[current_]->Labels(positions_[current_]);
+  }
+
+  size_t NumLabels() const {
+    return tables_[current_]->NumLabels(positions_[current_]);
+  }
+
+  const std::shared_ptr<MappedFile> &GetRegion() const {
+    return tables_[current_]->Region();
+  }
+
+ private:
+  PackedStringReader() = default;
+
+  // Sets current_ to the table with the lowest unread key, and to the number
+  // of tables if none.
+  void SetCurrent() {
+    current_ = tables_.size();
+    std::string_view key;
+    for (size_t i = 0; i < tables_.size(); ++i) {
+      if (positions_[i] == tables_[i]->NumStrings()) continue;
+      const auto table_key = tables_[i]->Key(positions_[i]);
+      if (current_ == tables_.size() || table_key < key) {
+        current_ = i;
+        key = table_key;
+      }
+    }
+    key_.assign(key.data(), key.size());
+  }
+
+  std::vector<std::unique_ptr<internal::PackedStringTable<Label>>> tables_;
+  std::vector<size_t> positions_;  // Next unread entry of each table.
+  size_t current_ = 0;             // Table of the current entry.
+  std::string key_;                // Key of the current entry.
+
+  PackedStringReader(const PackedStringReader &) = delete;
+  PackedStringReader &operator=(const PackedStringReader &) = delete;
+};
+
+// Reads the arc type of a packed string table.
+inline bool ReadPackedStringsArcType(const std::string &source,
+                                     std::string *arc_type) {
+  if (source.empty()) {
+    LOG(ERROR) << "ReadPackedStringsArcType: Can't read header from standard "
+               << "input";
+    return false;
+  }
+  std::ifstream strm(source, std::ios_base::in | std::ios_base::binary);
+  if (!strm) {
+    LOG(ERROR) << "ReadPackedStringsArcType: Could not open file: " << source;
+    return false;
+  }
+  int32_t magic_number = 0;
+  ReadType(strm, &magic_number);
+  int32_t file_version = 0;
+  ReadType(strm, &file_version);
+  ReadType(strm, arc_type);
+  if (magic_number != kPackedStringsMagicNumber ||
+      file_version != kPackedStringsFileVersion || strm.fail()) {
+    LOG(ERROR) << "ReadPackedStringsArcType: Error reading file: " << source;
+    return false;
+  }
+  return true;
+}
+
+inline bool IsPackedStrings(std::string_view source) {
+  std::ifstream strm(std::string(source),
+                     std::ios_base::in | std::ios_base::binary);
+  if (!strm.good()) return false;
+  int32_t magic_number = 0;
+  ReadType(strm, &magic_number);
+  return magic_number == kPackedStringsMagicNumber;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_FAR_PACKED_STRINGS_H_
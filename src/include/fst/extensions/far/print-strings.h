@@ -20,6 +20,7 @@
 #ifndef FST_EXTENSIONS_FAR_PRINT_STRINGS_H_
 #define FST_EXTENSIONS_FAR_PRINT_STRINGS_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <iomanip>
 #include <ios>
@@ -33,6 +34,7 @@
 #include <fst/flags.h>
 #include <fst/log.h>
 #include <fst/extensions/far/far.h>
+#include <fst/script/print-impl.h>
 #include <fstream>
 #include <fst/shortest-distance.h>
 #include <fst/string.h>
@@ -49,6 +51,10 @@ void PrintStrings(FarReader<Arc> &reader, FarEntryType entry_type,
                   const std::string &symbols_source, bool initial_symbols,
                   int32_t generate_sources, const std::string &source_prefix,
                   const std::string &source_suffix) {
+  if (entry_type == FarEntryType::SET) {
+    FSTERROR() << "PrintStrings: Entry type set is not supported";
+    return;
+  }
   std::unique_ptr<const SymbolTable> syms;
   if (!symbols_source.empty()) {
     syms.reset(SymbolTable::ReadText(symbols_source,
@@ -60,6 +66,10 @@ void PrintStrings(FarReader<Arc> &reader, FarEntryType entry_type,
     }
   }
   if (!begin_key.empty()) reader.Find(begin_key);
+  // Lines are formatted into a buffer which is written in large blocks.
+  static constexpr size_t kBufferSize = 1 << 16;
+  std::string buf;
+  internal::WeightFormatter<typename Arc::Weight> formatter(std::cout);
   std::string okey;
   int nrep = 0;
   for (int i = 1; !reader.Done(); reader.Next(), ++i) {
@@ -82,14 +92,20 @@ void PrintStrings(FarReader<Arc> &reader, FarEntryType entry_type,
                                      /*omit_epsilon=*/false);
     printer(*fst, &str);
     if (entry_type == FarEntryType::LINE) {
-      if (print_key)
-        std::cout << key << FST_FLAGS_far_field_separator[0];
-      std::cout << str;
+      if (print_key) {
+        buf.append(key);
+        buf.push_back(FST_FLAGS_far_field_separator[0]);
+      }
+      buf.append(str);
       if (print_weight) {
-        std::cout << FST_FLAGS_far_field_separator[0]
-                  << ShortestDistance(*fst);
+        buf.push_back(FST_FLAGS_far_field_separator[0]);
+        formatter.Append(ShortestDistance(*fst), &buf);
+      }
+      buf.push_back('\n');
+      if (buf.size() >= kBufferSize) {
+        std::cout.write(buf.data(), buf.size());
+        buf.clear();
       }
-      std::cout << '\n';
     } else if (entry_type == FarEntryType::FILE) {
       std::stringstream sstrm;
       if (generate_sources) {
@@ -110,6 +126,7 @@ void PrintStrings(FarReader<Arc> &reader, FarEntryType entry_type,
       if (token_type == TokenType::SYMBOL) ostrm << "\n";
     }
   }
+  std::cout.write(buf.data(), buf.size());
 }
 
 }  // namespace fst
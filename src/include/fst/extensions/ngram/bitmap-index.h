@@ -86,6 +86,24 @@
 // for a 18.75% space overhead.
 //
 // The select indices have 6.25% overhead together.
+//
+// Alternatively, the index can be built interleaved with a copy of the
+// bitstring, in the style of rank9. Each 64-byte block then holds the counts
+// followed by 6 words of the bitstring:
+//
+// struct InterleavedBlock {
+//   uint32_t ones_count;             // 1s before the block.
+//   uint64_t relative_ones_counts;  // 9 bits for each of words 1 .. 6.
+//   uint64_t words[6];
+// };
+// vector<InterleavedBlock> blocks_;
+//
+// where bits [9 * k, 9 * k + 9) of relative_ones_counts hold the 1s in
+// words[0:k] (and the 1s in the whole block for k == 6). Rank1 then touches a
+// single cache line instead of one for the index and one for the bitstring,
+// and Select0 and Select1 search the blocks directly, with select indices
+// holding the block containing every 256th 0 or 1. This costs a copy of the
+// bitstring, for a 33% overhead on top of it, but no separate rank index.
 
 namespace fst {
 
@@ -102,11 +120,20 @@ class BitmapIndex {
   // Convenience constructor to avoid a separate BuildIndex call.
   BitmapIndex(const uint64_t* bits, std::size_t num_bits,
               bool enable_select_0_index = false,
-              bool enable_select_1_index = false) {
-    BuildIndex(bits, num_bits, enable_select_0_index, enable_select_1_index);
+              bool enable_select_1_index = false, bool interleave = false) {
+    BuildIndex(bits, num_bits, enable_select_0_index, enable_select_1_index,
+               interleave);
   }
 
-  bool Get(size_t index) const { return Get(bits_, index); }
+  bool Get(size_t index) const {
+    if (!blocks_.empty()) {
+      const auto& block = blocks_[index / kBitsPerBlock];
+      const size_t offset = index % kBitsPerBlock;
+      return (block.words[offset >> kStorageLogBitSize] &
+              (kOne << (offset & kStorageBlockMask))) != 0;
+    }
+    return Get(bits_, index);
+  }
 
   static bool Get(const uint64_t* bits, size_t index) {
     return (bits[index >> kStorageLogBitSize] &
@@ -131,6 +158,7 @@ class BitmapIndex {
   // Number of bytes used to store the rank index.
   size_t IndexBytes() const {
     return (rank_index_.size() * sizeof(rank_index_[0]) +
+            blocks_.size() * sizeof(blocks_[0]) +
             select_0_index_.size() * sizeof(select_0_index_[0]) +
             select_1_index_.size() * sizeof(select_1_index_[0]));
   }
@@ -138,6 +166,7 @@ class BitmapIndex {
   // Returns the number of one bits in the bitmap
   size_t GetOnesCount() const {
     // We keep an extra entry with the total count.
+    if (!blocks_.empty()) return blocks_.back().ones_count;
     return rank_index_.back().absolute_ones_count();
   }
 
@@ -163,10 +192,12 @@ class BitmapIndex {
 
   // Rebuilds from index for the associated Bitmap, should be called
   // whenever changes have been made to the Bitmap or else behavior
-  // of the indexed bitmap methods will be undefined.
+  // of the indexed bitmap methods will be undefined. If interleave is true,
+  // the index is interleaved with a copy of the Bitmap (see above), which
+  // then no longer needs to outlive the index.
   void BuildIndex(const uint64_t* bits, size_t num_bits,
                   bool enable_select_0_index = false,
-                  bool enable_select_1_index = false);
+                  bool enable_select_1_index = false, bool interleave = false);
 
   static constexpr uint64_t kOne = 1;
   static constexpr uint32_t kStorageBitSize = 64;
@@ -178,6 +209,13 @@ class BitmapIndex {
       kUnitsPerRankIndexEntry * kStorageBitSize;
   static constexpr uint32_t kStorageBlockMask = kStorageBitSize - 1;
 
+  // Interleaved layout: words of the bitstring per block.
+  static constexpr uint32_t kWordsPerBlock = 6;
+  static constexpr uint32_t kBitsPerBlock = kWordsPerBlock * kStorageBitSize;
+  // Samples are denser than for the separate index since each probe of the
+  // interleaved blocks is a cache line rather than a fraction of one.
+  static constexpr uint32_t kBitsPerInterleavedSelectBlock = 256;
+
   // TODO(jrosenstock): benchmark different values here.
   // It's reasonable that these are the same since density is typically around
   // 1/2.
@@ -321,6 +359,38 @@ class BitmapIndex {
   static_assert(sizeof(RankIndexEntry) == 4 + 8,
                 "RankIndexEntry should be 12 bytes.");
 
+  // A block of the interleaved layout, taking one cache line.
+  struct alignas(64) InterleavedBlock {
+    // Returns the popcount of words *before* word `k` in the block, for
+    // k <= kWordsPerBlock.
+    uint32_t relative_ones_count(size_t k) const {
+      return (relative_ones_counts >> (9 * k)) & 0x1FF;
+    }
+
+    // Popcount of 1s before this block.
+    uint32_t ones_count = 0;
+    // Running popcounts within the block; see the top of the file.
+    uint64_t relative_ones_counts = 0;
+    uint64_t words[kWordsPerBlock] = {};
+  };
+  static_assert(sizeof(InterleavedBlock) == 64,
+                "InterleavedBlock should be 64 bytes.");
+
+  // Count of 0s before an interleaved block, including the padding of the
+  // last block.
+  size_t BlockZerosCount(size_t block_index) const {
+    return block_index * kBitsPerBlock - blocks_[block_index].ones_count;
+  }
+
+  void BuildInterleavedIndex(const uint64_t* bits, size_t num_bits,
+                             bool enable_select_0_index,
+                             bool enable_select_1_index);
+
+  // Versions of Rank1, Select1 and Select0 for the interleaved layout.
+  size_t InterleavedRank1(size_t end) const;
+  size_t InterleavedSelect1(size_t bit_index) const;
+  size_t InterleavedSelect0(size_t bit_index) const;
+
   // Returns, from the index, the count of ones up to array_index.
   uint32_t GetIndexOnesCount(size_t array_index) const;
 
@@ -345,11 +415,18 @@ class BitmapIndex {
 
   std::vector<RankIndexEntry> rank_index_;
 
+  // Interleaved rank index and bitstring; if non-empty, rank_index_ is empty
+  // and bits_ is unused. As with rank_index_, there is an extra block with
+  // the total count.
+  std::vector<InterleavedBlock> blocks_;
+
   // Index of positions for Select0
   // select_0_index_[i] == Select0(kBitsPerSelect0Block * i).
   // Empty means there is no index, otherwise, we always add an extra entry
   // with num_bits_. Overhead is 4 bytes / 64 bytes of zeros,
   // so 4/64 times the density of zeros. This is 6.25% * zeros_density.
+  // For the interleaved layout, the entries are instead the indices of the
+  // blocks containing these bits, and the extra entry is the last block.
   std::vector<uint32_t> select_0_index_;
 
   // Index of positions for Select1
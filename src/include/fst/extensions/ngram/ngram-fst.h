@@ -48,6 +48,7 @@
 #include <fst/fstlib.h>
 #include <fst/mapped-file.h>
 #include <fst/matcher.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/util.h>
 #include <fst/vector-fst.h>
@@ -57,6 +58,8 @@ template <class A>
 class NGramFst;
 template <class A>
 class NGramFstMatcher;
+template <class A>
+class NGramScorer;
 
 // Instance data containing mutable state for bookkeeping repeated access to
 // the same state.
@@ -108,7 +111,10 @@ class NGramFstImpl : public FstImpl<A> {
     SetProperties(kStaticProperties);
   }
 
-  NGramFstImpl(const Fst<A> &fst, std::vector<StateId> *order_out);
+  // If num_threads is not 1, the states are laid out using that many threads
+  // (0 for one per hardware thread).
+  NGramFstImpl(const Fst<A> &fst, std::vector<StateId> *order_out,
+               size_t num_threads = 1);
 
   explicit NGramFstImpl(const Fst<A> &fst) : NGramFstImpl(fst, nullptr) {}
 
@@ -262,6 +268,18 @@ class NGramFstImpl : public FstImpl<A> {
   void GetStates(const std::vector<Label> &context,
                  std::vector<StateId> *states) const;
 
+  // Reads a future label from a state, following backoff arcs until a state
+  // with that future is found. Multiplies the backoff and future weights into
+  // *weight and returns the destination state, or returns kNoStateId if the
+  // label is not even a unigram.
+  StateId Next(StateId state, Label label, Weight *weight) const;
+
+  // Returns the state reached by the backoff arc of a (non-unigram) state.
+  StateId Backoff(StateId state) const {
+    return context_index_.Rank1(context_index_.Select1(
+        context_index_.Rank0(context_index_.Select1(state)) - 1));
+  }
+
  private:
   StateId Transition(const std::vector<Label> &context, Label future) const;
 
@@ -350,6 +368,7 @@ template <class A>
 class NGramFst : public ImplToExpandedFst<internal::NGramFstImpl<A>> {
   friend class ArcIterator<NGramFst<A>>;
   friend class NGramFstMatcher<A>;
+  friend class NGramScorer<A>;
 
  public:
   typedef A Arc;
@@ -361,8 +380,10 @@ class NGramFst : public ImplToExpandedFst<internal::NGramFstImpl<A>> {
   explicit NGramFst(const Fst<A> &dst)
       : ImplToExpandedFst<Impl>(std::make_shared<Impl>(dst, nullptr)) {}
 
-  NGramFst(const Fst<A> &fst, std::vector<StateId> *order_out)
-      : ImplToExpandedFst<Impl>(std::make_shared<Impl>(fst, order_out)) {}
+  NGramFst(const Fst<A> &fst, std::vector<StateId> *order_out,
+           size_t num_threads = 1)
+      : ImplToExpandedFst<Impl>(
+            std::make_shared<Impl>(fst, order_out, num_threads)) {}
 
   // Because the NGramFstImpl is a const stateless data structure, there
   // is never a need to do anything beside copy the reference.
@@ -497,7 +518,8 @@ namespace internal {
 
 template <typename A>
 NGramFstImpl<A>::NGramFstImpl(const Fst<A> &fst,
-                              std::vector<StateId> *order_out) {
+                              std::vector<StateId> *order_out,
+                              size_t num_threads) {
   typedef A Arc;
   typedef typename Arc::Label Label;
   typedef typename Arc::Weight Weight;
@@ -668,45 +690,145 @@ NGramFstImpl<A>::NGramFstImpl(const Fst<A> &fst,
     order_out->resize(num_states);
   }
 
-  std::queue<StateId> context_q;
-  context_q.push(context_fst.Start());
   StateId state_number = 0;
-  while (!context_q.empty()) {
-    const StateId &state = context_q.front();
-    if (order_out) {
-      (*order_out)[state] = state_number;
-    }
+  if (NumWorkerThreads(num_threads) == 1) {
+    std::queue<StateId> context_q;
+    context_q.push(context_fst.Start());
+    while (!context_q.empty()) {
+      const StateId &state = context_q.front();
+      if (order_out) {
+        (*order_out)[state] = state_number;
+      }
 
-    const Weight final_weight = context_fst.Final(state);
-    if (final_weight != Weight::Zero()) {
-      BitmapIndex::Set(final_bits, state_number);
-      final_probs[final_bit] = final_weight;
-      ++final_bit;
-    }
+      const Weight final_weight = context_fst.Final(state);
+      if (final_weight != Weight::Zero()) {
+        BitmapIndex::Set(final_bits, state_number);
+        final_probs[final_bit] = final_weight;
+        ++final_bit;
+      }
 
-    for (ArcIterator<VectorFst<A>> aiter(context_fst, state); !aiter.Done();
-         aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      context_words[context_arc] = arc.ilabel;
-      backoff[context_arc] = arc.weight;
-      ++context_arc;
-      BitmapIndex::Set(context_bits, context_bit++);
-      context_q.push(arc.nextstate);
-    }
-    ++context_bit;
+      for (ArcIterator<VectorFst<A>> aiter(context_fst, state);
+           !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        context_words[context_arc] = arc.ilabel;
+        backoff[context_arc] = arc.weight;
+        ++context_arc;
+        BitmapIndex::Set(context_bits, context_bit++);
+        context_q.push(arc.nextstate);
+      }
+      ++context_bit;
 
-    for (ArcIterator<Fst<A>> aiter(fst, state); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      if (arc.ilabel != 0) {
-        future_words[future_arc] = arc.ilabel;
-        future_probs[future_arc] = arc.weight;
-        ++future_arc;
-        BitmapIndex::Set(future_bits, future_bit++);
+      for (ArcIterator<Fst<A>> aiter(fst, state); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel != 0) {
+          future_words[future_arc] = arc.ilabel;
+          future_probs[future_arc] = arc.weight;
+          ++future_arc;
+          BitmapIndex::Set(future_bits, future_bit++);
+        }
+      }
+      ++future_bit;
+      ++state_number;
+      context_q.pop();
+    }
+  } else {
+    // Lists the states in the same breadth-first order, counts the context
+    // arcs, futures and final states of blocks of them in parallel, then
+    // fills each block from its offsets in parallel. Blocks may share words
+    // of the bitmaps, so the bits are set atomically.
+    std::vector<StateId> order;
+    order.reserve(num_states);
+    order.push_back(context_fst.Start());
+    for (size_t i = 0;
+         i < order.size() && static_cast<int64_t>(order.size()) <= num_states;
+         ++i) {
+      for (ArcIterator<VectorFst<A>> aiter(context_fst, order[i]);
+           !aiter.Done(); aiter.Next()) {
+        order.push_back(aiter.Value().nextstate);
       }
     }
-    ++future_bit;
-    ++state_number;
-    context_q.pop();
+    struct Counts {
+      int64_t context_arcs = 0;
+      int64_t futures = 0;
+      int64_t finals = 0;
+    };
+    std::vector<Counts> offsets(NumWorkerThreads(num_threads) + 1);
+    const auto nblocks = ParallelFor(
+        order.size(), num_threads, [&](size_t b, size_t begin, size_t end) {
+          std::unique_ptr<const Fst<A>> copy(fst.Copy(true));
+          auto &counts = offsets[b + 1];
+          for (auto i = begin; i < end; ++i) {
+            const auto state = order[i];
+            counts.context_arcs += context_fst.NumArcs(state);
+            counts.futures +=
+                copy->NumArcs(state) - copy->NumInputEpsilons(state);
+            if (context_fst.Final(state) != Weight::Zero()) ++counts.finals;
+          }
+        });
+    for (size_t b = 0; b < nblocks; ++b) {
+      offsets[b + 1].context_arcs += offsets[b].context_arcs;
+      offsets[b + 1].futures += offsets[b].futures;
+      offsets[b + 1].finals += offsets[b].finals;
+    }
+    const auto &totals = offsets[nblocks];
+    if (static_cast<int64_t>(order.size()) != num_states ||
+        context_arc + totals.context_arcs != num_states ||
+        totals.futures != num_futures || totals.finals != num_final) {
+      FSTERROR() << "Structure problems detected during construction";
+      SetProperties(kError, kError);
+      return;
+    }
+    const auto set_bit = [](uint64_t *bits, size_t index) {
+      __atomic_fetch_or(&bits[index >> BitmapIndex::kStorageLogBitSize],
+                        BitmapIndex::kOne
+                            << (index & (BitmapIndex::kStorageBitSize - 1)),
+                        __ATOMIC_RELAXED);
+    };
+    ParallelFor(order.size(), num_threads, [&](size_t b, size_t begin,
+                                               size_t end) {
+      std::unique_ptr<const Fst<A>> copy(fst.Copy(true));
+      auto block_context_arc = context_arc + offsets[b].context_arcs;
+      auto block_context_bit = context_bit + begin + offsets[b].context_arcs;
+      auto block_future_arc = offsets[b].futures;
+      auto block_future_bit = future_bit + begin + offsets[b].futures;
+      auto block_final_bit = offsets[b].finals;
+      for (auto i = begin; i < end; ++i) {
+        const auto state = order[i];
+        if (order_out) (*order_out)[state] = i;
+        const Weight final_weight = context_fst.Final(state);
+        if (final_weight != Weight::Zero()) {
+          set_bit(final_bits, i);
+          final_probs[block_final_bit++] = final_weight;
+        }
+        for (ArcIterator<VectorFst<A>> aiter(context_fst, state);
+             !aiter.Done(); aiter.Next()) {
+          const Arc &arc = aiter.Value();
+          context_words[block_context_arc] = arc.ilabel;
+          backoff[block_context_arc] = arc.weight;
+          ++block_context_arc;
+          set_bit(context_bits, block_context_bit++);
+        }
+        ++block_context_bit;
+        for (ArcIterator<Fst<A>> aiter(*copy, state); !aiter.Done();
+             aiter.Next()) {
+          const Arc &arc = aiter.Value();
+          if (arc.ilabel != 0) {
+            future_words[block_future_arc] = arc.ilabel;
+            future_probs[block_future_arc] = arc.weight;
+            ++block_future_arc;
+            set_bit(future_bits, block_future_bit++);
+          }
+        }
+        ++block_future_bit;
+      }
+    });
+    state_number = order.size();
+    context_arc += totals.context_arcs;
+    context_bit += order.size() + totals.context_arcs;
+    future_arc = totals.futures;
+    future_bit += order.size() + totals.futures;
+    final_bit = totals.finals;
   }
 
   if ((state_number != num_states) || (context_bit != num_states * 2 + 1) ||
@@ -753,12 +875,16 @@ inline void NGramFstImpl<A>::Init(const char *data,
   offset += num_final_ * sizeof(*final_probs_);
   future_probs_ = reinterpret_cast<const Weight *>(data_ + offset);
 
+  // The LOUDS traversal alternates rank and select on these, so they use the
+  // interleaved layout that keeps the counts next to the bits.
   context_index_.BuildIndex(context_, context_bits,
                             /*enable_select_0_index=*/true,
-                            /*enable_select_1_index=*/true);
+                            /*enable_select_1_index=*/true,
+                            /*interleave=*/true);
   future_index_.BuildIndex(future_, future_bits,
                            /*enable_select_0_index=*/true,
-                           /*enable_select_1_index=*/false);
+                           /*enable_select_1_index=*/false,
+                           /*interleave=*/true);
   final_index_.BuildIndex(final_, num_states_);
 
   select_root_ = context_index_.Select0s(0);
@@ -810,6 +936,29 @@ inline typename A::StateId NGramFstImpl<A>::Transition(
   return node_rank;
 }
 
+template <typename A>
+typename A::StateId NGramFstImpl<A>::Next(StateId state, Label label,
+                                          Weight *weight) const {
+  while (true) {
+    const auto zeros = future_index_.Select0s(state);
+    const size_t offset = future_index_.Rank1(zeros.first + 1);
+    const Label *start = future_words_ + offset;
+    const Label *end = start + (zeros.second - zeros.first - 1);
+    const Label *search = std::lower_bound(start, end, label);
+    if (search != end && *search == label) {
+      *weight = Times(*weight, future_probs_[offset + (search - start)]);
+      if (state == 0) return Transition(std::vector<Label>(), label);
+      NGramFstInst<A> inst;
+      inst.state_ = state;
+      SetInstContext(&inst);
+      return Transition(inst.context_, label);
+    }
+    if (state == 0) return kNoStateId;
+    *weight = Times(*weight, backoff_[state]);
+    state = Backoff(state);
+  }
+}
+
 }  // namespace internal
 
 /*****************************************************************************/
@@ -1050,5 +1199,117 @@ class ArcIterator<NGramFst<A>> : public ArcIteratorBase<A> {
   uint8_t flags_;
 };
 
+/*****************************************************************************/
+// Scores label sequences against an NGramFst, treating the backoff arcs as
+// failure transitions: a label that is not a future of the current state is
+// read after following backoff arcs until a state with that future is found.
+// Recently used (state, label) transitions, including the backoffs taken to
+// resolve them, are kept in a direct-mapped cache, so that rescoring many
+// hypotheses that share histories mostly avoids the rank/select walks of the
+// LOUDS structure. Not thread-safe; use one scorer per thread.
+template <class A>
+class NGramScorer {
+ public:
+  using Arc = A;
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  // The cache has the given number of entries, rounded up to a power of two.
+  explicit NGramScorer(const NGramFst<A> &fst, size_t cache_size = 1 << 16)
+      : fst_(fst.Copy()), impl_(fst_->GetImpl()) {
+    size_t size = 1;
+    while (size < cache_size) size <<= 1;
+    cache_.resize(size);
+  }
+
+  // Returns the weight of reading the n labels from state, and sets
+  // *nextstate (if non-null) to the state reached. Returns Weight::Zero() and
+  // kNoStateId if some label is not in the model.
+  Weight Score(StateId state, const Label *labels, size_t n,
+               StateId *nextstate = nullptr) {
+    auto weight = Weight::One();
+    for (size_t i = 0; i < n && state != kNoStateId; ++i) {
+      state = Next(state, labels[i], &weight);
+    }
+    if (nextstate) *nextstate = state;
+    return state == kNoStateId ? Weight::Zero() : weight;
+  }
+
+  Weight Score(StateId state, const std::vector<Label> &labels,
+               StateId *nextstate = nullptr) {
+    return Score(state, labels.data(), labels.size(), nextstate);
+  }
+
+  // Scores a batch of queries, the i-th reading labels[i] from states[i].
+  // The queries are advanced in lockstep, a label at a time, so that the
+  // cache lines for one round of lookups are prefetched together rather than
+  // waited on one at a time.
+  void Score(const std::vector<StateId> &states,
+             const std::vector<std::vector<Label>> &labels,
+             std::vector<Weight> *weights,
+             std::vector<StateId> *nextstates = nullptr) {
+    const size_t num_queries = std::min(states.size(), labels.size());
+    weights->assign(num_queries, Weight::One());
+    std::vector<StateId> current(states.begin(),
+                                 states.begin() + num_queries);
+    std::vector<size_t> active;
+    active.reserve(num_queries);
+    for (size_t i = 0; i < num_queries; ++i) {
+      if (!labels[i].empty() && current[i] != kNoStateId) active.push_back(i);
+    }
+    for (size_t pos = 0; !active.empty(); ++pos) {
+      for (const auto i : active) {
+        __builtin_prefetch(&cache_[Slot(current[i], labels[i][pos])]);
+      }
+      size_t num_active = 0;
+      for (const auto i : active) {
+        current[i] = Next(current[i], labels[i][pos], &(*weights)[i]);
+        if (current[i] != kNoStateId && pos + 1 < labels[i].size()) {
+          active[num_active++] = i;
+        }
+      }
+      active.resize(num_active);
+    }
+    for (size_t i = 0; i < num_queries; ++i) {
+      if (current[i] == kNoStateId) (*weights)[i] = Weight::Zero();
+    }
+    if (nextstates) *nextstates = std::move(current);
+  }
+
+  const NGramFst<A> &GetFst() const { return *fst_; }
+
+ private:
+  struct CacheEntry {
+    StateId state = kNoStateId;
+    Label label = kNoLabel;
+    StateId nextstate = kNoStateId;
+    Weight weight;
+  };
+
+  size_t Slot(StateId state, Label label) const {
+    const auto key = (static_cast<uint64_t>(state) << 32) ^
+                     static_cast<uint64_t>(static_cast<uint32_t>(label));
+    return (key * 0x9e3779b97f4a7c15ULL >> 32) & (cache_.size() - 1);
+  }
+
+  // Reads a label from state, multiplying the weight into *weight.
+  StateId Next(StateId state, Label label, Weight *weight) {
+    auto &entry = cache_[Slot(state, label)];
+    if (entry.state != state || entry.label != label) {
+      entry.state = state;
+      entry.label = label;
+      entry.weight = Weight::One();
+      entry.nextstate = impl_->Next(state, label, &entry.weight);
+    }
+    *weight = Times(*weight, entry.weight);
+    return entry.nextstate;
+  }
+
+  std::unique_ptr<NGramFst<A>> fst_;
+  const internal::NGramFstImpl<A> *impl_;
+  std::vector<CacheEntry> cache_;
+};
+
 }  // namespace fst
 #endif  // FST_EXTENSIONS_NGRAM_NGRAM_FST_H_
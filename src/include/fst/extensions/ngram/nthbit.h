@@ -59,9 +59,28 @@ int nth_bit(uint64_t v, uint32_t r);
 #elif SIZE_MAX == UINT64_MAX
 // Default 64-bit version, used by ARM64 and Intel < Haswell.
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// Binaries built without BMI2 still use PDEP when the CPU has it, except on
+// AMD Zen 1 and 2, where it is microcoded and slower than the broadword code.
+#define FST_NTHBIT_RUNTIME_PDEP
+#include <immintrin.h>
+#endif
+
 namespace fst {
 namespace internal {
 
+#if defined(FST_NTHBIT_RUNTIME_PDEP)
+__attribute__((target("bmi2"))) inline int nth_bit_pdep(uint64_t v,
+                                                        uint32_t r) {
+  return __builtin_ctzll(_pdep_u64(uint64_t{1} << r, v));
+}
+
+inline const bool kUsePdep =
+    (__builtin_cpu_init(), __builtin_cpu_supports("bmi2") &&
+                               !__builtin_cpu_is("znver1") &&
+                               !__builtin_cpu_is("znver2"));
+#endif
+
 constexpr std::array<uint64_t, 64> PrefixSumOverflows() {
   std::array<uint64_t, 64> a{};
   constexpr uint64_t kOnesStep8 = 0x0101010101010101;
@@ -91,6 +110,10 @@ inline int nth_bit(const uint64_t v, const uint32_t r) {
   DCHECK_LE(0, r);
   DCHECK_LT(r, __builtin_popcountll(v));
 
+#if defined(FST_NTHBIT_RUNTIME_PDEP)
+  if (internal::kUsePdep) return internal::nth_bit_pdep(v, r);
+#endif
+
 #if defined(__aarch64__)
   // Use the ARM64 CNT instruction to compute a byte-wise popcount.
   const uint64_t s =
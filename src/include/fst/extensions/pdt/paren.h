@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <set>
 #include <utility>
 #include <vector>
@@ -36,7 +37,6 @@
 #include <fst/fst.h>
 #include <fst/util.h>
 #include <unordered_map>
-#include <unordered_set>
 
 namespace fst {
 namespace internal {
@@ -94,6 +94,163 @@ class SpanIterator {
   ValueType *it_ = nullptr;
 };
 
+// Open-addressing hash map with linear probing that stores its entries inline
+// in one power-of-two sized array, avoiding the per-entry allocations of
+// std::unordered_map. The key passed to the constructor is reserved to mark
+// empty slots. Erasure shifts later entries of the probe sequence back, so no
+// tombstones are needed. Pointers returned by Find() and Insert() are
+// invalidated by any later insertion or erasure.
+template <class K, class V, class H = std::hash<K>>
+class FlatHashMap {
+ public:
+  explicit FlatHashMap(const K &empty_key = K(), const H &hash = H())
+      : empty_key_(empty_key), hash_(hash) {}
+
+  size_t Size() const { return size_; }
+
+  void Clear() {
+    slots_.clear();
+    size_ = 0;
+    mask_ = 0;
+    shift_ = 0;
+  }
+
+  // Returns the value stored for the key, or nullptr if not found.
+  const V *Find(const K &key) const {
+    if (size_ == 0) return nullptr;
+    for (auto i = Bucket(key);; i = (i + 1) & mask_) {
+      const auto &slot = slots_[i];
+      if (slot.first == key) return &slot.second;
+      if (slot.first == empty_key_) return nullptr;
+    }
+  }
+
+  V *Find(const K &key) {
+    return const_cast<V *>(std::as_const(*this).Find(key));
+  }
+
+  // Inserts the value unless the key is present. Returns the stored value and
+  // whether the insertion took place.
+  std::pair<V *, bool> Insert(const K &key, const V &value) {
+    if (2 * (size_ + 1) > slots_.size()) Grow();
+    auto i = Bucket(key);
+    for (; !(slots_[i].first == empty_key_); i = (i + 1) & mask_) {
+      if (slots_[i].first == key) return {&slots_[i].second, false};
+    }
+    slots_[i] = {key, value};
+    ++size_;
+    return {&slots_[i].second, true};
+  }
+
+  V &operator[](const K &key) { return *Insert(key, V()).first; }
+
+  // Removes the key, returning false if it was not found.
+  bool Erase(const K &key) {
+    if (size_ == 0) return false;
+    auto i = Bucket(key);
+    for (; !(slots_[i].first == key); i = (i + 1) & mask_) {
+      if (slots_[i].first == empty_key_) return false;
+    }
+    for (auto j = (i + 1) & mask_; !(slots_[j].first == empty_key_);
+         j = (j + 1) & mask_) {
+      // Moves the entry at j into the hole at i unless its home bucket lies
+      // cyclically in (i, j].
+      const auto home = Bucket(slots_[j].first);
+      if (((j - home) & mask_) >= ((j - i) & mask_)) {
+        slots_[i] = std::move(slots_[j]);
+        i = j;
+      }
+    }
+    slots_[i] = {empty_key_, V()};
+    --size_;
+    return true;
+  }
+
+  // Calls f(key, value) for each entry.
+  template <class F>
+  void ForEach(F f) const {
+    for (const auto &slot : slots_) {
+      if (!(slot.first == empty_key_)) f(slot.first, slot.second);
+    }
+  }
+
+ private:
+  // Fibonacci hashing spreads weak hash functions over the table.
+  size_t Bucket(const K &key) const {
+    return (static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ULL) >>
+           shift_;
+  }
+
+  void Grow() {
+    std::vector<std::pair<K, V>> slots(
+        std::max<size_t>(2 * slots_.size(), 8), {empty_key_, V()});
+    slots.swap(slots_);
+    mask_ = slots_.size() - 1;
+    shift_ = 64;
+    for (auto n = slots_.size(); n > 1; n >>= 1) --shift_;
+    for (auto &slot : slots) {
+      if (slot.first == empty_key_) continue;
+      auto i = Bucket(slot.first);
+      while (!(slots_[i].first == empty_key_)) i = (i + 1) & mask_;
+      slots_[i] = std::move(slot);
+    }
+  }
+
+  K empty_key_;
+  H hash_;
+  std::vector<std::pair<K, V>> slots_;
+  size_t size_ = 0;
+  size_t mask_ = 0;
+  int shift_ = 0;
+};
+
+// Singly-linked lists of values sharing one node array. The nodes of released
+// lists are reused by later insertions.
+template <class T>
+class ListPool {
+ public:
+  static constexpr ssize_t kNoNode = -1;
+
+  // Prepends the value to the list beginning at node head (kNoNode for an
+  // empty list) and returns the new head.
+  ssize_t Push(ssize_t head, T value) {
+    if (free_ == kNoNode) {
+      nodes_.push_back({value, head});
+      return nodes_.size() - 1;
+    }
+    const auto node = free_;
+    free_ = nodes_[node].next;
+    nodes_[node] = {value, head};
+    return node;
+  }
+
+  // Appends the values of the list to values, then frees its nodes.
+  void Release(ssize_t head, std::vector<T> *values) {
+    while (head != kNoNode) {
+      auto &node = nodes_[head];
+      values->push_back(node.value);
+      const auto next = node.next;
+      node.next = free_;
+      free_ = head;
+      head = next;
+    }
+  }
+
+  void Clear() {
+    nodes_.clear();
+    free_ = kNoNode;
+  }
+
+ private:
+  struct Node {
+    T value;
+    ssize_t next;
+  };
+
+  std::vector<Node> nodes_;
+  ssize_t free_ = kNoNode;
+};
+
 // PdtParenReachable: Provides various parenthesis reachability information.
 
 template <class Arc>
@@ -105,22 +262,22 @@ class PdtParenReachable {
   using State = ParenState<Arc>;
   using StateHash = typename State::Hash;
 
-  // Maps from state ID to reachable paren IDs from (to) that state.
-  using ParenMultimap = std::unordered_map<StateId, std::vector<Label>>;
+  // Range of a packed value array.
+  struct Span {
+    size_t begin = 0;
+    size_t end = 0;
+  };
 
   // Maps from paren ID and state ID to reachable state set ID.
-  using StateSetMap = std::unordered_map<State, ssize_t, StateHash>;
+  using StateSetMap = FlatHashMap<State, ssize_t, StateHash>;
 
-  // Maps from paren ID and state ID to arcs exiting that state with that
-  // Label.
-  using ParenArcMultimap =
-      std::unordered_map<State, std::vector<Arc>, StateHash>;
+  // Maps from paren ID and state ID to the span of arcs exiting that state
+  // with that label.
+  using ParenArcMultimap = FlatHashMap<State, Span, StateHash>;
 
-  using ParenIterator =
-      SpanIterator<typename ParenMultimap::mapped_type::value_type>;
+  using ParenIterator = SpanIterator<Label>;
 
-  using ParenArcIterator =
-      SpanIterator<typename ParenArcMultimap::mapped_type::value_type>;
+  using ParenArcIterator = SpanIterator<Arc>;
 
   using SetIterator = typename Collection<ssize_t, StateId>::SetIterator;
 
@@ -154,16 +311,10 @@ class PdtParenReachable {
   // Given a state ID, returns an iterator over paren IDs for close (open)
   // parens reachable from that state along balanced paths.
   ParenIterator FindParens(StateId s) const {
-    const auto parens = paren_multimap_.find(s);
-    if (parens != paren_multimap_.end()) {
-      // Cannot dereference iterators if the vector is empty, but that never
-      // happens. ComputeStateSet always adds something to the vector,
-      // and never leaves an empty vector.
-      DCHECK(!parens->second.empty());
-      return ParenIterator(&*parens->second.begin(), &*parens->second.end());
-    } else {
-      return ParenIterator();
-    }
+    if (s >= paren_spans_.size()) return ParenIterator();
+    const auto &span = paren_spans_[s];
+    return ParenIterator(paren_ids_.data() + span.begin,
+                         paren_ids_.data() + span.end);
   }
 
   // Given a paren ID and a state ID s, returns an iterator over states that can
@@ -171,12 +322,8 @@ class PdtParenReachable {
   // parentheses matching the paren ID exiting (entering) those states.
   SetIterator FindStates(Label paren_id, StateId s) const {
     const State paren_state(paren_id, s);
-    const auto it = set_map_.find(paren_state);
-    if (it == set_map_.end()) {
-      return state_sets_.FindSet(-1);
-    } else {
-      return state_sets_.FindSet(it->second);
-    }
+    const auto *set_id = set_map_.Find(paren_state);
+    return state_sets_.FindSet(set_id ? *set_id : -1);
   }
 
   // Given a paren ID and a state ID s, return an iterator over arcs that exit
@@ -184,17 +331,10 @@ class PdtParenReachable {
   // paren ID.
   ParenArcIterator FindParenArcs(Label paren_id, StateId s) const {
     const State paren_state(paren_id, s);
-    const auto paren_arcs = paren_arc_multimap_.find(paren_state);
-    if (paren_arcs != paren_arc_multimap_.end()) {
-      // Cannot dereference iterators if the vector is empty, but that never
-      // happens. ComputeStateSet always adds something to the vector,
-      // and never leaves an empty vector.
-      DCHECK(!paren_arcs->second.empty());
-      return ParenArcIterator(&*paren_arcs->second.begin(),
-                              &*paren_arcs->second.end());
-    } else {
-      return ParenArcIterator();
-    }
+    const auto *span = paren_arc_multimap_.Find(paren_state);
+    if (!span) return ParenArcIterator();
+    return ParenArcIterator(paren_arcs_.data() + span->begin,
+                            paren_arcs_.data() + span->end);
   }
 
  private:
@@ -216,10 +356,12 @@ class PdtParenReachable {
   const bool close_;
   // Labels to paren IDs.
   std::unordered_map<Label, Label> paren_map_;
-  // Paren reachability.
-  ParenMultimap paren_multimap_;
-  // Paren arcs.
+  // Paren reachability: spans of paren_ids_ per state.
+  std::vector<Span> paren_spans_;
+  std::vector<Label> paren_ids_;
+  // Paren arcs: spans of paren_arcs_ per paren and state.
   ParenArcMultimap paren_arc_multimap_;
+  std::vector<Arc> paren_arcs_;
   // DFS states.
   std::vector<uint8_t> state_color_;
   // Reachable states to IDs.
@@ -251,7 +393,7 @@ bool PdtParenReachable<Arc>::DFSearch(StateId s) {
         if (!DFSearch(arc.nextstate)) return false;
         for (auto set_iter = FindStates(paren_id, arc.nextstate);
              !set_iter.Done(); set_iter.Next()) {
-          // Recursive DFSearch call may modify paren_arc_multimap_ via
+          // Recursive DFSearch call may append to paren_arcs_ via
           // ComputeStateSet, so save the paren arcs to avoid issues
           // with iterator invalidation.
           std::vector<StateId> cp_nextstates;
@@ -279,6 +421,7 @@ template <class Arc>
 void PdtParenReachable<Arc>::ComputeStateSet(StateId s) {
   std::set<Label> paren_set;
   std::vector<std::set<StateId>> state_sets(parens_.size());
+  std::vector<std::pair<Label, Arc>> close_arcs;
   for (ArcIterator<Fst<Arc>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
     const auto &arc = aiter.Value();
     const auto it = paren_map_.find(arc.ilabel);
@@ -297,16 +440,33 @@ void PdtParenReachable<Arc>::ComputeStateSet(StateId s) {
       } else {  // Close paren.
         paren_set.insert(paren_id);
         state_sets[paren_id].insert(s);
-        const State paren_state(paren_id, s);
-        paren_arc_multimap_[paren_state].push_back(arc);
+        close_arcs.emplace_back(paren_id, arc);
       }
     } else {  // Non-paren.
       UpdateStateSet(arc.nextstate, &paren_set, &state_sets);
     }
   }
+  // Packs the close paren arcs of s grouped by paren ID.
+  std::stable_sort(
+      close_arcs.begin(), close_arcs.end(),
+      [](const std::pair<Label, Arc> &a, const std::pair<Label, Arc> &b) {
+        return a.first < b.first;
+      });
+  for (size_t i = 0; i < close_arcs.size();) {
+    const auto paren_id = close_arcs[i].first;
+    Span span;
+    span.begin = paren_arcs_.size();
+    for (; i < close_arcs.size() && close_arcs[i].first == paren_id; ++i) {
+      paren_arcs_.push_back(close_arcs[i].second);
+    }
+    span.end = paren_arcs_.size();
+    paren_arc_multimap_[State(paren_id, s)] = span;
+  }
+  if (s >= paren_spans_.size()) paren_spans_.resize(s + 1);
+  paren_spans_[s].begin = paren_ids_.size();
   std::vector<StateId> state_vec;
   for (const Label paren_id : paren_set) {
-    paren_multimap_[s].push_back(paren_id);
+    paren_ids_.push_back(paren_id);
 
     const std::set<StateId> &state_set = state_sets[paren_id];
     state_vec.assign(state_set.begin(), state_set.end());
@@ -314,6 +474,7 @@ void PdtParenReachable<Arc>::ComputeStateSet(StateId s) {
     const State paren_state(paren_id, s);
     set_map_[paren_state] = state_sets_.FindId(state_vec);
   }
+  paren_spans_[s].end = paren_ids_.size();
 }
 
 // Gathers state sets.
@@ -343,33 +504,34 @@ class PdtBalanceData {
   using State = ParenState<Arc>;
   using StateHash = typename State::Hash;
 
-  // Set for open parens.
-  using OpenParenSet = std::unordered_set<State, StateHash>;
+  // Maps from open paren state to the list of source states of matching close
+  // parens. Open paren states are present from OpenInsert() to FinishInsert().
+  using CloseParenMap = FlatHashMap<State, ssize_t, StateHash>;
 
-  // Maps from open paren destination state to parenthesis ID.
-  using OpenParenMap = std::unordered_map<StateId, std::vector<Label>>;
-
-  // Maps from open paren state to source states of matching close parens
-  using CloseParenMap =
-      std::unordered_map<State, std::vector<StateId>, StateHash>;
+  // Maps from open paren destination state to the list of parenthesis IDs.
+  using OpenParenMap = FlatHashMap<StateId, ssize_t>;
 
   // Maps from open paren state to close source set ID.
-  using CloseSourceMap = std::unordered_map<State, ssize_t, StateHash>;
+  using CloseSourceMap = FlatHashMap<State, ssize_t, StateHash>;
 
   using SetIterator = typename Collection<ssize_t, StateId>::SetIterator;
 
   PdtBalanceData() = default;
 
   void Clear() {
-    open_paren_map_.clear();
-    close_paren_map_.clear();
+    open_paren_map_.Clear();
+    close_paren_map_.Clear();
+    paren_lists_.Clear();
+    state_lists_.Clear();
   }
 
   // Adds an open parenthesis with destination state open_dest.
   void OpenInsert(Label paren_id, StateId open_dest) {
     const State key(paren_id, open_dest);
-    if (open_paren_set_.insert(key).second) {
-      open_paren_map_[open_dest].push_back(paren_id);
+    if (close_paren_map_.Insert(key, ListPool<StateId>::kNoNode).second) {
+      auto *parens =
+          open_paren_map_.Insert(open_dest, ListPool<Label>::kNoNode).first;
+      *parens = paren_lists_.Push(*parens, paren_id);
     }
   }
 
@@ -378,8 +540,8 @@ class PdtBalanceData {
   // OpenInsert() previously called.
   void CloseInsert(Label paren_id, StateId open_dest, StateId close_source) {
     const State key(paren_id, open_dest);
-    if (open_paren_set_.count(key)) {
-      close_paren_map_[key].push_back(close_source);
+    if (auto *close_sources = close_paren_map_.Find(key)) {
+      *close_sources = state_lists_.Push(*close_sources, close_source);
     }
   }
 
@@ -388,36 +550,33 @@ class PdtBalanceData {
   // called only after FinishInsert(open_dest).
   SetIterator Find(Label paren_id, StateId open_dest) {
     const State key(paren_id, open_dest);
-    const auto it = close_source_map_.find(key);
-    if (it == close_source_map_.end()) {
-      return close_source_sets_.FindSet(-1);
-    } else {
-      return close_source_sets_.FindSet(it->second);
-    }
+    const auto *set_id = close_source_map_.Find(key);
+    return close_source_sets_.FindSet(set_id ? *set_id : -1);
   }
 
   // Called when all open and close parenthesis insertions (w.r.t. open
   // parentheses entering state open_dest) are finished. Must be called before
   // Find(open_dest).
   void FinishInsert(StateId open_dest) {
-    const auto open_parens = open_paren_map_.find(open_dest);
-    if (open_parens != open_paren_map_.end()) {
-      for (const Label paren_id : open_parens->second) {
-        const State key(paren_id, open_dest);
-        open_paren_set_.erase(key);
-        const auto close_paren_it = close_paren_map_.find(key);
-        CHECK(close_paren_it != close_paren_map_.end());
-        std::vector<StateId> &close_sources = close_paren_it->second;
-        std::sort(close_sources.begin(), close_sources.end());
-        auto unique_end =
-            std::unique(close_sources.begin(), close_sources.end());
-        close_sources.resize(unique_end - close_sources.begin());
-        if (!close_sources.empty()) {
-          close_source_map_[key] = close_source_sets_.FindId(close_sources);
-        }
-        close_paren_map_.erase(close_paren_it);
+    const auto *open_parens = open_paren_map_.Find(open_dest);
+    if (!open_parens) return;
+    std::vector<Label> paren_ids;
+    paren_lists_.Release(*open_parens, &paren_ids);
+    open_paren_map_.Erase(open_dest);
+    std::vector<StateId> close_sources;
+    for (const Label paren_id : paren_ids) {
+      const State key(paren_id, open_dest);
+      const auto *close_paren = close_paren_map_.Find(key);
+      DCHECK(close_paren);
+      close_sources.clear();
+      state_lists_.Release(*close_paren, &close_sources);
+      close_paren_map_.Erase(key);
+      std::sort(close_sources.begin(), close_sources.end());
+      auto unique_end = std::unique(close_sources.begin(), close_sources.end());
+      close_sources.resize(unique_end - close_sources.begin());
+      if (!close_sources.empty()) {
+        close_source_map_[key] = close_source_sets_.FindId(close_sources);
       }
-      open_paren_map_.erase(open_parens);
     }
   }
 
@@ -427,16 +586,13 @@ class PdtBalanceData {
                                StateId state_id_shift) const;
 
  private:
-  // Open paren at destintation state?
-  OpenParenSet open_paren_set_;
   // Open parens per state.
-  OpenParenMap open_paren_map_;
-  // Current open destination state.
-  State open_dest_;
-  // Current open paren/state.
-  typename OpenParenMap::const_iterator open_iter_;
-  // Close states to (open paren, state).
+  OpenParenMap open_paren_map_{kNoStateId};
+  // Open paren/state to close states.
   CloseParenMap close_paren_map_;
+  // Node storage for the lists in open_paren_map_ and close_paren_map_.
+  ListPool<Label> paren_lists_;
+  ListPool<StateId> state_lists_;
   // (Paren, state) to set ID.
   CloseSourceMap close_source_map_;
   mutable Collection<ssize_t, StateId> close_source_sets_;
@@ -448,27 +604,28 @@ template <class Arc>
 PdtBalanceData<Arc> *PdtBalanceData<Arc>::Reverse(
     StateId num_states, StateId num_split, StateId state_id_shift) const {
   auto bd = fst::make_unique_for_overwrite<PdtBalanceData<Arc>>();
-  std::unordered_set<StateId> close_sources;
+  std::vector<StateId> close_sources;
   const auto split_size = num_states / num_split;
   for (StateId i = 0; i < num_states; i += split_size) {
     close_sources.clear();
-    for (auto it = close_source_map_.begin(); it != close_source_map_.end();
-         ++it) {
-      const auto &okey = it->first;
+    close_source_map_.ForEach([&](const State &okey, ssize_t set_id) {
       const auto open_dest = okey.state_id;
       const auto paren_id = okey.paren_id;
-      for (auto set_iter = close_source_sets_.FindSet(it->second);
+      for (auto set_iter = close_source_sets_.FindSet(set_id);
            !set_iter.Done(); set_iter.Next()) {
         const auto close_source = set_iter.Element();
         if ((close_source < i) || (close_source >= i + split_size)) continue;
-        close_sources.insert(close_source + state_id_shift);
+        close_sources.push_back(close_source + state_id_shift);
         bd->OpenInsert(paren_id, close_source + state_id_shift);
         bd->CloseInsert(paren_id, close_source + state_id_shift,
                         open_dest + state_id_shift);
       }
-    }
-    for (auto it = close_sources.begin(); it != close_sources.end(); ++it) {
-      bd->FinishInsert(*it);
+    });
+    std::sort(close_sources.begin(), close_sources.end());
+    close_sources.erase(std::unique(close_sources.begin(), close_sources.end()),
+                        close_sources.end());
+    for (const auto close_source : close_sources) {
+      bd->FinishInsert(close_source);
     }
   }
   return bd.release();
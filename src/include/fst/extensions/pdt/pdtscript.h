@@ -186,10 +186,14 @@ struct PdtShortestPathOptions {
   QueueType queue_type;
   bool keep_parentheses;
   bool path_gc;
+  size_t num_threads;
 
   explicit PdtShortestPathOptions(QueueType qt = FIFO_QUEUE, bool kp = false,
-                                  bool gc = true)
-      : queue_type(qt), keep_parentheses(kp), path_gc(gc) {}
+                                  bool gc = true, size_t num_threads = 1)
+      : queue_type(qt),
+        keep_parentheses(kp),
+        path_gc(gc),
+        num_threads(num_threads) {}
 };
 
 using PdtShortestPathArgs =
@@ -215,22 +219,22 @@ void ShortestPath(PdtShortestPathArgs *args) {
       [[fallthrough]];
     case FIFO_QUEUE: {
       using Queue = FifoQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, opts.num_threads);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
     case LIFO_QUEUE: {
       using Queue = LifoQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, opts.num_threads);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
     case STATE_ORDER_QUEUE: {
       using Queue = StateOrderQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, opts.num_threads);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
@@ -22,9 +22,13 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <stack>
 #include <unordered_map>
 #include <utility>
@@ -38,6 +42,7 @@
 #include <fst/float-weight.h>
 #include <fst/fst.h>
 #include <fst/mutable-fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/queue.h>
 #include <fst/shortest-path.h>
@@ -51,10 +56,14 @@ template <class Arc, class Queue>
 struct PdtShortestPathOptions {
   bool keep_parentheses;
   bool path_gc;
+  size_t num_threads;  // Threads searching sub-graphs (0 for one per
+                       // hardware thread).
 
   explicit PdtShortestPathOptions(bool keep_parentheses = false,
-                                  bool path_gc = true)
-      : keep_parentheses(keep_parentheses), path_gc(path_gc) {}
+                                  bool path_gc = true, size_t num_threads = 1)
+      : keep_parentheses(keep_parentheses),
+        path_gc(path_gc),
+        num_threads(num_threads) {}
 };
 
 namespace internal {
@@ -80,6 +89,11 @@ inline constexpr uint8_t kPdtMarked = 0x04;
 //    a. the Distance() is from the Parent() "start" state to the parenthesis
 //    destination state.
 //    b. The ArcParent() is the parenthesis arc.
+//
+// If concurrent, the data is split into shards by "start" state, each with its
+// own lock, so that different sub-graphs can be searched on different threads.
+// The data of a sub-graph is then only written by the thread searching it and
+// is only read by others once that search is finished.
 template <class Arc>
 class PdtShortestPathData {
  public:
@@ -133,22 +147,38 @@ class PdtShortestPathData {
     uint8_t flags;       // First byte reserved for PdtShortestPathData use.
   };
 
-  explicit PdtShortestPathData(bool gc)
-      : gc_(gc), nstates_(0), ngc_(0), finished_(false) {}
+  explicit PdtShortestPathData(bool gc, bool concurrent = false)
+      : gc_(gc),
+        concurrent_(concurrent),
+        num_shards_(concurrent ? kNumShards : 1),
+        shards_(std::make_unique<Shard[]>(num_shards_)),
+        finished_(false) {}
 
   ~PdtShortestPathData() {
-    VLOG(1) << "opm size: " << paren_map_.size();
-    VLOG(1) << "# of search states: " << nstates_;
-    if (gc_) VLOG(1) << "# of GC'd search states: " << ngc_;
+    size_t paren_map_size = 0;
+    size_t nstates = 0;
+    size_t ngc = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      paren_map_size += shards_[i].paren_map.size();
+      nstates += shards_[i].nstates;
+      ngc += shards_[i].ngc;
+    }
+    VLOG(1) << "opm size: " << paren_map_size;
+    VLOG(1) << "# of search states: " << nstates;
+    if (gc_) VLOG(1) << "# of GC'd search states: " << ngc;
   }
 
   void Clear() {
-    search_map_.clear();
-    search_multimap_.clear();
-    paren_map_.clear();
+    for (size_t i = 0; i < num_shards_; ++i) {
+      auto &shard = shards_[i];
+      shard.search_map.clear();
+      shard.search_multimap.clear();
+      shard.paren_map.clear();
+      shard.nstates = 0;
+      shard.ngc = 0;
+    }
     state_ = SearchState(kNoStateId, kNoStateId);
-    nstates_ = 0;
-    ngc_ = 0;
+    paren_ = ParenSpec();
   }
 
   // TODO(kbg): Currently copying SearchState and passing a const reference to
@@ -228,50 +258,81 @@ class PdtShortestPathData {
   // Hash map from paren spec to open paren data.
   using ParenMap = std::unordered_map<ParenSpec, SearchData, ParenHash>;
 
+  // Data of the sub-graphs whose "start" states map to the shard.
+  struct Shard {
+    SearchMap search_map;            // Maps from search state to data.
+    SearchMultimap search_multimap;  // Maps from "start" to subgraph.
+    ParenMap paren_map;              // Maps paren spec to search data.
+    size_t nstates = 0;              // Number of search states.
+    size_t ngc = 0;                  // Number of GC'd search states.
+    std::mutex mutex;                // Guards the shard if concurrent.
+  };
+
+  static constexpr size_t kNumShards = 64;
+
+  Shard *GetShard(StateId start) const {
+    return &shards_[static_cast<size_t>(start) % num_shards_];
+  }
+
   SearchData *GetSearchData(SearchState s) const {
-    if (s == state_) return state_data_;
-    if (finished_) {
-      auto it = search_map_.find(s);
-      if (it == search_map_.end()) return &null_search_data_;
-      state_ = s;
-      return state_data_ = &(it->second);
-    } else {
-      state_ = s;
-      state_data_ = &search_map_[s];
-      if (!(state_data_->flags & kPdtInited)) {
-        ++nstates_;
-        if (gc_) search_multimap_.insert(std::make_pair(s.start, s.state));
-        state_data_->flags = kPdtInited;
-      }
-      return state_data_;
+    if (concurrent_) {
+      auto *shard = GetShard(s.start);
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      return FindSearchData(shard, s);
     }
+    if (s == state_) return state_data_;
+    auto *data = FindSearchData(&shards_[0], s);
+    if (data == &null_search_data_) return data;
+    state_ = s;
+    return state_data_ = data;
   }
 
   SearchData *GetSearchData(ParenSpec paren) const {
+    if (concurrent_) {
+      auto *shard = GetShard(paren.src_start);
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      return FindSearchData(shard, paren);
+    }
     if (paren == paren_) return paren_data_;
+    auto *data = FindSearchData(&shards_[0], paren);
+    if (data == &null_search_data_) return data;
+    paren_ = paren;
+    return paren_data_ = data;
+  }
+
+  // Finds the data in the shard, adding it unless finished.
+  SearchData *FindSearchData(Shard *shard, SearchState s) const {
     if (finished_) {
-      auto it = paren_map_.find(paren);
-      if (it == paren_map_.end()) return &null_search_data_;
-      paren_ = paren;
-      return state_data_ = &(it->second);
-    } else {
-      paren_ = paren;
-      return paren_data_ = &paren_map_[paren];
+      const auto it = shard->search_map.find(s);
+      return it == shard->search_map.end() ? &null_search_data_ : &it->second;
+    }
+    auto *data = &shard->search_map[s];
+    if (!(data->flags & kPdtInited)) {
+      ++shard->nstates;
+      if (gc_) shard->search_multimap.insert(std::make_pair(s.start, s.state));
+      data->flags = kPdtInited;
+    }
+    return data;
+  }
+
+  SearchData *FindSearchData(Shard *shard, const ParenSpec &paren) const {
+    if (finished_) {
+      const auto it = shard->paren_map.find(paren);
+      return it == shard->paren_map.end() ? &null_search_data_ : &it->second;
     }
+    return &shard->paren_map[paren];
   }
 
-  mutable SearchMap search_map_;            // Maps from search state to data.
-  mutable SearchMultimap search_multimap_;  // Maps from "start" to subgraph.
-  mutable ParenMap paren_map_;              // Maps paren spec to search data.
-  mutable SearchState state_;               // Last state accessed.
-  mutable SearchData *state_data_;          // Last state data accessed.
-  mutable ParenSpec paren_;                 // Last paren spec accessed.
-  mutable SearchData *paren_data_;          // Last paren data accessed.
-  bool gc_;                                 // Allow GC?
-  mutable size_t nstates_;                  // Total number of search states.
-  size_t ngc_;                              // Number of GC'd search states.
-  mutable SearchData null_search_data_;     // Null search data.
-  bool finished_;                           // Read-only access when true.
+  bool gc_;                              // Allow GC?
+  bool concurrent_;                      // Lock shards on access?
+  size_t num_shards_;                    // Number of shards.
+  std::unique_ptr<Shard[]> shards_;      // Data sharded by "start" state.
+  mutable SearchState state_;            // Last state accessed.
+  mutable SearchData *state_data_;       // Last state data accessed.
+  mutable ParenSpec paren_;              // Last paren spec accessed.
+  mutable SearchData *paren_data_;       // Last paren data accessed.
+  mutable SearchData null_search_data_;  // Null search data.
+  bool finished_;                        // Read-only access when true.
 
   PdtShortestPathData(const PdtShortestPathData &) = delete;
   PdtShortestPathData &operator=(const PdtShortestPathData &) = delete;
@@ -283,39 +344,53 @@ class PdtShortestPathData {
 template <class Arc>
 void PdtShortestPathData<Arc>::GC(StateId start) {
   if (!gc_) return;
+  // The sub-graph's search states and the paren specs leaving it are all in
+  // its shard.
+  auto *shard = GetShard(start);
+  std::unique_lock<std::mutex> lock(shard->mutex, std::defer_lock);
+  if (concurrent_) {
+    lock.lock();
+  } else {
+    // The last accessed data may be deleted.
+    state_ = SearchState(kNoStateId, kNoStateId);
+    paren_ = ParenSpec();
+  }
+  auto &search_map = shard->search_map;
+  auto &search_multimap = shard->search_multimap;
+  auto &paren_map = shard->paren_map;
   std::vector<StateId> finals;
-  for (auto it = search_multimap_.find(start);
-       it != search_multimap_.end() && it->first == start; ++it) {
+  for (auto it = search_multimap.find(start);
+       it != search_multimap.end() && it->first == start; ++it) {
     const SearchState s(it->second, start);
-    if (search_map_[s].flags & kPdtFinal) finals.push_back(s.state);
+    if (search_map[s].flags & kPdtFinal) finals.push_back(s.state);
   }
   // Mark phase.
   for (const auto state : finals) {
     SearchState ss(state, start);
     while (ss.state != kNoLabel) {
-      auto &sdata = search_map_[ss];
+      auto &sdata = search_map[ss];
       if (sdata.flags & kPdtMarked) break;
       sdata.flags |= kPdtMarked;
       const auto p = sdata.parent;
       if (p.start != start && p.start != kNoLabel) {  // Entering sub-subgraph.
         const ParenSpec paren(sdata.paren_id, ss.start, p.start);
-        ss = paren_map_[paren].parent;
+        ss = paren_map[paren].parent;
       } else {
         ss = p;
       }
     }
   }
   // Sweep phase.
-  auto it = search_multimap_.find(start);
-  while (it != search_multimap_.end() && it->first == start) {
+  auto it = search_multimap.find(start);
+  while (it != search_multimap.end() && it->first == start) {
     const SearchState s(it->second, start);
-    auto mit = search_map_.find(s);
+    auto mit = search_map.find(s);
     const SearchData &data = mit->second;
     if (!(data.flags & kPdtMarked)) {
-      search_map_.erase(mit);
-      ++ngc_;
+      search_map.erase(mit);
+      ++shard->ngc;
     }
-    search_multimap_.erase(it++);
+    search_multimap.erase(it++);
   }
 }
 
@@ -336,6 +411,15 @@ void PdtShortestPathData<Arc>::GC(StateId start) {
 // straightforward. In general, this will not be the case, so the algorithm
 // (implicitly) creates a new graph where each state is a pair of an original
 // state and a possible parenthesis "start" state for that state.
+//
+// With more than one thread, the sub-graphs of all open parenthesis destination
+// states are also searched ahead by worker threads while the calling thread
+// performs the search above, which then waits for, rather than repeats, a
+// sub-graph search begun by another thread. Since a sub-graph's shortest
+// distances depend only on its "start" state and on the sub-graphs it calls,
+// the result is the same as with one thread. Sub-graphs that the search does
+// not reach may be searched too, and errors found in them are reported only if
+// they are reached.
 template <class Arc, class Queue>
 class PdtShortestPath {
  public:
@@ -355,8 +439,9 @@ class PdtShortestPath {
       : ifst_(ifst.Copy()),
         parens_(parens),
         keep_parens_(opts.keep_parentheses),
+        num_threads_(NumWorkerThreads(opts.num_threads)),
         start_(ifst.Start()),
-        sp_data_(opts.path_gc),
+        sp_data_(opts.path_gc, num_threads_ > 1),
         error_(false) {
     // TODO(kbg): Make this a compile-time static_assert once:
     // 1) All weight properties are made constexpr for all weight types.
@@ -378,13 +463,18 @@ class PdtShortestPath {
 
   ~PdtShortestPath() {
     VLOG(1) << "# of input states: " << CountStates(*ifst_);
-    VLOG(1) << "# of enqueued: " << nenqueued_;
+    VLOG(1) << "# of enqueued: " << nenqueued_.load();
     VLOG(1) << "cpmm size: " << close_paren_multimap_.size();
   }
 
   void ShortestPath(MutableFst<Arc> *ofst) {
     Init(ofst);
-    GetDistance(start_);
+    if (num_threads_ > 1) {
+      ParallelDistance();
+    } else {
+      SearchContext context{ifst_.get(), 0};
+      GetDistance(start_, &context);
+    }
     GetPath();
     sp_data_.Finish();
     if (error_) ofst->SetProperties(kError, kError);
@@ -407,25 +497,56 @@ class PdtShortestPath {
   }
 
  private:
+  // The thread searching sub-graphs.
+  struct SearchContext {
+    const Fst<Arc> *fst;  // Input FST, a thread-safe copy on worker threads.
+    ssize_t thread;       // Thread index; the calling thread is 0.
+  };
+
+  // Search status of a sub-graph in the parallel search.
+  struct Subgraph {
+    ssize_t owner = -1;     // Thread searching the sub-graph, if any.
+    bool finished = false;  // Search finished?
+    bool error = false;     // Error found searching it or its callees?
+  };
+
+  enum class SubgraphStatus { kFinished, kError, kBusy, kCanceled };
+
   void Init(MutableFst<Arc> *ofst);
 
-  void GetDistance(StateId start);
+  // Searches the sub-graphs on num_threads_ threads.
+  void ParallelDistance();
+
+  // Searches the sub-graph starting at start unless it is already searched.
+  // If it is being searched by another thread and wait is true, waits for that
+  // search to finish, unless that would wait for this thread; this means that
+  // the sub-graph calls itself, and kError is returned.
+  SubgraphStatus GetSubgraph(StateId start, SearchContext *context, bool wait);
+
+  // Returns false if the search is canceled.
+  bool GetDistance(StateId start, SearchContext *context);
 
-  void ProcFinal(SearchState s);
+  // Notes that the sub-graph starting at start calls itself in the parallel
+  // search; this is reported once it is reached from the start state.
+  void SetRecursionError(StateId start);
 
-  void ProcArcs(SearchState s);
+  void ProcFinal(SearchState s, SearchContext *context);
+
+  void ProcArcs(SearchState s, Queue *queue, SearchContext *context);
 
   void ProcOpenParen(Label paren_id, SearchState s, StateId nexstate,
-                     const Weight &weight);
+                     const Weight &weight, Queue *queue,
+                     SearchContext *context);
 
   void ProcCloseParen(Label paren_id, SearchState s, const Weight &weight);
 
-  void ProcNonParen(SearchState s, StateId nextstate, const Weight &weight);
+  void ProcNonParen(SearchState s, StateId nextstate, const Weight &weight,
+                    Queue *queue);
 
   void Relax(SearchState s, SearchState t, StateId nextstate,
-             const Weight &weight, Label paren_id);
+             const Weight &weight, Label paren_id, Queue *queue);
 
-  void Enqueue(SearchState d);
+  void Enqueue(SearchState d, Queue *queue);
 
   void GetPath();
 
@@ -435,7 +556,7 @@ class PdtShortestPath {
   MutableFst<Arc> *ofst_;
   const std::vector<std::pair<Label, Label>> &parens_;
   bool keep_parens_;
-  Queue *state_queue_;
+  size_t num_threads_;
   StateId start_;
   Weight fdistance_;
   SearchState f_parent_;
@@ -443,8 +564,16 @@ class PdtShortestPath {
   std::unordered_map<Label, Label> paren_map_;
   CloseParenMultimap close_paren_multimap_;
   internal::PdtBalanceData<Arc> balance_data_;
-  ssize_t nenqueued_;
+  std::atomic<ssize_t> nenqueued_;
   bool error_;
+  // Parallel search.
+  std::vector<StateId> open_dests_;  // Open paren destinations, sorted.
+  std::unordered_map<StateId, Subgraph> subgraphs_;
+  std::vector<StateId> waiting_for_;  // Sub-graph each thread waits for.
+  std::atomic<bool> canceled_;        // Calling thread finished?
+  std::mutex subgraph_mutex_;         // Guards subgraphs_ and waiting_for_.
+  std::condition_variable subgraph_finished_;
+  std::mutex balance_mutex_;  // Guards balance_data_ if parallel.
 
   static constexpr uint8_t kEnqueued = 0x10;
   static constexpr uint8_t kExpanded = 0x20;
@@ -466,6 +595,7 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
   close_paren_multimap_.clear();
   balance_data_.Clear();
   nenqueued_ = 0;
+  open_dests_.clear();
   // Finds open parens per destination state and close parens per source state.
   for (StateIterator<Fst<Arc>> siter(*ifst_); !siter.Done(); siter.Next()) {
     const auto s = siter.Value();
@@ -476,6 +606,7 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
         const auto paren_id = it->second;
         if (arc.ilabel == parens_[paren_id].first) {  // Open paren.
           balance_data_.OpenInsert(paren_id, arc.nextstate);
+          if (num_threads_ > 1) open_dests_.push_back(arc.nextstate);
         } else {  // Close paren.
           const internal::ParenState<Arc> paren_state(paren_id, s);
           close_paren_multimap_.emplace(paren_state, arc);
@@ -483,37 +614,126 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
       }
     }
   }
+  std::sort(open_dests_.begin(), open_dests_.end());
+  open_dests_.erase(std::unique(open_dests_.begin(), open_dests_.end()),
+                    open_dests_.end());
+}
+
+template <class Arc, class Queue>
+void PdtShortestPath<Arc, Queue>::ParallelDistance() {
+  if (start_ == kNoStateId) return;
+  subgraphs_.clear();
+  subgraphs_[start_].owner = 0;
+  waiting_for_.assign(num_threads_, kNoStateId);
+  canceled_ = false;
+  std::atomic<size_t> next(0);
+  ParallelFor(num_threads_, num_threads_,
+              [this, &next](size_t thread, size_t, size_t) {
+                if (thread == 0) {
+                  SearchContext context{ifst_.get(), 0};
+                  GetDistance(start_, &context);
+                  // Stops the searches that are no longer needed.
+                  std::lock_guard<std::mutex> lock(subgraph_mutex_);
+                  canceled_ = true;
+                  subgraph_finished_.notify_all();
+                  return;
+                }
+                std::unique_ptr<const Fst<Arc>> fst(ifst_->Copy(true));
+                SearchContext context{fst.get(), static_cast<ssize_t>(thread)};
+                for (auto i = next++; i < open_dests_.size() && !canceled_;
+                     i = next++) {
+                  GetSubgraph(open_dests_[i], &context, /*wait=*/false);
+                }
+              });
+}
+
+template <class Arc, class Queue>
+typename PdtShortestPath<Arc, Queue>::SubgraphStatus
+PdtShortestPath<Arc, Queue>::GetSubgraph(StateId start,
+                                         SearchContext *context, bool wait) {
+  std::unique_lock<std::mutex> lock(subgraph_mutex_);
+  auto &subgraph = subgraphs_[start];
+  while (true) {
+    if (subgraph.finished) {
+      return subgraph.error ? SubgraphStatus::kError
+                            : SubgraphStatus::kFinished;
+    }
+    if (canceled_) return SubgraphStatus::kCanceled;
+    if (subgraph.owner == -1) {
+      subgraph.owner = context->thread;
+      lock.unlock();
+      const bool finished = GetDistance(start, context);
+      lock.lock();
+      if (!finished) return SubgraphStatus::kCanceled;
+      subgraph.finished = true;
+      subgraph_finished_.notify_all();
+      continue;
+    }
+    if (!wait) return SubgraphStatus::kBusy;
+    // Follows the threads waiting for each other from the owner.
+    for (auto thread = subgraph.owner;;) {
+      if (thread == context->thread) return SubgraphStatus::kError;
+      const auto waiting_for = waiting_for_[thread];
+      // A thread may not have woken up yet from a finished wait.
+      if (waiting_for == kNoStateId || subgraphs_[waiting_for].finished) break;
+      thread = subgraphs_[waiting_for].owner;
+    }
+    waiting_for_[context->thread] = start;
+    subgraph_finished_.wait(lock);
+    waiting_for_[context->thread] = kNoStateId;
+  }
 }
 
 // Computes the shortest distance stored in a recursive way. Each sub-graph
 // (i.e., different paren "start" state) begins with weight One().
 template <class Arc, class Queue>
-void PdtShortestPath<Arc, Queue>::GetDistance(StateId start) {
-  if (start == kNoStateId) return;
+bool PdtShortestPath<Arc, Queue>::GetDistance(StateId start,
+                                              SearchContext *context) {
+  if (start == kNoStateId) return true;
   Queue state_queue;
-  state_queue_ = &state_queue;
   const SearchState q(start, start);
-  Enqueue(q);
+  Enqueue(q, &state_queue);
   sp_data_.SetDistance(q, Weight::One());
-  while (!state_queue_->Empty()) {
-    const auto state = state_queue_->Head();
-    state_queue_->Dequeue();
+  while (!state_queue.Empty()) {
+    if (num_threads_ > 1 && canceled_) return false;
+    const auto state = state_queue.Head();
+    state_queue.Dequeue();
     const SearchState s(state, start);
     sp_data_.SetFlags(s, 0, kEnqueued);
-    ProcFinal(s);
-    ProcArcs(s);
+    ProcFinal(s, context);
+    ProcArcs(s, &state_queue, context);
     sp_data_.SetFlags(s, kExpanded, kExpanded);
   }
   sp_data_.SetFlags(q, kFinished, kFinished);
-  balance_data_.FinishInsert(start);
+  {
+    std::unique_lock<std::mutex> lock(balance_mutex_, std::defer_lock);
+    if (num_threads_ > 1) lock.lock();
+    balance_data_.FinishInsert(start);
+  }
   sp_data_.GC(start);
+  return true;
+}
+
+template <class Arc, class Queue>
+void PdtShortestPath<Arc, Queue>::SetRecursionError(StateId start) {
+  // Only the calling thread searches from the start state.
+  if (start == start_) {
+    FSTERROR()
+        << "PdtShortestPath: open parenthesis recursion: not bounded stack";
+    error_ = true;
+  } else {
+    std::lock_guard<std::mutex> lock(subgraph_mutex_);
+    subgraphs_[start].error = true;
+  }
 }
 
 // Updates best complete path.
 template <class Arc, class Queue>
-void PdtShortestPath<Arc, Queue>::ProcFinal(SearchState s) {
-  if (ifst_->Final(s.state) != Weight::Zero() && s.start == start_) {
-    const auto weight = Times(sp_data_.Distance(s), ifst_->Final(s.state));
+void PdtShortestPath<Arc, Queue>::ProcFinal(SearchState s,
+                                            SearchContext *context) {
+  if (s.start == start_ && context->fst->Final(s.state) != Weight::Zero()) {
+    const auto weight =
+        Times(sp_data_.Distance(s), context->fst->Final(s.state));
     if (fdistance_ != Plus(fdistance_, weight)) {
       if (f_parent_.state != kNoStateId) {
         sp_data_.SetFlags(f_parent_, 0, internal::kPdtFinal);
@@ -527,8 +747,9 @@ void PdtShortestPath<Arc, Queue>::ProcFinal(SearchState s) {
 
 // Processes all arcs leaving the state s.
 template <class Arc, class Queue>
-void PdtShortestPath<Arc, Queue>::ProcArcs(SearchState s) {
-  for (ArcIterator<Fst<Arc>> aiter(*ifst_, s.state); !aiter.Done();
+void PdtShortestPath<Arc, Queue>::ProcArcs(SearchState s, Queue *queue,
+                                           SearchContext *context) {
+  for (ArcIterator<Fst<Arc>> aiter(*context->fst, s.state); !aiter.Done();
        aiter.Next()) {
     const auto &arc = aiter.Value();
     const auto weight = Times(sp_data_.Distance(s), arc.weight);
@@ -536,12 +757,12 @@ void PdtShortestPath<Arc, Queue>::ProcArcs(SearchState s) {
     if (it != paren_map_.end()) {  // Is a paren?
       const auto paren_id = it->second;
       if (arc.ilabel == parens_[paren_id].first) {
-        ProcOpenParen(paren_id, s, arc.nextstate, weight);
+        ProcOpenParen(paren_id, s, arc.nextstate, weight, queue, context);
       } else {
         ProcCloseParen(paren_id, s, weight);
       }
     } else {
-      ProcNonParen(s, arc.nextstate, weight);
+      ProcNonParen(s, arc.nextstate, weight, queue);
     }
   }
 }
@@ -551,29 +772,48 @@ void PdtShortestPath<Arc, Queue>::ProcArcs(SearchState s) {
 // Otherwise it finds any previously encountered closing parentheses and relaxes
 // them using the recursively stored shortest distance to them.
 template <class Arc, class Queue>
-inline void PdtShortestPath<Arc, Queue>::ProcOpenParen(Label paren_id,
-                                                       SearchState s,
-                                                       StateId nextstate,
-                                                       const Weight &weight) {
+inline void PdtShortestPath<Arc, Queue>::ProcOpenParen(
+    Label paren_id, SearchState s, StateId nextstate, const Weight &weight,
+    Queue *queue, SearchContext *context) {
   const SearchState d(nextstate, nextstate);
   const ParenSpec paren(paren_id, s.start, d.start);
   const auto pdist = sp_data_.Distance(paren);
   if (pdist != Plus(pdist, weight)) {
     sp_data_.SetDistance(paren, weight);
     sp_data_.SetParent(paren, s);
-    const auto dist = sp_data_.Distance(d);
-    if (dist == Weight::Zero()) {
-      auto *state_queue = state_queue_;
-      GetDistance(d.start);
-      state_queue_ = state_queue;
-    } else if (!(sp_data_.Flags(d) & kFinished)) {
-      FSTERROR()
-          << "PdtShortestPath: open parenthesis recursion: not bounded stack";
-      error_ = true;
+    std::vector<StateId> close_sources;
+    if (num_threads_ > 1) {
+      switch (GetSubgraph(d.start, context, /*wait=*/true)) {
+        case SubgraphStatus::kCanceled:
+          return;
+        case SubgraphStatus::kError:
+          SetRecursionError(s.start);
+          break;
+        default:
+          break;
+      }
+      // Copies the close paren sources, which other threads may add to.
+      std::lock_guard<std::mutex> lock(balance_mutex_);
+      for (auto set_iter = balance_data_.Find(paren_id, nextstate);
+           !set_iter.Done(); set_iter.Next()) {
+        close_sources.push_back(set_iter.Element());
+      }
+    } else {
+      const auto dist = sp_data_.Distance(d);
+      if (dist == Weight::Zero()) {
+        GetDistance(d.start, context);
+      } else if (!(sp_data_.Flags(d) & kFinished)) {
+        FSTERROR()
+            << "PdtShortestPath: open parenthesis recursion: not bounded stack";
+        error_ = true;
+      }
+      for (auto set_iter = balance_data_.Find(paren_id, nextstate);
+           !set_iter.Done(); set_iter.Next()) {
+        close_sources.push_back(set_iter.Element());
+      }
     }
-    for (auto set_iter = balance_data_.Find(paren_id, nextstate);
-         !set_iter.Done(); set_iter.Next()) {
-      const SearchState cpstate(set_iter.Element(), d.start);
+    for (const auto close_source : close_sources) {
+      const SearchState cpstate(close_source, d.start);
       const internal::ParenState<Arc> paren_state(paren_id, cpstate.state);
       for (auto cpit = close_paren_multimap_.find(paren_state);
            cpit != close_paren_multimap_.end() && paren_state == cpit->first;
@@ -581,7 +821,7 @@ inline void PdtShortestPath<Arc, Queue>::ProcOpenParen(Label paren_id,
         const auto &cparc = cpit->second;
         const auto cpw =
             Times(weight, Times(sp_data_.Distance(cpstate), cparc.weight));
-        Relax(cpstate, s, cparc.nextstate, cpw, paren_id);
+        Relax(cpstate, s, cparc.nextstate, cpw, paren_id, queue);
       }
     }
   }
@@ -596,7 +836,11 @@ inline void PdtShortestPath<Arc, Queue>::ProcCloseParen(Label paren_id,
                                                         const Weight &weight) {
   const internal::ParenState<Arc> paren_state(paren_id, s.start);
   if (!(sp_data_.Flags(s) & kExpanded)) {
-    balance_data_.CloseInsert(paren_id, s.start, s.state);
+    {
+      std::unique_lock<std::mutex> lock(balance_mutex_, std::defer_lock);
+      if (num_threads_ > 1) lock.lock();
+      balance_data_.CloseInsert(paren_id, s.start, s.state);
+    }
     sp_data_.SetFlags(s, internal::kPdtFinal, internal::kPdtFinal);
   }
 }
@@ -605,8 +849,9 @@ inline void PdtShortestPath<Arc, Queue>::ProcCloseParen(Label paren_id,
 template <class Arc, class Queue>
 inline void PdtShortestPath<Arc, Queue>::ProcNonParen(SearchState s,
                                                       StateId nextstate,
-                                                      const Weight &weight) {
-  Relax(s, s, nextstate, weight, kNoLabel);
+                                                      const Weight &weight,
+                                                      Queue *queue) {
+  Relax(s, s, nextstate, weight, kNoLabel, queue);
 }
 
 // Classical relaxation on the search graph for an arc with destination state
@@ -616,25 +861,26 @@ template <class Arc, class Queue>
 inline void PdtShortestPath<Arc, Queue>::Relax(SearchState s, SearchState t,
                                                StateId nextstate,
                                                const Weight &weight,
-                                               Label paren_id) {
+                                               Label paren_id, Queue *queue) {
   const SearchState d(nextstate, t.start);
   Weight dist = sp_data_.Distance(d);
   if (dist != Plus(dist, weight)) {
     sp_data_.SetParent(d, s);
     sp_data_.SetParenId(d, paren_id);
     sp_data_.SetDistance(d, Plus(dist, weight));
-    Enqueue(d);
+    Enqueue(d, queue);
   }
 }
 
 template <class Arc, class Queue>
-inline void PdtShortestPath<Arc, Queue>::Enqueue(SearchState s) {
+inline void PdtShortestPath<Arc, Queue>::Enqueue(SearchState s,
+                                                 Queue *queue) {
   if (!(sp_data_.Flags(s) & kEnqueued)) {
-    state_queue_->Enqueue(s.state);
+    queue->Enqueue(s.state);
     sp_data_.SetFlags(s, kEnqueued, kEnqueued);
-    ++nenqueued_;
+    nenqueued_.fetch_add(1, std::memory_order_relaxed);
   } else {
-    state_queue_->Update(s.state);
+    queue->Update(s.state);
   }
 }
 
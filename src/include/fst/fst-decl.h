@@ -99,6 +99,9 @@ using CompactArcFst =
 template <class Arc, class U = uint32_t>
 class ConstFst;
 
+template <class Arc, class U = uint32_t>
+class ConstFstBuilder;
+
 template <class Arc, class Weight, class Matcher>
 class EditFst;
 
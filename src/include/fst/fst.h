@@ -80,6 +80,17 @@ struct FstReadOptions {
   FileReadMode mode;            // Read or map files (advisory, if possible)
   bool read_isymbols;           // Read isymbols, if any (default: true).
   bool read_osymbols;           // Read osymbols, if any (default: true).
+  bool populate;                // Pre-fault mapped data (default: false).
+  bool huge_pages;              // Use transparent huge pages for data read or
+                                // mapped, if possible (default: false).
+  size_t chunk_states;          // If non-zero and the file is mapped, keeps
+                                // chunks of this many states resident on
+                                // demand; see MappedChunkCache (default: 0).
+  size_t max_resident_chunks;   // Maximum number of resident chunks
+                                // (default: 64).
+  bool chunk_stats;             // Counts the states accessed out-of-core, at
+                                // the cost of an atomic increment per access
+                                // (default: false).
 
   explicit FstReadOptions(
       const std::string_view source = "<unspecified>",
@@ -84,6 +84,7 @@
 #include <fst/matcher.h>
 #include <fst/minimize.h>
 #include <fst/mutable-fst.h>
+#include <fst/nary-compose.h>
 #include <fst/pair-weight.h>
 #include <fst/partition.h>
 #include <fst/power-weight.h>
@@ -113,6 +114,7 @@
 #include <fst/state-reachable.h>
 #include <fst/state-table.h>
 #include <fst/statesort.h>
+#include <fst/string-set.h>
 #include <fst/string-weight.h>
 #include <fst/string.h>
 #include <fst/symbol-table-ops.h>
@@ -22,6 +22,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <type_traits>
 
 #include <fst/arc-map.h>
 #include <fst/arc.h>
@@ -58,8 +59,16 @@ struct InvertMapper {
   }
 
   uint64_t Properties(uint64_t props) const { return InvertProperties(props); }
+
+  // The sides of an inverted arc carry the labels of the opposite sides.
+  constexpr MatchType LabelSource(MatchType side) const {
+    return side == MATCH_INPUT ? MATCH_OUTPUT : MATCH_INPUT;
+  }
 };
 
+template <class A>
+struct IsThreadSafeMapper<InvertMapper<A>> : std::true_type {};
+
 // Inverts the transduction corresponding to an FST by exchanging the
 // FST's input and output labels.
 //
@@ -149,9 +158,69 @@ class ArcIterator<InvertFst<Arc>>
       : ArcIterator<ArcMapFst<Arc, Arc, InvertMapper<Arc>>>(fst, s) {}
 };
 
-// Useful alias when using StdArc.
+// Inverts the transduction corresponding to an FST by exchanging the
+// FST's input and output labels. Unlike InvertFst, this version does no
+// caching: arcs are inverted as they are visited and matching is passed
+// through to the input FST's matcher on the opposite side.
+//
+// Complexity:
+//
+//   Time: O(v + e)
+//   Space: O(1)
+//
+// where v is the number of states visited and e is the number of arcs visited.
+template <class A>
+class InvertViewFst : public ArcMapViewFst<A, A, InvertMapper<A>> {
+ public:
+  using Arc = A;
+
+  using Mapper = InvertMapper<Arc>;
+  using Impl = internal::ArcMapViewFstImpl<A, A, InvertMapper<A>>;
+
+  explicit InvertViewFst(const Fst<Arc> &fst)
+      : ArcMapViewFst<Arc, Arc, Mapper>(fst) {
+    GetMutableImpl()->SetOutputSymbols(fst.InputSymbols());
+    GetMutableImpl()->SetInputSymbols(fst.OutputSymbols());
+  }
+
+  // See Fst<>::Copy() for doc.
+  InvertViewFst(const InvertViewFst &fst, bool safe = false)
+      : ArcMapViewFst<Arc, Arc, Mapper>(fst, safe) {}
+
+  // Gets a copy of this InvertViewFst. See Fst<>::Copy() for further doc.
+  InvertViewFst *Copy(bool safe = false) const override {
+    return new InvertViewFst(*this, safe);
+  }
+
+ private:
+  using ImplToFst<Impl>::GetMutableImpl;
+};
+
+// Specialization for InvertViewFst.
+template <class Arc>
+class StateIterator<InvertViewFst<Arc>>
+    : public StateIterator<ArcMapViewFst<Arc, Arc, InvertMapper<Arc>>> {
+ public:
+  explicit StateIterator(const InvertViewFst<Arc> &fst)
+      : StateIterator<ArcMapViewFst<Arc, Arc, InvertMapper<Arc>>>(fst) {}
+};
+
+// Specialization for InvertViewFst.
+template <class Arc>
+class ArcIterator<InvertViewFst<Arc>>
+    : public ArcIterator<ArcMapViewFst<Arc, Arc, InvertMapper<Arc>>> {
+ public:
+  using StateId = typename Arc::StateId;
+
+  ArcIterator(const InvertViewFst<Arc> &fst, StateId s)
+      : ArcIterator<ArcMapViewFst<Arc, Arc, InvertMapper<Arc>>>(fst, s) {}
+};
+
+// Useful aliases when using StdArc.
 using StdInvertFst = InvertFst<StdArc>;
 
+using StdInvertViewFst = InvertViewFst<StdArc>;
+
 }  // namespace fst
 
 #endif  // FST_INVERT_H_
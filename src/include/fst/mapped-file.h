@@ -23,9 +23,15 @@
 #include <windows.h>
 #endif
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <istream>
+#include <list>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <fst/flags.h>
 
@@ -50,33 +56,56 @@ struct MemoryRegion {
 
 class MappedFile {
  public:
+  // Expected access to a range of a memory-mapped file; see Advise().
+  enum Advice { NORMAL, RANDOM, SEQUENTIAL, WILLNEED, DONTNEED };
+
   ~MappedFile();
 
   void *mutable_data() const { return region_.data; }
 
   const void *data() const { return region_.data; }
 
+  // Returns true if the data is memory-mapped from a file.
+  bool IsMapped() const {
+    return region_.mmap != nullptr && region_.size != 0;
+  }
+
+  // Passes the advice to the kernel for size bytes from pos in the data. The
+  // range is extended to whole pages, except that DONTNEED only applies to
+  // the pages lying entirely inside it. Returns false if the data is not
+  // mapped or the advice fails.
+  bool Advise(size_t pos, size_t size, Advice advice) const;
+
   // Returns a MappedFile object that contains the contents of the input stream
   // strm starting from the current file position with size bytes. The memorymap
   // bool is advisory, and Map will default to allocating and reading. The
   // source argument needs to contain the filename that was used to open the
-  // input stream.
+  // input stream. If populate is true, mapped pages are faulted in by the
+  // mapping call itself. If huge_pages is true, transparent huge pages are
+  // requested for the data where the platform supports them; for file
+  // mappings this depends on the kernel's support for file-backed huge pages.
   static MappedFile * Map(std::istream &istrm, bool memorymap,
                                           const std::string &source,
-                                          size_t size);
+                                          size_t size, bool populate = false,
+                                          bool huge_pages = false);
 
   // Returns a MappedFile object that contains the contents of the file referred
   // to by the file descriptor starting from pos with size bytes. If the
   // memory mapping fails, nullptr is returned. In contrast to Map(), this
   // factory function does not backoff to allocating and reading.
-  static MappedFile * MapFromFileDescriptor(int fd, size_t pos,
-                                                            size_t size);
+  static MappedFile * MapFromFileDescriptor(
+      int fd, size_t pos, size_t size, bool populate = false,
+      bool huge_pages = false);
 
   // Creates a MappedFile object with a new'ed block of memory of size. The
-  // align argument can be used to specify a desired block alignment.
+  // align argument can be used to specify a desired block alignment. If
+  // huge_pages is true and the block spans at least one huge page, it is
+  // aligned to kHugePageSize and backed by transparent huge pages where the
+  // platform supports them.
   // This is RECOMMENDED FOR INTERNAL USE ONLY as it may change in future
   // releases.
-  static MappedFile *Allocate(size_t size, size_t align = kArchAlignment);
+  static MappedFile *Allocate(size_t size, size_t align = kArchAlignment,
+                              bool huge_pages = false);
 
   // Creates a MappedFile object with a new'ed block of memory with enough
   // space for count elements of type T, correctly aligned for the type.
@@ -101,6 +130,9 @@ class MappedFile {
 
   static constexpr size_t kMaxReadChunk = 256 * 1024 * 1024;  // 256 MB.
 
+  // Size of a transparent huge page on common platforms.
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;  // 2 MB.
+
  private:
   explicit MappedFile(const MemoryRegion &region);
 
@@ -108,6 +140,75 @@ class MappedFile {
   MappedFile(const MappedFile &) = delete;
   MappedFile &operator=(const MappedFile &) = delete;
 };
+
+// Keeps at most a fixed number of chunks of consecutive states of a
+// memory-mapped FST resident, for FSTs larger than the memory available.
+// Touch() is called with each state accessed. When a state lies in a chunk
+// that is not resident, the chunk is loaded with WILLNEED advice and the least
+// recently used chunk beyond the limit is released with DONTNEED advice. When
+// chunks are faulted in order, the next chunk is also loaded ahead. The advise
+// callback applies the advice to the bytes of the given chunk in each of the
+// FST's mapped regions. Touch() is thread-safe. Accesses are only counted, on
+// an atomic shared by all threads, if count_accesses is true.
+class MappedChunkCache {
+ public:
+  using AdviseFn = std::function<void(size_t chunk, MappedFile::Advice)>;
+
+  struct Stats {
+    uint64_t accesses = 0;    // Number of states touched, if counted.
+    uint64_t faults = 0;      // Accesses to chunks that were not resident.
+    uint64_t prefetches = 0;  // Chunks loaded ahead of sequential faults.
+    uint64_t evictions = 0;   // Chunks released to stay within the limit.
+
+    double FaultRate() const {
+      return accesses == 0 ? 0.0 : static_cast<double>(faults) / accesses;
+    }
+  };
+
+  MappedChunkCache(size_t num_states, size_t chunk_states, size_t max_chunks,
+                   bool count_accesses, AdviseFn advise);
+
+  void Touch(int64_t s) {
+    const size_t chunk = s / chunk_states_;
+    if (count_accesses_) accesses_.fetch_add(1, std::memory_order_relaxed);
+    if (chunk != mru_chunk_.load(std::memory_order_acquire)) Fault(chunk);
+  }
+
+  size_t ChunkStates() const { return chunk_states_; }
+
+  size_t NumChunks() const { return resident_.size(); }
+
+  size_t MaxChunks() const { return max_chunks_; }
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr size_t kNoChunk = -1;
+
+  // Makes the chunk resident and most recently used.
+  void Fault(size_t chunk);
+
+  // Loads a chunk that is not resident, releasing chunks beyond the limit.
+  void Load(size_t chunk);
+
+  const size_t chunk_states_;
+  const size_t max_chunks_;
+  const bool count_accesses_;
+  const AdviseFn advise_;
+  mutable std::mutex mutex_;
+  std::list<size_t> lru_;  // Resident chunks, most recently used first.
+  std::vector<std::list<size_t>::iterator> position_;  // Indexed by chunk.
+  std::vector<bool> resident_;                         // Indexed by chunk.
+  size_t last_fault_ = kNoChunk;
+  std::atomic<size_t> mru_chunk_{kNoChunk};
+  std::atomic<uint64_t> accesses_{0};
+  uint64_t faults_ = 0;
+  uint64_t prefetches_ = 0;
+  uint64_t evictions_ = 0;
+
+  MappedChunkCache(const MappedChunkCache &) = delete;
+  MappedChunkCache &operator=(const MappedChunkCache &) = delete;
+};
 }  // namespace fst
 
 #endif  // FST_MAPPED_FILE_H_
@@ -20,6 +20,7 @@
 #ifndef FST_MEMORY_H_
 #define FST_MEMORY_H_
 
+#include <algorithm>
 #include <cstddef>
 #include <list>
 #include <memory>
@@ -168,6 +169,73 @@ class MemoryPool : public internal::MemoryPoolImpl<sizeof(T)> {
       : internal::MemoryPoolImpl<sizeof(T)>(pool_size) {}
 };
 
+// Allocates uninitialized memory chunks of any size for data that is released
+// all at once. Reset() makes all of the memory available again in constant
+// time and keeps the blocks for reuse, e.g., by the delayed FSTs built for each
+// utterance in a decoding loop. Chunks are never freed individually. Result of
+// Allocate() will be aligned to the requested alignment, which may not exceed
+// alignof(std::max_align_t). Not thread-safe.
+class ResettableArena {
+ public:
+  // 'block_size' specifies the default block size in bytes.
+  explicit ResettableArena(size_t block_size = kAllocSize * 1024)
+      : block_size_(block_size) {
+    blocks_.push_back(MakeBlock(block_size_));
+  }
+
+  void *Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    DCHECK_LE(align, alignof(std::max_align_t));
+    auto pos = (block_pos_ + align - 1) & ~(align - 1);
+    if (pos + size > blocks_[block_].size) {
+      NextBlock(size);
+      pos = 0;
+    }
+    block_pos_ = pos + size;
+    return &blocks_[block_].data[pos];
+  }
+
+  // Makes all memory available for reuse; previous allocations are invalid.
+  void Reset() {
+    block_ = 0;
+    block_pos_ = 0;
+  }
+
+  // Number of bytes in allocated blocks.
+  size_t Size() const {
+    size_t size = 0;
+    for (const auto &block : blocks_) size += block.size;
+    return size;
+  }
+
+  size_t NumBlocks() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+
+  static Block MakeBlock(size_t size) {
+    return {fst::make_unique_for_overwrite<std::byte[]>(size), size};
+  }
+
+  // Moves to the next retained block if it fits the size, o.w. inserts a new
+  // block after the current one.
+  void NextBlock(size_t size) {
+    ++block_;
+    if (block_ == blocks_.size() || blocks_[block_].size < size) {
+      blocks_.insert(blocks_.begin() + block_,
+                     MakeBlock(std::max(size, block_size_)));
+    }
+    block_pos_ = 0;
+  }
+
+  const size_t block_size_;   // Default block size in bytes.
+  std::vector<Block> blocks_;  // Blocks in allocation order.
+  size_t block_ = 0;           // Current block.
+  size_t block_pos_ = 0;       // Current position in block in bytes.
+};
+
 // Stores a collection of memory arenas.
 class MemoryArenaCollection {
  public:
@@ -278,6 +346,9 @@ bool operator!=(const BlockAllocator<T> &alloc1,
 // or swapping operations between objects created with different allocators nor
 // should it be used if copies must be thread-safe. The result of allocate()
 // will be suitably memory-aligned.
+//
+// When constructed with a ResettableArena, all memory is instead allocated
+// from the arena and is released only when the caller resets the arena.
 template <typename T>
 class PoolAllocator {
  public:
@@ -288,12 +359,17 @@ class PoolAllocator {
   explicit PoolAllocator(size_t pool_size = kAllocSize)
       : pools_(std::make_shared<MemoryPoolCollection>(pool_size)) {}
 
+  // The arena is not owned and must outlive all allocations.
+  explicit PoolAllocator(ResettableArena *arena) : arena_(arena) {}
+
   template <typename U>
   explicit PoolAllocator(const PoolAllocator<U> &pool_alloc)
-      : pools_(pool_alloc.Pools()) {}
+      : pools_(pool_alloc.Pools()), arena_(pool_alloc.Arena()) {}
 
   T *allocate(size_type n, const void *hint = nullptr) {
-    if (n == 1) {
+    if (arena_) {
+      return static_cast<T *>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    } else if (n == 1) {
       return static_cast<T *>(Pool<1>()->Allocate());
     } else if (n == 2) {
       return static_cast<T *>(Pool<2>()->Allocate());
@@ -314,7 +390,9 @@ class PoolAllocator {
   }
 
   void deallocate(T *p, size_type n) {
-    if (n == 1) {
+    if (arena_) {
+      return;
+    } else if (n == 1) {
       Pool<1>()->Free(p);
     } else if (n == 2) {
       Pool<2>()->Free(p);
@@ -335,6 +413,8 @@ class PoolAllocator {
 
   std::shared_ptr<MemoryPoolCollection> Pools() const { return pools_; }
 
+  ResettableArena *Arena() const { return arena_; }
+
  private:
   template <int n>
   struct TN {
@@ -347,6 +427,7 @@ class PoolAllocator {
   }
 
   std::shared_ptr<MemoryPoolCollection> pools_;
+  ResettableArena *arena_ = nullptr;
 };
 
 template <typename T, typename U>
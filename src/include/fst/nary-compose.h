@@ -0,0 +1,528 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Class to compute the composition of a sequence of FSTs in a single pass.
+
+#ifndef FST_NARY_COMPOSE_H_
+#define FST_NARY_COMPOSE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fst/log.h>
+#include <fst/cache.h>
+#include <fst/compose.h>
+#include <fst/connect.h>
+#include <fst/fst.h>
+#include <fst/impl-to-fst.h>
+#include <fst/matcher.h>
+#include <fst/mutable-fst.h>
+#include <fst/properties.h>
+#include <fst/symbol-table.h>
+#include <fst/util.h>
+#include <fst/weight.h>
+
+namespace fst {
+
+// Delayed N-ary composition options templated on the arc type and the matcher
+// type. By default, the matchers are constructed by composition. If set
+// below, the user can instead pass in the matchers of the second through last
+// FSTs, which must match on input labels; in that case, NaryComposeFst takes
+// their ownership.
+template <class Arc, class M = Matcher<Fst<Arc>>>
+struct NaryComposeFstOptions : public CacheOptions {
+  std::vector<M *> matchers;  // Matchers for FSTs 2..N (or empty).
+
+  explicit NaryComposeFstOptions(const CacheOptions &opts = CacheOptions(),
+                                 std::vector<M *> matchers = {})
+      : CacheOptions(opts), matchers(std::move(matchers)) {}
+};
+
+template <class A, class CacheStore = DefaultCacheStore<A>>
+class NaryComposeFst;
+
+namespace internal {
+
+// State table for N-ary composition, mapping tuples of component states and
+// filter state to state IDs. A tuple is stored as the component states
+// followed by the filter state, and the tuples are stored contiguously.
+template <class Arc>
+class NaryComposeStateTable {
+ public:
+  using StateId = typename Arc::StateId;
+
+  explicit NaryComposeStateTable(size_t nfsts)
+      : size_(nfsts + 1), ids_(0, StateHash(*this), StateEqual(*this)) {}
+
+  NaryComposeStateTable(const NaryComposeStateTable &table)
+      : size_(table.size_),
+        tuples_(table.tuples_),
+        ids_(table.ids_.bucket_count(), StateHash(*this), StateEqual(*this)) {
+    for (StateId s = 0; s < Size(); ++s) ids_.insert(s);
+  }
+
+  // Returns the ID of the tuple, adding it if it is new.
+  StateId FindState(const StateId *tuple) {
+    current_tuple_ = tuple;
+    if (const auto it = ids_.find(kNoStateId); it != ids_.end()) return *it;
+    const StateId s = Size();
+    tuples_.insert(tuples_.end(), tuple, tuple + size_);
+    ids_.insert(s);
+    return s;
+  }
+
+  // Returns the tuple of state s, valid until the next FindState().
+  const StateId *Tuple(StateId s) const {
+    return s == kNoStateId ? current_tuple_ : tuples_.data() + s * size_;
+  }
+
+  StateId Size() const { return tuples_.size() / size_; }
+
+ private:
+  class StateHash {
+   public:
+    explicit StateHash(const NaryComposeStateTable &table) : table_(table) {}
+
+    size_t operator()(StateId s) const {
+      const auto *tuple = table_.Tuple(s);
+      size_t h = 0;
+      for (size_t i = 0; i < table_.size_; ++i) h = h * kPrime + tuple[i];
+      return h;
+    }
+
+   private:
+    static constexpr size_t kPrime = 7853;
+
+    const NaryComposeStateTable &table_;
+  };
+
+  class StateEqual {
+   public:
+    explicit StateEqual(const NaryComposeStateTable &table) : table_(table) {}
+
+    bool operator()(StateId s1, StateId s2) const {
+      if (s1 == s2) return true;
+      const auto *tuple1 = table_.Tuple(s1);
+      return std::equal(tuple1, tuple1 + table_.size_, table_.Tuple(s2));
+    }
+
+   private:
+    const NaryComposeStateTable &table_;
+  };
+
+  const size_t size_;                      // Tuple size.
+  std::vector<StateId> tuples_;            // Tuples, size_ entries per state.
+  const StateId *current_tuple_ = nullptr;  // Tuple being looked up.
+  std::unordered_set<StateId, StateHash, StateEqual> ids_;
+
+  NaryComposeStateTable &operator=(const NaryComposeStateTable &) = delete;
+};
+
+// Implementation of delayed N-ary composition, templated on the cache store
+// and the matcher type. A composition state is a tuple of a state of each
+// FST and a filter state. The arcs of a state are found by iterating the
+// arcs of the first FST and matching their output labels against the input
+// labels of the second FST, the output labels of the results against the
+// input labels of the third FST, and so on; the arcs of the partial
+// compositions are kept only while the state is expanded.
+//
+// Epsilons are handled as by nesting binary compositions with the sequence
+// filter (see compose-filter.h) to the left, ComposeFst(ComposeFst(A, B), C),
+// with one bit of the filter state per nested composition, so the result is
+// the same as that of the nested compositions matching on input labels.
+template <class CacheStore, class M>
+class NaryComposeFstImpl
+    : public ComposeFstImplBase<
+          typename CacheStore::Arc, CacheStore,
+          NaryComposeFst<typename CacheStore::Arc, CacheStore>> {
+ public:
+  using Arc = typename CacheStore::Arc;
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Base =
+      ComposeFstImplBase<Arc, CacheStore, NaryComposeFst<Arc, CacheStore>>;
+  using State = typename CacheStore::State;
+  using CacheImpl = CacheBaseImpl<State, CacheStore>;
+
+  using FstImpl<Arc>::SetInputSymbols;
+  using FstImpl<Arc>::SetOutputSymbols;
+  using FstImpl<Arc>::SetType;
+  using FstImpl<Arc>::SetProperties;
+
+  // The filter state has one bit per nested composition, and is stored as a
+  // state ID.
+  static constexpr size_t kMaxNumFsts = 8 * sizeof(StateId);
+
+  NaryComposeFstImpl(const std::vector<const Fst<Arc> *> &fsts,
+                     const NaryComposeFstOptions<Arc, M> &opts);
+
+  NaryComposeFstImpl(const NaryComposeFstImpl &impl)
+      : Base(impl),
+        fst1_(impl.fst1_ ? impl.fst1_->Copy(true) : nullptr),
+        state_table_(impl.state_table_) {
+    for (const auto &matcher : impl.matchers_) {
+      matchers_.emplace_back(matcher->Copy(true));
+    }
+    InitBuffers();
+  }
+
+  NaryComposeFstImpl *Copy() const override {
+    return new NaryComposeFstImpl(*this);
+  }
+
+  uint64_t Properties() const override { return Properties(kFstProperties); }
+
+  // Sets error if found, and returns other FST impl properties.
+  uint64_t Properties(uint64_t mask) const override {
+    if (mask & kError) {
+      bool error = fst1_ && fst1_->Properties(kError, false);
+      for (const auto &matcher : matchers_) {
+        if (matcher->Properties(0) & kError) error = true;
+      }
+      if (error) SetProperties(kError, kError);
+    }
+    return FstImpl<Arc>::Properties(mask);
+  }
+
+  void Expand(StateId s) override;
+
+ private:
+  // An arc of a partial composition, whose destination component states are
+  // kept apart.
+  struct PartialArc {
+    Label ilabel;
+    Label olabel;
+    Weight weight;
+    StateId fs;  // Filter state of the destination.
+  };
+
+  StateId ComputeStart() override {
+    if (!fst1_) return kNoStateId;
+    tuple_[0] = fst1_->Start();
+    if (tuple_[0] == kNoStateId) return kNoStateId;
+    for (size_t i = 0; i < matchers_.size(); ++i) {
+      tuple_[i + 1] = matchers_[i]->GetFst().Start();
+      if (tuple_[i + 1] == kNoStateId) return kNoStateId;
+    }
+    tuple_.back() = 0;
+    return state_table_.FindState(tuple_.data());
+  }
+
+  Weight ComputeFinal(StateId s) override {
+    const auto *tuple = state_table_.Tuple(s);
+    auto final = fst1_->Final(tuple[0]);
+    for (size_t i = 0; i < matchers_.size(); ++i) {
+      if (final == Weight::Zero()) break;
+      final = Times(final, matchers_[i]->Final(tuple[i + 1]));
+    }
+    return final;
+  }
+
+  void InitBuffers() {
+    const auto nfsts = matchers_.size() + 1;
+    tuple_.resize(nfsts + 1);
+    arcs_.resize(nfsts);
+    nextstates_.resize(nfsts);
+  }
+
+  std::unique_ptr<const Fst<Arc>> fst1_;    // First FST, whose arcs are read.
+  std::vector<std::unique_ptr<M>> matchers_;  // Matchers of FSTs 2..N.
+  NaryComposeStateTable<Arc> state_table_;
+  // Expansion buffers: a state tuple, and per partial composition
+  // of FSTs 1..k+1, its arcs and their k+1 destination component states.
+  std::vector<StateId> tuple_;
+  std::vector<std::vector<PartialArc>> arcs_;
+  std::vector<std::vector<StateId>> nextstates_;
+};
+
+template <class CacheStore, class M>
+NaryComposeFstImpl<CacheStore, M>::NaryComposeFstImpl(
+    const std::vector<const Fst<Arc> *> &fsts,
+    const NaryComposeFstOptions<Arc, M> &opts)
+    : Base(opts), state_table_(fsts.size()) {
+  SetType("compose");
+  if (fsts.empty() || fsts.size() > kMaxNumFsts) {
+    FSTERROR() << "NaryComposeFst: Number of FSTs must be between 1 and "
+               << kMaxNumFsts << ": " << fsts.size();
+    SetProperties(kError, kError);
+    return;
+  }
+  fst1_.reset(fsts[0]->Copy());
+  SetInputSymbols(fsts[0]->InputSymbols());
+  SetOutputSymbols(fsts.back()->OutputSymbols());
+  auto props = fsts[0]->Properties(kFstProperties, false);
+  for (size_t i = 1; i < fsts.size(); ++i) {
+    auto *matcher = i <= opts.matchers.size() && opts.matchers[i - 1]
+                        ? opts.matchers[i - 1]
+                        : new M(*fsts[i], MATCH_INPUT);
+    matchers_.emplace_back(matcher);
+    if (!CompatSymbols(fsts[i]->InputSymbols(), fsts[i - 1]->OutputSymbols())) {
+      FSTERROR() << "NaryComposeFst: Output symbol table of argument " << i
+                 << " does not match input symbol table of argument " << i + 1;
+      SetProperties(kError, kError);
+    }
+    if (matcher->Type(true) != MATCH_INPUT) {
+      FSTERROR() << "NaryComposeFst: Argument " << i + 1
+                 << " cannot match on input labels (sort?).";
+      SetProperties(kError, kError);
+    }
+    props = ComposeProperties(
+        props, matcher->Properties(fsts[i]->Properties(kFstProperties, false)));
+  }
+  SetProperties(props, kCopyProperties);
+  InitBuffers();
+}
+
+template <class CacheStore, class M>
+void NaryComposeFstImpl<CacheStore, M>::Expand(StateId s) {
+  const auto nfsts = matchers_.size() + 1;
+  // Copies the tuple since the state table may grow below.
+  const auto *tuple = state_table_.Tuple(s);
+  tuple_.assign(tuple, tuple + nfsts + 1);
+  const auto fs = tuple_.back();
+  arcs_[0].clear();
+  nextstates_[0].clear();
+  for (ArcIterator<Fst<Arc>> aiter(*fst1_, tuple_[0]); !aiter.Done();
+       aiter.Next()) {
+    const auto &arc = aiter.Value();
+    arcs_[0].push_back({arc.ilabel, arc.olabel, arc.weight, 0});
+    nextstates_[0].push_back(arc.nextstate);
+  }
+  // Final weight of the partial composition state.
+  auto final = fst1_->Final(tuple_[0]);
+  // Composes the partial composition of FSTs 1..k with FST k+1, applying the
+  // sequence filter with state bit k - 1 of 'fs'.
+  for (size_t k = 1; k < nfsts; ++k) {
+    const auto &arcs = arcs_[k - 1];
+    const auto &nextstates = nextstates_[k - 1];
+    auto &narcs = arcs_[k];
+    auto &nnextstates = nextstates_[k];
+    narcs.clear();
+    nnextstates.clear();
+    auto *matcher = matchers_[k - 1].get();
+    matcher->SetState(tuple_[k]);
+    const StateId bit = StateId{1} << (k - 1);
+    // First processes the epsilons of FST k+1, with the partial composition
+    // staying in its state.
+    size_t neps = 0;
+    for (const auto &arc : arcs) {
+      if (arc.olabel == 0) ++neps;
+    }
+    const bool alleps = neps == arcs.size() && final == Weight::Zero();
+    if (!alleps && matcher->Find(kNoLabel)) {
+      const auto nfs = (fs & (bit - 1)) | (neps == 0 ? 0 : bit);
+      for (; !matcher->Done(); matcher->Next()) {
+        const auto &arc = matcher->Value();
+        narcs.push_back({0, arc.olabel, arc.weight, nfs});
+        nnextstates.insert(nnextstates.end(), tuple_.begin(),
+                           tuple_.begin() + k);
+        nnextstates.push_back(arc.nextstate);
+      }
+    }
+    // Then processes matches on the partial composition.
+    for (size_t i = 0; i < arcs.size(); ++i) {
+      const auto &arc1 = arcs[i];
+      if (!matcher->Find(arc1.olabel)) continue;
+      for (; !matcher->Done(); matcher->Next()) {
+        const auto &arc2 = matcher->Value();
+        // FST k+1 may stay only in filter state 0, and epsilons do not match.
+        if (arc2.ilabel == kNoLabel) {
+          if (fs & bit) continue;
+        } else if (arc1.olabel == 0) {
+          continue;
+        }
+        narcs.push_back({arc1.ilabel, arc2.olabel,
+                         Times(arc1.weight, arc2.weight), arc1.fs});
+        nnextstates.insert(nnextstates.end(), nextstates.begin() + i * k,
+                           nextstates.begin() + (i + 1) * k);
+        nnextstates.push_back(arc2.nextstate);
+      }
+    }
+    if (final != Weight::Zero()) {
+      final = Times(final, matcher->Final(tuple_[k]));
+    }
+  }
+  const auto &arcs = arcs_[nfsts - 1];
+  const auto &nextstates = nextstates_[nfsts - 1];
+  for (size_t i = 0; i < arcs.size(); ++i) {
+    const auto &arc = arcs[i];
+    std::copy_n(nextstates.begin() + i * nfsts, nfsts, tuple_.begin());
+    tuple_.back() = arc.fs;
+    CacheImpl::EmplaceArc(s, arc.ilabel, arc.olabel, arc.weight,
+                          state_table_.FindState(tuple_.data()));
+  }
+  CacheImpl::SetArcs(s);
+}
+
+}  // namespace internal
+
+// Computes the composition of a sequence of transducers, FST1 o FST2 o ... o
+// FSTN. This version is a delayed FST, equivalent to the nested compositions
+// ComposeFst(...ComposeFst(ComposeFst(FST1, FST2), FST3)..., FSTN) with the
+// sequence filter, but it caches only the states of the result: each state
+// is a tuple of states of the N FSTs, and its arcs are found by driving the
+// matchers of FST2..FSTN directly from the arcs of FST1, rather than through
+// the cached states and matchers of the nested compositions.
+//
+// The input labels of FST2..FSTN must be sorted (with the default matcher).
+// The weights need to form a commutative semiring (valid for TropicalWeight
+// and LogWeight). At most 8 * sizeof(StateId) FSTs can be composed.
+//
+// Complexity: the expansion of a state takes time proportional to the number
+// of arcs of each of the partial compositions FST1 o ... o FSTk at the
+// corresponding tuple of states, which are not cached. This saves the space
+// of the partial compositions, at the cost of recomputing their arcs from
+// each tuple of the result that shares them.
+//
+// Caveats:
+// - NaryComposeFst does not trim its output (since it is a delayed operation).
+// - Only the sequence filter is supported, and matching is always on the
+//   input labels of FST2..FSTN.
+//
+// This class attaches interface to implementation and handles reference
+// counting, delegating most methods to ImplToFst. The CacheStore specifies the
+// cache store (default declared above).
+template <class A, class CacheStore /* = DefaultCacheStore<A> */>
+class NaryComposeFst : public ImplToFst<internal::ComposeFstImplBase<
+                           A, CacheStore, NaryComposeFst<A, CacheStore>>> {
+ public:
+  using Arc = A;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Store = CacheStore;
+  using State = typename CacheStore::State;
+
+  using Impl = internal::ComposeFstImplBase<A, CacheStore, NaryComposeFst>;
+
+  friend class ArcIterator<NaryComposeFst<Arc, CacheStore>>;
+  friend class StateIterator<NaryComposeFst<Arc, CacheStore>>;
+
+  explicit NaryComposeFst(const std::vector<const Fst<Arc> *> &fsts,
+                          const CacheOptions &opts = CacheOptions())
+      : ImplToFst<Impl>(CreateImpl(fsts, NaryComposeFstOptions<Arc>(opts))) {}
+
+  template <class M>
+  NaryComposeFst(const std::vector<const Fst<Arc> *> &fsts,
+                 const NaryComposeFstOptions<Arc, M> &opts)
+      : ImplToFst<Impl>(CreateImpl(fsts, opts)) {}
+
+  // See Fst<>::Copy() for doc.
+  NaryComposeFst(const NaryComposeFst &fst, bool safe = false)
+      : ImplToFst<Impl>(safe ? std::shared_ptr<Impl>(fst.GetImpl()->Copy())
+                             : fst.GetSharedImpl()) {}
+
+  // Get a copy of this NaryComposeFst. See Fst<>::Copy() for further doc.
+  NaryComposeFst *Copy(bool safe = false) const override {
+    return new NaryComposeFst(*this, safe);
+  }
+
+  inline void InitStateIterator(StateIteratorData<Arc> *data) const override;
+
+  void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const override {
+    GetMutableImpl()->InitArcIterator(s, data);
+  }
+
+ protected:
+  using ImplToFst<Impl>::GetImpl;
+  using ImplToFst<Impl>::GetMutableImpl;
+
+ private:
+  template <class M>
+  static std::shared_ptr<Impl> CreateImpl(
+      const std::vector<const Fst<Arc> *> &fsts,
+      const NaryComposeFstOptions<Arc, M> &opts) {
+    auto impl =
+        std::make_shared<internal::NaryComposeFstImpl<CacheStore, M>>(fsts,
+                                                                      opts);
+    if (!(Weight::Properties() & kCommutative)) {
+      size_t nweighted = 0;
+      for (const auto *fst : fsts) {
+        if (!fst->Properties(kUnweighted, true)) ++nweighted;
+      }
+      if (nweighted > 1) {
+        FSTERROR() << "NaryComposeFst: Weights must be a commutative semiring: "
+                   << Weight::Type();
+        impl->SetProperties(kError, kError);
+      }
+    }
+    return impl;
+  }
+
+  NaryComposeFst &operator=(const NaryComposeFst &fst) = delete;
+};
+
+// Specialization for NaryComposeFst.
+template <class Arc, class CacheStore>
+class StateIterator<NaryComposeFst<Arc, CacheStore>>
+    : public CacheStateIterator<NaryComposeFst<Arc, CacheStore>> {
+ public:
+  explicit StateIterator(const NaryComposeFst<Arc, CacheStore> &fst)
+      : CacheStateIterator<NaryComposeFst<Arc, CacheStore>>(
+            fst, fst.GetMutableImpl()) {}
+};
+
+// Specialization for NaryComposeFst.
+template <class Arc, class CacheStore>
+class ArcIterator<NaryComposeFst<Arc, CacheStore>>
+    : public CacheArcIterator<NaryComposeFst<Arc, CacheStore>> {
+ public:
+  using StateId = typename Arc::StateId;
+
+  ArcIterator(const NaryComposeFst<Arc, CacheStore> &fst, StateId s)
+      : CacheArcIterator<NaryComposeFst<Arc, CacheStore>>(
+            fst.GetMutableImpl(), s) {
+    if (!fst.GetImpl()->HasArcs(s)) fst.GetMutableImpl()->Expand(s);
+  }
+};
+
+template <class Arc, class CacheStore>
+inline void NaryComposeFst<Arc, CacheStore>::InitStateIterator(
+    StateIteratorData<Arc> *data) const {
+  data->base =
+      std::make_unique<StateIterator<NaryComposeFst<Arc, CacheStore>>>(*this);
+}
+
+// Computes the composition of a sequence of transducers. This version writes
+// the composed FST into a MutableFst; see NaryComposeFst for the requirements.
+// Only the AUTO_FILTER and SEQUENCE_FILTER filter types are supported.
+template <class Arc>
+void Compose(const std::vector<const Fst<Arc> *> &fsts, MutableFst<Arc> *ofst,
+             const ComposeOptions &opts = ComposeOptions()) {
+  if (opts.filter_type != AUTO_FILTER && opts.filter_type != SEQUENCE_FILTER) {
+    FSTERROR() << "Compose: Only the sequence filter is supported with more "
+               << "than two FSTs";
+    ofst->SetProperties(kError, kError);
+    return;
+  }
+  // We cache only the last state for fastest copy.
+  CacheOptions nopts;
+  nopts.gc_limit = 0;
+  *ofst = NaryComposeFst<Arc>(fsts, nopts);
+  if (opts.connect) Connect(ofst);
+}
+
+}  // namespace fst
+
+#endif  // FST_NARY_COMPOSE_H_
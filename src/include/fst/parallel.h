@@ -0,0 +1,128 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Helpers for running data-parallel loops over index ranges and graphs.
+
+#ifndef FST_PARALLEL_H_
+#define FST_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace fst {
+
+// Returns the number of worker threads to use for a requested thread count;
+// zero requests one thread per hardware thread.
+inline size_t NumWorkerThreads(size_t num_threads) {
+  if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+  return std::max<size_t>(num_threads, 1);
+}
+
+// Partitions [0, n) into at most num_threads contiguous blocks of near-equal
+// size and calls f(block, begin, end) on each, one block per thread. Blocks
+// are numbered in index order, so per-block results can be merged
+// deterministically. The first block runs on the calling thread. Returns the
+// number of blocks used.
+template <class F>
+size_t ParallelFor(size_t n, size_t num_threads, F f) {
+  const auto nblocks = std::max<size_t>(
+      std::min(NumWorkerThreads(num_threads), n), 1);
+  const auto block_size = (n + nblocks - 1) / nblocks;
+  std::vector<std::thread> threads;
+  threads.reserve(nblocks - 1);
+  for (size_t b = 1; b < nblocks; ++b) {
+    const auto begin = std::min(n, b * block_size);
+    const auto end = std::min(n, begin + block_size);
+    threads.emplace_back([&f, b, begin, end] { f(b, begin, end); });
+  }
+  f(0, 0, std::min(n, block_size));
+  for (auto &thread : threads) thread.join();
+  return nblocks;
+}
+
+namespace internal {
+
+// Bit vector whose bits may be set concurrently from several threads.
+class AtomicBitVector {
+ public:
+  explicit AtomicBitVector(size_t size)
+      : words_(std::make_unique<std::atomic<uint64_t>[]>((size + 63) / 64)) {
+    for (size_t i = 0; i < (size + 63) / 64; ++i) words_[i] = 0;
+  }
+
+  bool Get(size_t i) const {
+    return words_[i / 64].load(std::memory_order_relaxed) & Mask(i);
+  }
+
+  // Sets bit i, returning true if it was not already set.
+  bool TestAndSet(size_t i) {
+    auto &word = words_[i / 64];
+    if (word.load(std::memory_order_relaxed) & Mask(i)) return false;
+    return !(word.fetch_or(Mask(i), std::memory_order_relaxed) & Mask(i));
+  }
+
+  void Clear(size_t i) {
+    words_[i / 64].fetch_and(~Mask(i), std::memory_order_relaxed);
+  }
+
+ private:
+  static uint64_t Mask(size_t i) { return uint64_t{1} << (i % 64); }
+
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+};
+
+// Frontiers smaller than this are expanded on the calling thread.
+inline constexpr size_t kMinParallelFrontier = 4096;
+
+// Level-synchronous breadth-first search from the states in 'frontier', which
+// must already be marked in 'visited'. Each frontier is split across
+// num_threads threads; expand(block, s, visit) calls visit(t) for each
+// successor t of s, where block identifies the calling thread.
+template <class StateId, class Expand>
+void ParallelBfs(std::vector<StateId> frontier, AtomicBitVector *visited,
+                 size_t num_threads, Expand expand) {
+  std::vector<std::vector<StateId>> next(NumWorkerThreads(num_threads));
+  while (!frontier.empty()) {
+    const auto nblocks = ParallelFor(
+        frontier.size(),
+        frontier.size() < kMinParallelFrontier ? 1 : num_threads,
+        [&frontier, &next, visited, &expand](size_t block, size_t begin,
+                                            size_t end) {
+          auto &states = next[block];
+          states.clear();
+          const auto visit = [&states, visited](StateId t) {
+            if (visited->TestAndSet(t)) states.push_back(t);
+          };
+          for (auto i = begin; i < end; ++i) expand(block, frontier[i], visit);
+        });
+    frontier.clear();
+    for (size_t block = 0; block < nblocks; ++block) {
+      frontier.insert(frontier.end(), next[block].begin(), next[block].end());
+    }
+  }
+}
+
+}  // namespace internal
+
+}  // namespace fst
+
+#endif  // FST_PARALLEL_H_
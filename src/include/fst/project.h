@@ -21,6 +21,7 @@
 #define FST_PROJECT_H_
 
 #include <cstdint>
+#include <type_traits>
 
 #include <fst/arc-map.h>
 #include <fst/arc.h>
@@ -72,10 +73,18 @@ class ProjectMapper {
     return ProjectProperties(props, project_type_ == ProjectType::INPUT);
   }
 
+  // Both sides of a projected arc carry the labels of the projected side.
+  constexpr MatchType LabelSource(MatchType) const {
+    return project_type_ == ProjectType::INPUT ? MATCH_INPUT : MATCH_OUTPUT;
+  }
+
  private:
   const ProjectType project_type_;
 };
 
+template <class A>
+struct IsThreadSafeMapper<ProjectMapper<A>> : std::true_type {};
+
 // Projects an FST onto its domain or range by either copying each arcs' input
 // label to the output label or vice versa.
 //
@@ -175,9 +184,73 @@ class ArcIterator<ProjectFst<A>>
       : ArcIterator<ArcMapFst<A, A, ProjectMapper<A>>>(fst, s) {}
 };
 
-// Useful alias when using StdArc.
+// Projects an FST onto its domain or range. Unlike ProjectFst, this version
+// does no caching: arcs are projected as they are visited and matching is
+// passed through to the input FST's matcher.
+//
+// Complexity:
+//
+//   Time: O(v + e)
+//   Space: O(1)
+//
+// where v is the number of states visited and e is the number of arcs visited.
+template <class A>
+class ProjectViewFst : public ArcMapViewFst<A, A, ProjectMapper<A>> {
+ public:
+  using FromArc = A;
+  using ToArc = A;
+
+  using Impl = internal::ArcMapViewFstImpl<A, A, ProjectMapper<A>>;
+
+  ProjectViewFst(const Fst<A> &fst, ProjectType project_type)
+      : ArcMapViewFst<A, A, ProjectMapper<A>>(fst,
+                                              ProjectMapper<A>(project_type)) {
+    if (project_type == ProjectType::INPUT) {
+      GetMutableImpl()->SetOutputSymbols(fst.InputSymbols());
+    }
+    if (project_type == ProjectType::OUTPUT) {
+      GetMutableImpl()->SetInputSymbols(fst.OutputSymbols());
+    }
+  }
+
+  // See Fst<>::Copy() for doc.
+  ProjectViewFst(const ProjectViewFst &fst, bool safe = false)
+      : ArcMapViewFst<A, A, ProjectMapper<A>>(fst, safe) {}
+
+  // Gets a copy of this ProjectViewFst. See Fst<>::Copy() for further doc.
+  ProjectViewFst *Copy(bool safe = false) const override {
+    return new ProjectViewFst(*this, safe);
+  }
+
+ private:
+  using ImplToFst<Impl>::GetMutableImpl;
+};
+
+// Specialization for ProjectViewFst.
+template <class A>
+class StateIterator<ProjectViewFst<A>>
+    : public StateIterator<ArcMapViewFst<A, A, ProjectMapper<A>>> {
+ public:
+  explicit StateIterator(const ProjectViewFst<A> &fst)
+      : StateIterator<ArcMapViewFst<A, A, ProjectMapper<A>>>(fst) {}
+};
+
+// Specialization for ProjectViewFst.
+template <class A>
+class ArcIterator<ProjectViewFst<A>>
+    : public ArcIterator<ArcMapViewFst<A, A, ProjectMapper<A>>> {
+ public:
+  using StateId = typename A::StateId;
+
+  ArcIterator(const ProjectViewFst<A> &fst, StateId s)
+      : ArcIterator<ArcMapViewFst<A, A, ProjectMapper<A>>>(fst, s) {}
+};
+
+// Useful aliases when using StdArc.
 using StdProjectFst = ProjectFst<StdArc>;
 
+using StdProjectViewFst = ProjectViewFst<StdArc>;
+
 }  // namespace fst
 
 #endif  // FST_PROJECT_H_
@@ -23,6 +23,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <queue>
@@ -639,10 +640,13 @@ class AutoQueue : public QueueBase<S> {
 
   // This constructor takes a state distance vector that, if non-null and if
   // the Weight type has the path property, will entertain the shortest-first
-  // queue using the natural order w.r.t to the distance.
+  // queue using the natural order w.r.t to the distance. If num_threads is not
+  // one, the SCCs of an FST with a known number of states are found by
+  // ParallelScc on that many threads (zero means one per hardware thread).
   template <class Arc, class ArcFilter>
   AutoQueue(const Fst<Arc> &fst,
-            const std::vector<typename Arc::Weight> *distance, ArcFilter filter)
+            const std::vector<typename Arc::Weight> *distance, ArcFilter filter,
+            size_t num_threads = 1)
       : QueueBase<StateId>(AUTO_QUEUE) {
     using Weight = typename Arc::Weight;
     // We need to have variables of type Less and Compare, so we use
@@ -666,8 +670,13 @@ class AutoQueue : public QueueBase<S> {
     } else {
       uint64_t properties;
       // Decomposes into strongly-connected components.
-      SccVisitor<Arc> scc_visitor(&scc_, nullptr, nullptr, &properties);
-      DfsVisit(fst, &scc_visitor, filter);
+      if (num_threads != 1) {
+        ParallelScc(fst, &scc_, nullptr, nullptr, &properties, filter,
+                    num_threads);
+      } else {
+        SccVisitor<Arc> scc_visitor(&scc_, nullptr, nullptr, &properties);
+        DfsVisit(fst, &scc_visitor, filter);
+      }
       auto nscc = *std::max_element(scc_.begin(), scc_.end()) + 1;
       std::vector<QueueType> queue_types(nscc);
       std::unique_ptr<Less> less;
@@ -27,10 +27,10 @@
 #include <cstring>
 #include <functional>
 #include <limits>
-#include <map>
 #include <memory>
 #include <numeric>
 #include <random>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -44,8 +44,10 @@
 #include <fst/fst.h>
 #include <fst/impl-to-fst.h>
 #include <fst/mutable-fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/util.h>
+#include <fst/vector-fst.h>
 #include <fst/weight.h>
 #include <vector>
 
@@ -72,7 +74,7 @@ class UniformArcSelector {
   using Weight = typename Arc::Weight;
 
   explicit UniformArcSelector(uint64_t seed = std::random_device()())
-      : rand_(seed) {}
+      : seed_(seed), rand_(seed) {}
 
   size_t operator()(const Fst<Arc> &fst, StateId s) const {
     const auto n = fst.NumArcs(s) + (fst.Final(s) != Weight::Zero());
@@ -80,7 +82,18 @@ class UniformArcSelector {
         std::uniform_int_distribution<>(0, n - 1)(rand_));
   }
 
+  // Computes the unnormalized probability of each transition leaving the
+  // state, the final weight last.
+  void TransitionProbs(const Fst<Arc> &fst, StateId s,
+                       std::vector<double> *probs) const {
+    probs->assign(fst.NumArcs(s), 1.0);
+    probs->push_back(fst.Final(s) != Weight::Zero() ? 1.0 : 0.0);
+  }
+
+  uint64_t Seed() const { return seed_; }
+
  private:
+  const uint64_t seed_;
   mutable std::mt19937_64 rand_;
 };
 
@@ -121,6 +134,20 @@ class LogProbArcSelector {
     return n;
   }
 
+  // Computes the unnormalized probability of each transition leaving the
+  // state, the final weight last. Probabilities are scaled relative to the
+  // most likely transition to avoid underflow.
+  void TransitionProbs(const Fst<Arc> &fst, StateId s,
+                       std::vector<double> *probs) const {
+    probs->clear();
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      probs->push_back(to_log_weight_(aiter.Value().weight).Value());
+    }
+    probs->push_back(to_log_weight_(fst.Final(s)).Value());
+    const auto min = *std::min_element(probs->begin(), probs->end());
+    for (auto &p : *probs) p = std::isinf(min) ? 0.0 : exp(min - p);
+  }
+
   uint64_t Seed() const { return seed_; }
 
  protected:
@@ -173,6 +200,236 @@ class FastLogProbArcSelector : public LogProbArcSelector<Arc> {
   const WeightConvert<Log64Weight, Weight> from_log_weight_{};
 };
 
+// Table for Walker's alias method: after linear-time setup, draws an index
+// from a fixed discrete distribution in constant time using one uniform
+// variate.
+class AliasTable {
+ public:
+  AliasTable() = default;
+
+  // Builds the table for the distribution proportional to the non-negative
+  // weights. If all weights are zero, the table is empty.
+  explicit AliasTable(const std::vector<double> &weights) { Init(weights); }
+
+  void Init(const std::vector<double> &weights) {
+    const auto n = weights.size();
+    const auto sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    prob_.clear();
+    alias_.clear();
+    if (!(sum > 0.0) || !std::isfinite(sum)) return;
+    prob_.resize(n);
+    alias_.resize(n);
+    std::vector<size_t> small;
+    std::vector<size_t> large;
+    for (size_t i = 0; i < n; ++i) {
+      prob_[i] = weights[i] * n / sum;
+      alias_[i] = i;
+      (prob_[i] < 1.0 ? small : large).push_back(i);
+    }
+    size_t last_large =
+        std::max_element(weights.begin(), weights.end()) - weights.begin();
+    while (!small.empty() && !large.empty()) {
+      const auto l = small.back();
+      small.pop_back();
+      const auto g = large.back();
+      alias_[l] = g;
+      prob_[g] = (prob_[g] + prob_[l]) - 1.0;
+      last_large = g;
+      if (prob_[g] < 1.0) {
+        large.pop_back();
+        small.push_back(g);
+      }
+    }
+    // Entries left over due to round-off get (nearly) probability one, except
+    // for impossible ones, which are redirected.
+    for (const auto i : large) prob_[i] = 1.0;
+    for (const auto i : small) {
+      if (weights[i] > 0.0) {
+        prob_[i] = 1.0;
+      } else {
+        prob_[i] = 0.0;
+        alias_[i] = last_large;
+      }
+    }
+  }
+
+  // Maps a uniform variate u in [0, 1) to an index.
+  size_t Draw(double u) const {
+    const auto x = u * prob_.size();
+    const auto i = std::min(static_cast<size_t>(x), prob_.size() - 1);
+    return x - i < prob_[i] ? i : alias_[i];
+  }
+
+  size_t Size() const { return prob_.size(); }
+
+  bool Empty() const { return prob_.empty(); }
+
+  // Approximate number of bytes used by the table.
+  size_t ByteSize() const {
+    return sizeof(*this) + prob_.capacity() * sizeof(double) +
+           alias_.capacity() * sizeof(size_t);
+  }
+
+ private:
+  std::vector<double> prob_;   // Probability of keeping each index.
+  std::vector<size_t> alias_;  // Index selected otherwise.
+};
+
+// Counter-based random bit generator: the n-th output of a stream is a pure
+// function of the seed, the stream ID and n, so draws do not depend on how
+// streams are distributed over threads. Satisfies UniformRandomBitGenerator.
+class CounterRandom {
+ public:
+  using result_type = uint64_t;
+
+  CounterRandom(uint64_t seed, uint64_t stream)
+      : key_(Mix(seed ^ Mix(stream + kGamma))) {}
+
+  static constexpr result_type min() { return 0; }
+
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() { return Mix(key_ + kGamma * ++counter_); }
+
+  // Returns a uniform variate in [0, 1) with 53 random bits.
+  double UniformReal() { return ((*this)() >> 11) * 0x1.0p-53; }
+
+ private:
+  static constexpr uint64_t kGamma = 0x9e3779b97f4a7c15ULL;
+
+  // SplitMix64 finalizer.
+  static uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  const uint64_t key_;
+  uint64_t counter_ = 0;
+};
+
+// Per-state cache of the alias tables of one FST, owned by the ArcSampler
+// specialization for AliasArcSelector. Garbage collection works as in
+// CacheLogAccumulatorData.
+class AliasTableCacheData {
+ public:
+  AliasTableCacheData(bool gc, size_t gc_limit)
+      : cache_gc_(gc), cache_limit_(gc_limit), cache_size_(0) {}
+
+  bool CacheDisabled() const { return cache_gc_ && cache_limit_ == 0; }
+
+  const AliasTable *GetTable(int64_t s) {
+    if (auto it = cache_.find(s); it != cache_.end()) {
+      it->second.recent = true;
+      return it->second.table.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  const AliasTable *AddTable(int64_t s, std::unique_ptr<AliasTable> table) {
+    if (cache_gc_ && cache_size_ >= cache_limit_) GC(false);
+    if (cache_gc_) cache_size_ += table->ByteSize();
+    return cache_.emplace(s, CacheState(std::move(table), true))
+        .first->second.table.get();
+  }
+
+ private:
+  // Cached information for a given state.
+  struct CacheState {
+    std::unique_ptr<AliasTable> table;
+    bool recent;  // Has this state been accessed since last GC?
+
+    CacheState(std::unique_ptr<AliasTable> table, bool recent)
+        : table(std::move(table)), recent(recent) {}
+  };
+
+  // Garbage collect: Deletes from cache states that have not been accessed
+  // since the last GC ('free_recent = false') until 'cache_size_' is 2/3 of
+  // 'cache_limit_'. If it does not free enough memory, start deleting
+  // recently accessed states.
+  void GC(bool free_recent) {
+    auto cache_target = (2 * cache_limit_) / 3 + 1;
+    auto it = cache_.begin();
+    while (it != cache_.end() && cache_size_ > cache_target) {
+      auto &cs = it->second;
+      if (free_recent || !cs.recent) {
+        cache_size_ -= cs.table->ByteSize();
+        cache_.erase(it++);
+      } else {
+        cs.recent = false;
+        ++it;
+      }
+    }
+    if (!free_recent && cache_size_ > cache_target) GC(true);
+  }
+
+  std::unordered_map<int64_t, CacheState> cache_;  // Cache.
+  bool cache_gc_;       // Enables garbage collection.
+  size_t cache_limit_;  // # of bytes allowed before GC.
+  size_t cache_size_;   // # of bytes cached.
+
+  AliasTableCacheData &operator=(const AliasTableCacheData &) = delete;
+};
+
+// Randomly selects a transition with the same distribution as
+// LogProbArcSelector, but in constant time using Walker's alias method when
+// given the alias table cache of the FST. The alias table of a state is built
+// on its first visit and cached, so this pays off when many paths are drawn
+// through the same states. The ArcSampler specialization below keeps a
+// separate cache per FST, so a selector may be used with several FSTs (e.g.,
+// in RandEquivalent). States with fewer than arc_limit arcs are not cached and
+// are sampled as in LogProbArcSelector. This class is not thread-safe.
+template <class Arc>
+class AliasArcSelector : public LogProbArcSelector<Arc> {
+ public:
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using LogProbArcSelector<Arc>::MutableRand;
+  using LogProbArcSelector<Arc>::TransitionProbs;
+  using LogProbArcSelector<Arc>::operator();
+
+  // Constructs a selector with a given seed. If gc is true, the cached tables
+  // are garbage-collected when they exceed gc_limit bytes.
+  explicit AliasArcSelector(uint64_t seed = std::random_device()(),
+                            size_t arc_limit = 4, bool gc = false,
+                            size_t gc_limit = 10 * 1024 * 1024)
+      : LogProbArcSelector<Arc>(seed),
+        arc_limit_(arc_limit),
+        gc_(gc),
+        gc_limit_(gc_limit) {}
+
+  // Selects a transition using the alias table cache of the FST.
+  size_t operator()(const Fst<Arc> &fst, StateId s,
+                    AliasTableCacheData *data) const {
+    if (data->CacheDisabled() || fst.NumArcs(s) < arc_limit_) {
+      return LogProbArcSelector<Arc>::operator()(fst, s);
+    }
+    const auto *table = data->GetTable(s);
+    if (table == nullptr) {
+      TransitionProbs(fst, s, &probs_);
+      table = data->AddTable(s, std::make_unique<AliasTable>(probs_));
+    }
+    if (table->Empty()) return LogProbArcSelector<Arc>::operator()(fst, s);
+    return table->Draw(
+        std::uniform_real_distribution<>(0, 1)(MutableRand()));
+  }
+
+  // Returns an empty alias table cache configured for this selector.
+  std::unique_ptr<AliasTableCacheData> NewCacheData() const {
+    return std::make_unique<AliasTableCacheData>(gc_, gc_limit_);
+  }
+
+ private:
+  const size_t arc_limit_;
+  const bool gc_;
+  const size_t gc_limit_;
+  mutable std::vector<double> probs_;  // Scratch buffer.
+};
+
 // Random path state info maintained by RandGenFst and passed to samplers.
 template <typename Arc>
 struct RandState {
@@ -195,6 +452,19 @@ struct RandState {
   RandState() : RandState(kNoStateId) {}
 };
 
+namespace internal {
+
+// Appends the (N, K) pairs of transitions with non-zero sample counts, in order
+// of N.
+inline void CollectSamples(const std::vector<size_t> &counts,
+                           std::vector<std::pair<size_t, size_t>> *samples) {
+  for (size_t n = 0; n < counts.size(); ++n) {
+    if (counts[n] != 0) samples->emplace_back(n, counts[n]);
+  }
+}
+
+}  // namespace internal
+
 // This class, given an arc selector, samples, with replacement, multiple random
 // transitions from an FST's state. This is a generic version with a
 // straightforward use of the arc selector. Specializations may be defined for
@@ -227,29 +497,49 @@ class ArcSampler {
   // length has been exceeded. Iterator members are provided to read the samples
   // in the order in which they were collected.
   bool Sample(const RandState<Arc> &rstate) {
-    sample_map_.clear();
+    samples_.clear();
     if ((fst_.NumArcs(rstate.state_id) == 0 &&
          fst_.Final(rstate.state_id) == Weight::Zero()) ||
         rstate.length == max_length_) {
       Reset();
       return false;
     }
-    for (size_t i = 0; i < rstate.nsamples; ++i) {
-      ++sample_map_[selector_(fst_, rstate.state_id)];
+    const auto nsamples = rstate.nsamples;
+    const auto ntrans = fst_.NumArcs(rstate.state_id) + 1;
+    if (nsamples < ntrans) {
+      // Few draws: sorts them and counts runs.
+      draws_.clear();
+      for (size_t i = 0; i < nsamples; ++i) {
+        draws_.push_back(selector_(fst_, rstate.state_id));
+      }
+      std::sort(draws_.begin(), draws_.end());
+      for (const auto n : draws_) {
+        if (samples_.empty() || samples_.back().first != n) {
+          samples_.emplace_back(n, 0);
+        }
+        ++samples_.back().second;
+      }
+    } else {
+      // Many draws: counts them per transition.
+      draws_.assign(ntrans, 0);
+      for (size_t i = 0; i < nsamples; ++i) {
+        ++draws_[selector_(fst_, rstate.state_id)];
+      }
+      internal::CollectSamples(draws_, &samples_);
     }
     Reset();
     return true;
   }
 
   // More samples?
-  bool Done() const { return sample_iter_ == sample_map_.end(); }
+  bool Done() const { return sample_pos_ == samples_.size(); }
 
   // Gets the next sample.
-  void Next() { ++sample_iter_; }
+  void Next() { ++sample_pos_; }
 
-  std::pair<size_t, size_t> Value() const { return *sample_iter_; }
+  std::pair<size_t, size_t> Value() const { return samples_[sample_pos_]; }
 
-  void Reset() { sample_iter_ = sample_map_.begin(); }
+  void Reset() { sample_pos_ = 0; }
 
   bool Error() const { return false; }
 
@@ -258,9 +548,11 @@ class ArcSampler {
   const Selector &selector_;
   const int32_t max_length_;
 
-  // Stores (N, K) as described for Value().
-  std::map<size_t, size_t> sample_map_;
-  std::map<size_t, size_t>::const_iterator sample_iter_;
+  // Stores (N, K) as described for Value(), sorted by N.
+  std::vector<std::pair<size_t, size_t>> samples_;
+  size_t sample_pos_ = 0;
+  // Scratch buffer of draws or per-transition counts.
+  std::vector<size_t> draws_;
 
   ArcSampler<Arc, Selector> &operator=(const ArcSampler &) = delete;
 };
@@ -325,32 +617,35 @@ class ArcSampler<Arc, FastLogProbArcSelector<Arc>> {
   }
 
   bool Sample(const RandState<Arc> &rstate) {
-    sample_map_.clear();
+    samples_.clear();
     if ((fst_.NumArcs(rstate.state_id) == 0 &&
          fst_.Final(rstate.state_id) == Weight::Zero()) ||
         rstate.length == max_length_) {
       Reset();
       return false;
     }
-    if (fst_.NumArcs(rstate.state_id) + 1 < rstate.nsamples) {
+    const auto ntrans = fst_.NumArcs(rstate.state_id) + 1;
+    if (ntrans < rstate.nsamples) {
       MultinomialSample(rstate);
       Reset();
       return true;
     }
+    counts_.assign(ntrans, 0);
     for (size_t i = 0; i < rstate.nsamples; ++i) {
-      ++sample_map_[selector_(fst_, rstate.state_id, accumulator_.get())];
+      ++counts_[selector_(fst_, rstate.state_id, accumulator_.get())];
     }
+    internal::CollectSamples(counts_, &samples_);
     Reset();
     return true;
   }
 
-  bool Done() const { return sample_iter_ == sample_map_.end(); }
+  bool Done() const { return sample_pos_ == samples_.size(); }
 
-  void Next() { ++sample_iter_; }
+  void Next() { ++sample_pos_; }
 
-  std::pair<size_t, size_t> Value() const { return *sample_iter_; }
+  std::pair<size_t, size_t> Value() const { return samples_[sample_pos_]; }
 
-  void Reset() { sample_iter_ = sample_map_.begin(); }
+  void Reset() { sample_pos_ = 0; }
 
   bool Error() const { return accumulator_->Error(); }
 
@@ -368,22 +663,26 @@ class ArcSampler<Arc, FastLogProbArcSelector<Arc>> {
     if (fst_.Final(rstate.state_id) != Weight::Zero()) {
       p_.push_back(exp(-to_log_weight_(fst_.Final(rstate.state_id)).Value()));
     }
+    counts_.assign(p_.size(), 0);
     if (rstate.nsamples < std::numeric_limits<RNG::result_type>::max()) {
-      OneMultinomialSample(p_, rstate.nsamples, &sample_map_, &rng_);
+      OneMultinomialSample(p_, rstate.nsamples, &counts_, &rng_);
     } else {
       for (size_t i = 0; i < p_.size(); ++i) {
-        sample_map_[i] = ceil(p_[i] * rstate.nsamples);
+        counts_[i] = ceil(p_[i] * rstate.nsamples);
       }
     }
+    internal::CollectSamples(counts_, &samples_);
   }
 
   const Fst<Arc> &fst_;
   const Selector &selector_;
   const int32_t max_length_;
 
-  // Stores (N, K) for Value().
-  std::map<size_t, size_t> sample_map_;
-  std::map<size_t, size_t>::const_iterator sample_iter_;
+  // Stores (N, K) for Value(), sorted by N.
+  std::vector<std::pair<size_t, size_t>> samples_;
+  size_t sample_pos_ = 0;
+  // Scratch buffer of per-transition sample counts.
+  std::vector<size_t> counts_;
 
   std::unique_ptr<Accumulator> accumulator_;
   RNG rng_;                // Random number generator.
@@ -391,6 +690,76 @@ class ArcSampler<Arc, FastLogProbArcSelector<Arc>> {
   const WeightConvert<Weight, Log64Weight> to_log_weight_{};
 };
 
+// Specialization for AliasArcSelector, which keeps the alias tables of its FST.
+template <class Arc>
+class ArcSampler<Arc, AliasArcSelector<Arc>> {
+ public:
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Selector = AliasArcSelector<Arc>;
+
+  ArcSampler(const Fst<Arc> &fst, const Selector &selector,
+             int32_t max_length = std::numeric_limits<int32_t>::max())
+      : fst_(fst),
+        selector_(selector),
+        max_length_(max_length),
+        data_(selector.NewCacheData()) {}
+
+  ArcSampler(const ArcSampler<Arc, Selector> &sampler,
+             const Fst<Arc> *fst = nullptr)
+      : fst_(fst ? *fst : sampler.fst_),
+        selector_(sampler.selector_),
+        max_length_(sampler.max_length_) {
+    if (fst) {
+      data_ = selector_.NewCacheData();
+    } else {  // Shallow copy.
+      data_ = sampler.data_;
+    }
+  }
+
+  bool Sample(const RandState<Arc> &rstate) {
+    samples_.clear();
+    if ((fst_.NumArcs(rstate.state_id) == 0 &&
+         fst_.Final(rstate.state_id) == Weight::Zero()) ||
+        rstate.length == max_length_) {
+      Reset();
+      return false;
+    }
+    const auto ntrans = fst_.NumArcs(rstate.state_id) + 1;
+    counts_.assign(ntrans, 0);
+    for (size_t i = 0; i < rstate.nsamples; ++i) {
+      ++counts_[selector_(fst_, rstate.state_id, data_.get())];
+    }
+    internal::CollectSamples(counts_, &samples_);
+    Reset();
+    return true;
+  }
+
+  bool Done() const { return sample_pos_ == samples_.size(); }
+
+  void Next() { ++sample_pos_; }
+
+  std::pair<size_t, size_t> Value() const { return samples_[sample_pos_]; }
+
+  void Reset() { sample_pos_ = 0; }
+
+  bool Error() const { return false; }
+
+ private:
+  const Fst<Arc> &fst_;
+  const Selector &selector_;
+  const int32_t max_length_;
+
+  // Stores (N, K) for Value(), sorted by N.
+  std::vector<std::pair<size_t, size_t>> samples_;
+  size_t sample_pos_ = 0;
+  // Scratch buffer of per-transition sample counts.
+  std::vector<size_t> counts_;
+
+  std::shared_ptr<AliasTableCacheData> data_;
+};
+
 // Options for random path generation with RandGenFst. The template argument is
 // a sampler, typically the class ArcSampler. Ownership of the sampler is taken
 // by RandGenFst.
@@ -775,6 +1144,192 @@ void RandGen(const Fst<FromArc> &ifst, MutableFst<ToArc> *ofst,
   RandGen(ifst, ofst, opts);
 }
 
+namespace internal {
+
+// Random paths sampled by one thread in ParallelRandGen. Path i follows the
+// arc positions in [offsets[i], offsets[i + 1]) of the flat positions buffer.
+struct RandPathBlock {
+  std::vector<size_t> positions;
+  std::vector<size_t> offsets{0};
+  std::vector<bool> accepted;  // Whether path i ended in a final state.
+};
+
+// Node of the path prefix tree built by ParallelRandGen for weighted output.
+template <class Arc>
+struct RandPathNode {
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+
+  StateId parent;    // Parent node.
+  Label ilabel;      // Input label of the arc from the parent.
+  Label olabel;      // Output label of the arc from the parent.
+  StateId state;     // Input FST state reached.
+  size_t count = 0;  // Number of sampled paths with this prefix.
+  size_t nfinal = 0;  // Number of sampled paths ending here.
+};
+
+}  // namespace internal
+
+// Randomly generates paths through an FST with the same output as RandGen,
+// sampling them on num_threads threads (zero means one per hardware thread).
+// Path n is drawn from its own counter-based random stream keyed by the
+// selector seed and n, so the output depends on the seed but not on the number
+// of threads. Transitions are drawn in constant time from alias tables
+// precomputed for every state from the selector's TransitionProbs(). The input
+// is copied into a VectorFst unless it is already expanded.
+template <class FromArc, class ToArc, class Selector>
+void ParallelRandGen(const Fst<FromArc> &ifst, MutableFst<ToArc> *ofst,
+                     const RandGenOptions<Selector> &opts,
+                     size_t num_threads = 0) {
+  using StateId = typename FromArc::StateId;
+  using ToWeight = typename ToArc::Weight;
+  using Node = internal::RandPathNode<FromArc>;
+  ofst->DeleteStates();
+  ofst->SetInputSymbols(ifst.InputSymbols());
+  ofst->SetOutputSymbols(ifst.OutputSymbols());
+  if (ifst.Properties(kError, false)) {
+    ofst->SetProperties(kError, kError);
+    return;
+  }
+  std::unique_ptr<const ExpandedFst<FromArc>> copy;
+  if (!ifst.Properties(kExpanded, false)) {
+    copy = std::make_unique<VectorFst<FromArc>>(ifst);
+  }
+  const auto &efst =
+      copy ? *copy : static_cast<const ExpandedFst<FromArc> &>(ifst);
+  const auto start = efst.Start();
+  if (start == kNoStateId || opts.npath <= 0) return;
+  // Precomputes the alias tables.
+  std::vector<AliasTable> tables(efst.NumStates());
+  ParallelFor(tables.size(), num_threads,
+              [&](size_t, size_t begin, size_t end) {
+                std::unique_ptr<const Fst<FromArc>> fst(efst.Copy(true));
+                std::vector<double> probs;
+                for (auto s = begin; s < end; ++s) {
+                  opts.selector.TransitionProbs(*fst, s, &probs);
+                  tables[s].Init(probs);
+                }
+              });
+  // Samples the paths.
+  const auto npath = static_cast<size_t>(opts.npath);
+  const auto seed = opts.selector.Seed();
+  std::vector<internal::RandPathBlock> blocks(NumWorkerThreads(num_threads));
+  const auto nblocks = ParallelFor(
+      npath, num_threads, [&](size_t b, size_t begin, size_t end) {
+        std::unique_ptr<const Fst<FromArc>> fst(efst.Copy(true));
+        auto &block = blocks[b];
+        for (auto n = begin; n < end; ++n) {
+          CounterRandom rand(seed, n);
+          auto s = start;
+          bool accepted = false;
+          for (int32_t length = 0; length < opts.max_length; ++length) {
+            const auto &table = tables[s];
+            if (table.Empty()) break;
+            const auto pos = table.Draw(rand.UniformReal());
+            if (pos + 1 == table.Size()) {
+              accepted = true;
+              break;
+            }
+            ArcIterator<Fst<FromArc>> aiter(*fst, s);
+            aiter.Seek(pos);
+            block.positions.push_back(pos);
+            s = aiter.Value().nextstate;
+          }
+          block.offsets.push_back(block.positions.size());
+          block.accepted.push_back(accepted);
+        }
+      });
+  if (!opts.weighted) {
+    // Outputs each accepted path as its own chain from the start state.
+    for (size_t b = 0; b < nblocks; ++b) {
+      const auto &block = blocks[b];
+      for (size_t i = 0; i < block.accepted.size(); ++i) {
+        if (!block.accepted[i]) continue;
+        if (ofst->Start() == kNoStateId) ofst->SetStart(ofst->AddState());
+        auto src = ofst->Start();
+        auto s = start;
+        for (auto j = block.offsets[i]; j < block.offsets[i + 1]; ++j) {
+          ArcIterator<Fst<FromArc>> aiter(efst, s);
+          aiter.Seek(block.positions[j]);
+          const auto &arc = aiter.Value();
+          const auto dest = ofst->AddState();
+          ofst->AddArc(src,
+                       ToArc(arc.ilabel, arc.olabel, ToWeight::One(), dest));
+          src = dest;
+          s = arc.nextstate;
+        }
+        ofst->SetFinal(src);
+      }
+    }
+    return;
+  }
+  // Builds the prefix tree of all paths, visiting them in lexicographic order
+  // of arc positions so that each node is created after its left siblings.
+  struct Path {
+    const size_t *begin;
+    const size_t *end;
+    bool accepted;
+  };
+  std::vector<Path> paths;
+  paths.reserve(npath);
+  for (size_t b = 0; b < nblocks; ++b) {
+    const auto &block = blocks[b];
+    for (size_t i = 0; i < block.accepted.size(); ++i) {
+      paths.push_back({block.positions.data() + block.offsets[i],
+                       block.positions.data() + block.offsets[i + 1],
+                       block.accepted[i]});
+    }
+  }
+  std::sort(paths.begin(), paths.end(), [](const Path &x, const Path &y) {
+    return std::lexicographical_compare(x.begin, x.end, y.begin, y.end);
+  });
+  std::vector<Node> nodes;
+  nodes.push_back({kNoStateId, 0, 0, start});
+  std::vector<StateId> stack;  // Nodes along the current path.
+  const Path *prev = nullptr;
+  for (const auto &path : paths) {
+    const auto len = static_cast<size_t>(path.end - path.begin);
+    size_t prefix = 0;
+    if (prev) {
+      prefix = std::mismatch(path.begin, path.end, prev->begin, prev->end)
+                   .first - path.begin;
+    }
+    stack.resize(prefix + 1);
+    stack.front() = 0;
+    for (auto d = prefix; d < len; ++d) {
+      const auto parent = stack.back();
+      ArcIterator<Fst<FromArc>> aiter(efst, nodes[parent].state);
+      aiter.Seek(path.begin[d]);
+      const auto &arc = aiter.Value();
+      nodes.push_back({parent, arc.ilabel, arc.olabel, arc.nextstate});
+      stack.push_back(nodes.size() - 1);
+    }
+    for (const auto node : stack) ++nodes[node].count;
+    if (path.accepted) ++nodes[stack.back()].nfinal;
+    prev = &path;
+  }
+  // Outputs the tree weighted by path counts.
+  const WeightConvert<Log64Weight, ToWeight> to_weight;
+  ofst->AddStates(nodes.size());
+  ofst->SetStart(0);
+  for (StateId i = 0; i < static_cast<StateId>(nodes.size()); ++i) {
+    const auto &node = nodes[i];
+    if (i > 0) {
+      const double prob =
+          static_cast<double>(node.count) / nodes[node.parent].count;
+      ofst->AddArc(node.parent,
+                   ToArc(node.ilabel, node.olabel,
+                         to_weight(Log64Weight(-log(prob))), i));
+    }
+    if (node.nfinal > 0) {
+      const double prob = static_cast<double>(node.nfinal) / node.count;
+      ofst->SetFinal(i, opts.remove_total_weight
+                            ? to_weight(Log64Weight(-log(prob)))
+                            : to_weight(Log64Weight(-log(prob * npath))));
+    }
+  }
+}
+
 }  // namespace fst
 
 #endif  // FST_RANDGEN_H_
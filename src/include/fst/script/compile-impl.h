@@ -31,6 +31,7 @@
 
 #include <fst/log.h>
 #include <fst/fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/symbol-table.h>
 #include <fst/util.h>
@@ -55,28 +56,32 @@ class FstCompiler {
   // If add_symbols_ is true, then the symbols will be dynamically added to the
   // symbol tables. This is only useful if you set the (i/o)keep flag to attach
   // the final symbol table, or use the accessors. (The input symbol tables are
-  // const and therefore not changed.)
+  // const and therefore not changed.) If num_threads is not one, the input is
+  // read into memory and its lines are parsed on num_threads threads (zero
+  // means one per hardware thread); the result is the same as for sequential
+  // compilation.
   FstCompiler(std::istream &istrm, std::string_view source,
               const SymbolTable *isyms, const SymbolTable *osyms,
               const SymbolTable *ssyms, bool accep, bool ikeep, bool okeep,
-              bool nkeep) {
+              bool nkeep, size_t num_threads = 1) {
     std::unique_ptr<SymbolTable> misyms(isyms ? isyms->Copy() : nullptr);
     std::unique_ptr<SymbolTable> mosyms(osyms ? osyms->Copy() : nullptr);
     std::unique_ptr<SymbolTable> mssyms(ssyms ? ssyms->Copy() : nullptr);
     Init(istrm, source, misyms.get(), mosyms.get(), mssyms.get(), accep, ikeep,
-         okeep, nkeep, false);
+         okeep, nkeep, false, num_threads);
   }
 
   FstCompiler(std::istream &istrm, std::string_view source, SymbolTable *isyms,
               SymbolTable *osyms, SymbolTable *ssyms, bool accep, bool ikeep,
-              bool okeep, bool nkeep, bool add_symbols) {
+              bool okeep, bool nkeep, bool add_symbols,
+              size_t num_threads = 1) {
     Init(istrm, source, isyms, osyms, ssyms, accep, ikeep, okeep, nkeep,
-         add_symbols);
+         add_symbols, num_threads);
   }
 
   void Init(std::istream &istrm, std::string_view source, SymbolTable *isyms,
             SymbolTable *osyms, SymbolTable *ssyms, bool accep, bool ikeep,
-            bool okeep, bool nkeep, bool add_symbols) {
+            bool okeep, bool nkeep, bool add_symbols, size_t num_threads = 1) {
     nline_ = 0;
     source_ = std::string(source);
     isyms_ = isyms;
@@ -85,6 +90,36 @@ class FstCompiler {
     nstates_ = 0;
     keep_state_numbering_ = nkeep;
     add_symbols_ = add_symbols;
+    // Adding symbols mutates the symbol tables, so it is done sequentially.
+    if (num_threads != 1 && !add_symbols) {
+      ParallelCompile(istrm, accep, num_threads);
+    } else {
+      Compile(istrm, accep);
+    }
+    if (ikeep) fst_.SetInputSymbols(isyms);
+    if (okeep) fst_.SetOutputSymbols(osyms);
+  }
+
+  const VectorFst<Arc> &Fst() const { return fst_; }
+
+ private:
+  // Maximum line length in text file.
+  static constexpr int kLineLen = 8096;
+
+  // Size of the blocks in which the parallel compiler reads its input.
+  static constexpr size_t kChunkSize = 1 << 20;
+
+  // A parsed line of the text format, as used by the parallel compiler.
+  struct Line {
+    StateId source;  // State ID as written, remapped before building.
+    StateId dest;    // Ditto, for arcs.
+    Label ilabel;
+    Label olabel;
+    Weight weight;   // Final weight if not an arc.
+    bool arc;
+  };
+
+  void Compile(std::istream &istrm, bool accep) {
     bool start_state_populated = false;
     char line[kLineLen];
     const std::string separator =
@@ -144,15 +179,170 @@ class FstCompiler {
       }
       while (d >= fst_.NumStates()) fst_.AddState();
     }
-    if (ikeep) fst_.SetInputSymbols(isyms);
-    if (okeep) fst_.SetOutputSymbols(osyms);
   }
 
-  const VectorFst<Arc> &Fst() const { return fst_; }
+  // Reads the whole input, parses blocks of lines on separate threads and then
+  // applies the parsed lines to the FST in input order, with states and arcs
+  // reserved up front. Any input the sequential compiler would reject or
+  // truncate is handed to it, so that errors are reported identically.
+  void ParallelCompile(std::istream &istrm, bool accep, size_t num_threads) {
+    std::string text;
+    while (true) {
+      const auto size = text.size();
+      text.resize(size + kChunkSize);
+      istrm.read(&text[size], kChunkSize);
+      text.resize(size + istrm.gcount());
+      if (!istrm) break;
+    }
+    const std::string separator =
+        FST_FLAGS_fst_field_separator + "\n";
+    std::vector<std::vector<Line>> blocks(NumWorkerThreads(num_threads));
+    std::vector<char> ok(blocks.size(), true);
+    const auto nblocks = ParallelFor(
+        text.size(), num_threads, [&](size_t b, size_t begin, size_t end) {
+          // Parses the lines starting in [begin, end).
+          if (begin > 0 && text[begin - 1] != '\n') {
+            begin = text.find('\n', begin);
+            begin = begin == std::string::npos ? text.size() : begin + 1;
+          }
+          while (begin < end && ok[b]) {
+            auto pos = text.find('\n', begin);
+            if (pos == std::string::npos) pos = text.size();
+            ok[b] = ParseLine(std::string_view(text).substr(begin, pos - begin),
+                              separator, accep, &blocks[b]);
+            begin = pos + 1;
+          }
+        });
+    for (size_t b = 0; b < nblocks; ++b) {
+      if (!ok[b]) {
+        std::istringstream strm(text);
+        Compile(strm, accep);
+        return;
+      }
+    }
+    // Remaps state IDs in input order and counts the arcs of each state.
+    std::vector<size_t> narcs;
+    for (size_t b = 0; b < nblocks; ++b) {
+      for (auto &line : blocks[b]) {
+        line.source = MapStateId(line.source);
+        if (line.source >= static_cast<StateId>(narcs.size())) {
+          narcs.resize(line.source + 1, 0);
+        }
+        if (!line.arc) continue;
+        ++narcs[line.source];
+        line.dest = MapStateId(line.dest);
+        if (line.dest >= static_cast<StateId>(narcs.size())) {
+          narcs.resize(line.dest + 1, 0);
+        }
+      }
+    }
+    fst_.ReserveStates(narcs.size());
+    const auto add_states = [&](StateId s) {
+      while (s >= fst_.NumStates()) {
+        const auto t = fst_.AddState();
+        fst_.ReserveArcs(t, narcs[t]);
+      }
+    };
+    bool start_state_populated = false;
+    for (size_t b = 0; b < nblocks; ++b) {
+      for (const auto &line : blocks[b]) {
+        add_states(line.source);
+        if (!start_state_populated) {
+          fst_.SetStart(line.source);
+          start_state_populated = true;
+        }
+        if (line.arc) {
+          fst_.AddArc(line.source,
+                      Arc(line.ilabel, line.olabel, line.weight, line.dest));
+          add_states(line.dest);
+        } else {
+          fst_.SetFinal(line.source, line.weight);
+        }
+      }
+      blocks[b] = std::vector<Line>();
+    }
+  }
 
- private:
-  // Maximum line length in text file.
-  static constexpr int kLineLen = 8096;
+  // Parses a line of the text format without side effects, appending it to
+  // lines unless it is empty. Returns false if the sequential compiler would
+  // reject or truncate the line.
+  bool ParseLine(std::string_view text, const std::string &separator,
+                 bool accep, std::vector<Line> *lines) const {
+    if (text.size() >= kLineLen - 1) return false;
+    const std::vector<std::string_view> col =
+        StrSplit(text, ByAnyChar(separator), SkipEmpty());
+    if (col.empty() || col[0].empty()) return true;
+    if (col.size() > 5 || (col.size() > 4 && accep) ||
+        (col.size() == 3 && !accep)) {
+      return false;
+    }
+    Line line;
+    line.arc = col.size() > 2;
+    if (!ParseId(col[0], ssyms_, &line.source) ||
+        (keep_state_numbering_ && line.source < 0)) {
+      return false;
+    }
+    switch (col.size()) {
+      case 1:
+        line.weight = Weight::One();
+        break;
+      case 2:
+        if (!ParseWeight(col[1], &line.weight)) return false;
+        break;
+      case 3:
+        if (!ParseId(col[1], ssyms_, &line.dest) ||
+            !ParseId(col[2], isyms_, &line.ilabel)) {
+          return false;
+        }
+        line.olabel = line.ilabel;
+        line.weight = Weight::One();
+        break;
+      case 4:
+        if (!ParseId(col[1], ssyms_, &line.dest) ||
+            !ParseId(col[2], isyms_, &line.ilabel)) {
+          return false;
+        }
+        if (accep) {
+          line.olabel = line.ilabel;
+          if (!ParseWeight(col[3], &line.weight)) return false;
+        } else {
+          if (!ParseId(col[3], osyms_, &line.olabel)) return false;
+          line.weight = Weight::One();
+        }
+        break;
+      case 5:
+        if (!ParseId(col[1], ssyms_, &line.dest) ||
+            !ParseId(col[2], isyms_, &line.ilabel) ||
+            !ParseId(col[3], osyms_, &line.olabel) ||
+            !ParseWeight(col[4], &line.weight)) {
+          return false;
+        }
+    }
+    if (line.arc && keep_state_numbering_ && line.dest < 0) return false;
+    lines->push_back(std::move(line));
+    return true;
+  }
+
+  // Thread-safe counterparts of StrToId and StrToWeight, which return false
+  // instead of reporting errors.
+  template <class Id>
+  static bool ParseId(std::string_view s, const SymbolTable *syms, Id *id) {
+    if (syms) {
+      const auto n = syms->Find(s);
+      *id = n;
+      return n != kNoSymbol;
+    }
+    const auto maybe_n = ParseInt64(s);
+    if (!maybe_n.has_value()) return false;
+    *id = *maybe_n;
+    return true;
+  }
+
+  static bool ParseWeight(std::string_view s, Weight *w) {
+    std::istringstream strm(std::string{s});
+    strm >> *w;
+    return static_cast<bool>(strm);
+  }
 
   StateId StrToId(std::string_view s, SymbolTable *syms,
                   std::string_view name) const {
@@ -184,9 +374,12 @@ class FstCompiler {
   }
 
   StateId StrToStateId(std::string_view s) {
-    StateId n = StrToId(s, ssyms_, "state ID");
+    return MapStateId(StrToId(s, ssyms_, "state ID"));
+  }
+
+  // Remaps state IDs to make dense set, unless keeping the state numbering.
+  StateId MapStateId(StateId n) {
     if (keep_state_numbering_) return n;
-    // Remaps state IDs to make dense set.
     const auto it = states_.find(n);
     if (it == states_.end()) {
       states_[n] = nstates_;
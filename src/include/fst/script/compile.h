@@ -18,6 +18,7 @@
 #ifndef FST_SCRIPT_COMPILE_H_
 #define FST_SCRIPT_COMPILE_H_
 
+#include <cstddef>
 #include <istream>
 #include <memory>
 #include <string>
@@ -55,6 +56,7 @@ struct FstCompileInnerArgs {
   const bool ikeep;
   const bool okeep;
   const bool nkeep;
+  const size_t num_threads;
 };
 
 using FstCompileArgs =
@@ -68,7 +70,7 @@ void CompileInternal(FstCompileArgs *args) {
   FstCompiler<Arc> fstcompiler(
       args->args.istrm, args->args.source, args->args.isyms, args->args.osyms,
       args->args.ssyms, args->args.accep, args->args.ikeep, args->args.okeep,
-      args->args.nkeep);
+      args->args.nkeep, args->args.num_threads);
   std::unique_ptr<Fst<Arc>> fst;
   if (args->args.fst_type != "vector") {
     std::unique_ptr<Fst<Arc>> tmp_fst(
@@ -88,13 +90,13 @@ void Compile(std::istream &istrm, const std::string &source,
              const std::string &dest, const std::string &fst_type,
              const std::string &arc_type, const SymbolTable *isyms,
              const SymbolTable *osyms, const SymbolTable *ssyms, bool accep,
-             bool ikeep, bool okeep, bool nkeep);
+             bool ikeep, bool okeep, bool nkeep, size_t num_threads = 1);
 
 std::unique_ptr<FstClass> CompileInternal(
     std::istream &istrm, const std::string &source, const std::string &fst_type,
     const std::string &arc_type, const SymbolTable *isyms,
     const SymbolTable *osyms, const SymbolTable *ssyms, bool accep, bool ikeep,
-    bool okeep, bool nkeep);
+    bool okeep, bool nkeep, size_t num_threads = 1);
 
 }  // namespace script
 }  // namespace fst
@@ -21,23 +21,96 @@
 #ifndef FST_SCRIPT_PRINT_IMPL_H_
 #define FST_SCRIPT_PRINT_IMPL_H_
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <ios>
+#include <limits>
+#include <locale>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include <fst/log.h>
 #include <fst/fst.h>
+#include <fst/float-weight.h>
 #include <fst/fstlib.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/symbol-table.h>
 #include <fst/util.h>
 #include <string_view>
 
 namespace fst {
+namespace internal {
+
+// Appends the decimal representation of an integer to a buffer.
+template <class T>
+void AppendInteger(T n, std::string *buf) {
+  char digits[std::numeric_limits<T>::digits10 + 3];
+  const auto *end = std::to_chars(digits, digits + sizeof(digits), n).ptr;
+  buf->append(digits, end - digits);
+}
+
+template <class T>
+std::true_type IsFloatWeightTest(const FloatWeightTpl<T> *);
+
+std::false_type IsFloatWeightTest(...);
+
+// Formats weights into a buffer as operator<< would on a stream with the given
+// format state. Floating-point weights are formatted with std::to_chars when
+// the stream uses the default notation and the classic locale; other weights
+// go through a reusable string stream.
+template <class Weight>
+class WeightFormatter {
+ public:
+  explicit WeightFormatter(const std::ios &fmt)
+      : precision_(fmt.precision()),
+        to_chars_(!(fmt.flags() & (std::ios::floatfield | std::ios::showpoint |
+                                   std::ios::showpos | std::ios::uppercase)) &&
+                  fmt.width() == 0 && fmt.getloc() == std::locale::classic()) {
+    strm_.copyfmt(fmt);
+  }
+
+  void Append(const Weight &weight, std::string *buf) {
+    if constexpr (decltype(IsFloatWeightTest(&weight))::value) {
+      if (to_chars_ && !std::isinf(weight.Value()) &&
+          !std::isnan(weight.Value())) {
+        char chars[64];
+        const auto *end =
+            std::to_chars(chars, chars + sizeof(chars),
+                          static_cast<double>(weight.Value()),
+                          std::chars_format::general, precision_)
+                .ptr;
+        buf->append(chars, end - chars);
+        return;
+      }
+    }
+    strm_.str(std::string());
+    strm_ << weight;
+    buf->append(strm_.str());
+  }
+
+ private:
+  const int precision_;
+  const bool to_chars_;  // Can floating-point values use std::to_chars?
+  std::ostringstream strm_;
+};
+
+}  // namespace internal
 
 // Print a binary FST in textual format (helper class for fstprint.cc).
 // WARNING: Stand-alone use of this class not recommended, most code should
 // read/write using the binary format which is much more efficient.
+//
+// Lines are formatted into a buffer which is written to the stream in large
+// blocks. If num_threads is not one and the FST is expanded, blocks of states
+// are formatted on num_threads threads (zero means one per hardware thread)
+// and written in order, so the output does not depend on the thread count.
 template <class Arc>
 class FstPrinter {
  public:
@@ -49,7 +122,8 @@ class FstPrinter {
                       const SymbolTable *osyms, const SymbolTable *ssyms,
                       bool accept, bool show_weight_one,
                       std::string_view field_separator,
-                      std::string_view missing_symbol = "")
+                      std::string_view missing_symbol = "",
+                      size_t num_threads = 1)
       : fst_(fst),
         isyms_(isyms),
         osyms_(osyms),
@@ -57,23 +131,76 @@ class FstPrinter {
         accept_(accept && (fst.Properties(kAcceptor, true) == kAcceptor)),
         show_weight_one_(show_weight_one),
         sep_(field_separator),
-        missing_symbol_(missing_symbol) {}
+        missing_symbol_(missing_symbol),
+        num_threads_(num_threads) {}
 
   // Prints FST to an output stream.
   void Print(std::ostream &ostrm, std::string_view dest) {
     dest_ = std::string(dest);
     const auto start = fst_.Start();
     if (start == kNoStateId) return;
+    if (num_threads_ != 1 && fst_.Properties(kExpanded, false)) {
+      ParallelPrint(ostrm, start);
+      return;
+    }
+    internal::WeightFormatter<Weight> formatter(ostrm);
+    std::string buf;
     // Initial state first.
-    PrintState(ostrm, start);
+    PrintState(fst_, start, &formatter, &buf);
     for (StateIterator<Fst<Arc>> siter(fst_); !siter.Done(); siter.Next()) {
       const auto s = siter.Value();
-      if (s != start) PrintState(ostrm, s);
+      if (s != start) PrintState(fst_, s, &formatter, &buf);
+      if (buf.size() >= kBufferSize) {
+        ostrm.write(buf.data(), buf.size());
+        buf.clear();
+      }
     }
+    ostrm.write(buf.data(), buf.size());
   }
 
  private:
-  std::string FormatId(StateId id, const SymbolTable *syms) const {
+  // Size at which formatted output is written out.
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  // Number of states formatted per thread and round by ParallelPrint.
+  static constexpr StateId kStatesPerBlock = 1 << 12;
+
+  // Formats rounds of state blocks in parallel, writing each round in order.
+  void ParallelPrint(std::ostream &ostrm, StateId start) {
+    const auto nstates = CountStates(fst_);
+    const auto nthreads = NumWorkerThreads(num_threads_);
+    std::vector<std::unique_ptr<const Fst<Arc>>> fsts(nthreads);
+    std::vector<std::unique_ptr<internal::WeightFormatter<Weight>>> formatters(
+        nthreads);
+    for (size_t t = 0; t < nthreads; ++t) {
+      fsts[t].reset(fst_.Copy(true));
+      formatters[t] =
+          std::make_unique<internal::WeightFormatter<Weight>>(ostrm);
+    }
+    std::vector<std::string> bufs(nthreads);
+    // Initial state first.
+    PrintState(fst_, start, formatters[0].get(), &bufs[0]);
+    ostrm.write(bufs[0].data(), bufs[0].size());
+    bufs[0].clear();
+    const StateId round = kStatesPerBlock * nthreads;
+    for (StateId begin = 0; begin < nstates; begin += round) {
+      const auto n = std::min(round, nstates - begin);
+      const auto nblocks =
+          ParallelFor(n, nthreads, [&](size_t b, size_t first, size_t last) {
+            for (StateId s = begin + first; s < begin + last; ++s) {
+              if (s != start) {
+                PrintState(*fsts[b], s, formatters[b].get(), &bufs[b]);
+              }
+            }
+          });
+      for (size_t b = 0; b < nblocks; ++b) {
+        ostrm.write(bufs[b].data(), bufs[b].size());
+        bufs[b].clear();
+      }
+    }
+  }
+
+  void AppendId(StateId id, const SymbolTable *syms, std::string *buf) const {
     if (syms) {
       std::string symbol = syms->Find(id);
       if (symbol.empty()) {
@@ -82,45 +209,60 @@ class FstPrinter {
                      << " is not mapped to any textual symbol"
                      << ", symbol table = " << syms->Name()
                      << ", destination = " << dest_;
-          symbol = "?";
+          buf->push_back('?');
         } else {
-          symbol = missing_symbol_;
+          buf->append(missing_symbol_);
         }
+      } else {
+        buf->append(symbol);
       }
-      return symbol;
     } else {
-      return std::to_string(id);
+      internal::AppendInteger(id, buf);
     }
   }
 
-  std::string FormatStateId(StateId s) const { return FormatId(s, ssyms_); }
+  void AppendStateId(StateId s, std::string *buf) const {
+    AppendId(s, ssyms_, buf);
+  }
 
-  std::string FormatILabel(Label l) const { return FormatId(l, isyms_); }
+  void AppendILabel(Label l, std::string *buf) const {
+    AppendId(l, isyms_, buf);
+  }
 
-  std::string FormatOLabel(Label l) const { return FormatId(l, osyms_); }
+  void AppendOLabel(Label l, std::string *buf) const {
+    AppendId(l, osyms_, buf);
+  }
 
-  void PrintState(std::ostream &ostrm, StateId s) const {
+  void PrintState(const Fst<Arc> &fst, StateId s,
+                  internal::WeightFormatter<Weight> *formatter,
+                  std::string *buf) const {
     bool output = false;
-    for (ArcIterator<Fst<Arc>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
       const auto &arc = aiter.Value();
-      ostrm << FormatStateId(s) << sep_ << FormatStateId(arc.nextstate)
-              << sep_ << FormatILabel(arc.ilabel);
+      AppendStateId(s, buf);
+      buf->append(sep_);
+      AppendStateId(arc.nextstate, buf);
+      buf->append(sep_);
+      AppendILabel(arc.ilabel, buf);
       if (!accept_) {
-        ostrm << sep_ << FormatOLabel(arc.olabel);
+        buf->append(sep_);
+        AppendOLabel(arc.olabel, buf);
       }
       if (show_weight_one_ || arc.weight != Weight::One()) {
-        ostrm << sep_ << arc.weight;
+        buf->append(sep_);
+        formatter->Append(arc.weight, buf);
       }
-      ostrm << "\n";
+      buf->push_back('\n');
       output = true;
     }
-    const auto weight = fst_.Final(s);
+    const auto weight = fst.Final(s);
     if (weight != Weight::Zero() || !output) {
-      ostrm << FormatStateId(s);
+      AppendStateId(s, buf);
       if (show_weight_one_ || weight != Weight::One()) {
-        ostrm << sep_ << weight;
+        buf->append(sep_);
+        formatter->Append(weight, buf);
       }
-      ostrm << "\n";
+      buf->push_back('\n');
     }
   }
 
@@ -134,6 +276,7 @@ class FstPrinter {
   std::string sep_;             // Separator character between fields.
   std::string missing_symbol_;  // Symbol to print when lookup fails (default
                                 // "" means raise error).
+  size_t num_threads_;          // Number of formatting threads.
 
   FstPrinter(const FstPrinter &) = delete;
   FstPrinter &operator=(const FstPrinter &) = delete;
@@ -18,6 +18,7 @@
 #ifndef FST_SCRIPT_PRINT_H_
 #define FST_SCRIPT_PRINT_H_
 
+#include <cstddef>
 #include <ostream>
 #include <string>
 
@@ -47,6 +48,7 @@ struct FstPrintArgs {
   const std::string &dest;
   const std::string &sep;
   const std::string &missing_symbol;
+  const size_t num_threads;
 };
 
 template <class Arc>
@@ -54,7 +56,7 @@ void Print(FstPrintArgs *args) {
   const Fst<Arc> &fst = *args->fst.GetFst<Arc>();
   FstPrinter<Arc> fstprinter(fst, args->isyms, args->osyms, args->ssyms,
                              args->accept, args->show_weight_one, args->sep,
-                             args->missing_symbol);
+                             args->missing_symbol, args->num_threads);
   fstprinter.Print(args->ostrm, args->dest);
 }
 
@@ -62,7 +64,8 @@ void Print(const FstClass &fst, std::ostream &ostrm, const std::string &dest,
            const SymbolTable *isyms = nullptr,
            const SymbolTable *osyms = nullptr,
            const SymbolTable *ssyms = nullptr, bool accept = true,
-           bool show_weight_one = true, const std::string &missing_sym = "");
+           bool show_weight_one = true, const std::string &missing_sym = "",
+           size_t num_threads = 1);
 
 // TODO(kbg,2019-09-01): Deprecated.
 void PrintFst(const FstClass &fst, std::ostream &ostrm, const std::string &dest,
@@ -69,6 +69,13 @@ void RandEquivalent(FstRandEquivalentArgs *args) {
       args->retval = RandEquivalent(fst1, fst2, npath, ropts, delta, seed);
       return;
     }
+    case RandArcSelection::ALIAS: {
+      const AliasArcSelector<Arc> selector(seed);
+      const RandGenOptions<AliasArcSelector<Arc>> ropts(selector,
+                                                        opts.max_length);
+      args->retval = RandEquivalent(fst1, fst2, npath, ropts, delta, seed);
+      return;
+    }
   }
 }
 
@@ -66,6 +66,14 @@ void RandGen(FstRandGenArgs *args) {
       RandGen(ifst, ofst, ropts);
       return;
     }
+    case RandArcSelection::ALIAS: {
+      const AliasArcSelector<Arc> selector(seed);
+      const RandGenOptions<AliasArcSelector<Arc>> ropts(
+          selector, opts.max_length, opts.npath, opts.weighted,
+          opts.remove_total_weight);
+      RandGen(ifst, ofst, ropts);
+      return;
+    }
   }
 }
 
@@ -112,7 +112,12 @@
 namespace fst {
 namespace script {
 
-enum class RandArcSelection : uint8_t { UNIFORM, LOG_PROB, FAST_LOG_PROB };
+enum class RandArcSelection : uint8_t {
+  UNIFORM,
+  LOG_PROB,
+  FAST_LOG_PROB,
+  ALIAS
+};
 
 // A generic register for operations with various kinds of signatures.
 // Needed since every function signature requires a new registration class.
@@ -298,14 +298,19 @@ void ShortestDistance(
 // Mohri, M. 2002. Semiring framework and algorithms for
 // shortest-distance problems, Journal of Automata, Languages and
 // Combinatorics 7(3): 321-350, 2002.
+//
+// If num_threads is not one, the SCC decomposition that sets up the queue
+// runs on that many threads (zero means one per hardware thread); see
+// ParallelScc.
 template <class Arc>
 void ShortestDistance(const Fst<Arc> &fst,
                       std::vector<typename Arc::Weight> *distance,
-                      bool reverse = false, float delta = kShortestDelta) {
+                      bool reverse = false, float delta = kShortestDelta,
+                      size_t num_threads = 1) {
   using StateId = typename Arc::StateId;
   if (!reverse) {
     AnyArcFilter<Arc> arc_filter;
-    AutoQueue<StateId> state_queue(fst, distance, arc_filter);
+    AutoQueue<StateId> state_queue(fst, distance, arc_filter, num_threads);
     const ShortestDistanceOptions<Arc, AutoQueue<StateId>, AnyArcFilter<Arc>>
         opts(&state_queue, arc_filter, kNoStateId, delta);
     ShortestDistance(fst, distance, opts);
@@ -316,7 +321,8 @@ void ShortestDistance(const Fst<Arc> &fst,
     VectorFst<ReverseArc> rfst;
     Reverse(fst, &rfst);
     std::vector<ReverseWeight> rdistance;
-    AutoQueue<StateId> state_queue(rfst, &rdistance, rarc_filter);
+    AutoQueue<StateId> state_queue(rfst, &rdistance, rarc_filter,
+                                   num_threads);
     const ShortestDistanceOptions<ReverseArc, AutoQueue<StateId>,
                                   AnyArcFilter<ReverseArc>>
         ropts(&state_queue, rarc_filter, kNoStateId, delta);
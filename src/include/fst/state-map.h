@@ -29,6 +29,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -41,7 +42,9 @@
 #include <fst/fst.h>
 #include <fst/impl-to-fst.h>
 #include <fst/mutable-fst.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
+#include <fst/vector-fst.h>
 
 namespace fst {
 
@@ -129,6 +132,57 @@ void StateMap(MutableFst<A> *fst, C mapper) {
   StateMap(fst, &mapper);
 }
 
+// Maps the states of a VectorFst in place using a mapper function object C,
+// passed by pointer, partitioning the states across num_threads threads (zero
+// means one per hardware thread). Each thread maps its states with its own
+// copy of the mapper. This requires a thread-safe mapper (see
+// IsThreadSafeMapper); o.w., this is the sequential StateMap.
+template <class A, class S, class C>
+void ParallelStateMap(VectorFst<A, S> *fst, C *mapper,
+                      size_t num_threads = 0) {
+  if constexpr (!IsThreadSafeMapper<C>::value) {
+    StateMap(fst, mapper);
+    return;
+  } else {
+    if (NumWorkerThreads(num_threads) == 1) {
+      StateMap(fst, mapper);
+      return;
+    }
+    if (mapper->InputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      fst->SetInputSymbols(nullptr);
+    }
+    if (mapper->OutputSymbolsAction() == MAP_CLEAR_SYMBOLS) {
+      fst->SetOutputSymbols(nullptr);
+    }
+    if (fst->Start() == kNoStateId) return;
+    const auto props = fst->Properties(kFstProperties, false);
+    // Also unshares the implementation before it is mutated on several
+    // threads. Concurrent property updates below may be lost; all properties
+    // are set once the threads are done.
+    fst->SetStart(mapper->Start());
+    ParallelFor(fst->NumStates(), num_threads,
+                [fst, mapper](size_t, size_t begin, size_t end) {
+                  C thread_mapper(*mapper);
+                  for (auto state = begin; state < end; ++state) {
+                    thread_mapper.SetState(state);
+                    fst->DeleteArcs(state);
+                    for (; !thread_mapper.Done(); thread_mapper.Next()) {
+                      fst->AddArc(state, thread_mapper.Value());
+                    }
+                    fst->SetFinal(state, thread_mapper.Final(state));
+                  }
+                });
+    fst->SetProperties(mapper->Properties(props), kFstProperties);
+  }
+}
+
+// Maps the states of a VectorFst in place using a mapper function object C,
+// passed by value, on num_threads threads.
+template <class A, class S, class C>
+void ParallelStateMap(VectorFst<A, S> *fst, C mapper, size_t num_threads = 0) {
+  ParallelStateMap(fst, &mapper, num_threads);
+}
+
 // Maps an arc type A to an arc type B using mapper functor C, passed by
 // pointer. This version writes to an output FST.
 template <class A, class B, class C>
@@ -635,6 +689,15 @@ using StdArcSumMapper = ArcSumMapper<StdArc>;
 
 using StdArcUniqueMapper = ArcUniqueMapper<StdArc>;
 
+// Copies of these mappers share only the FST, from which each reads the arcs
+// of the states it is set to.
+
+template <class Arc>
+struct IsThreadSafeMapper<ArcSumMapper<Arc>> : std::true_type {};
+
+template <class Arc>
+struct IsThreadSafeMapper<ArcUniqueMapper<Arc>> : std::true_type {};
+
 }  // namespace fst
 
 #endif  // FST_STATE_MAP_H_
@@ -0,0 +1,327 @@
+// Copyright 2005-2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Incremental compilation of a sorted list of strings into a minimal
+// deterministic acyclic FST.
+
+#ifndef FST_STRING_SET_H_
+#define FST_STRING_SET_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/arc.h>
+#include <fst/fst.h>
+#include <fst/mutable-fst.h>
+#include <fst/properties.h>
+#include <fst/string.h>
+#include <fst/symbol-table.h>
+#include <fst/vector-fst.h>
+#include <fst/weight.h>
+
+namespace fst {
+
+// Compiles a set of strings, added in lexicographic order of their labels,
+// into the minimal deterministic acyclic acceptor of the set without
+// building the trie of the strings first; see:
+//
+// Daciuk, J., Mihov, S., Watson, B. W., and Watson, R. E. 2000. Incremental
+// construction of minimal acyclic finite-state automata. Computational
+// Linguistics 26(1): 3-16.
+//
+// Only the states along the path of the last string added are kept
+// unfinished. When a string diverges from the previous one, the states that
+// it leaves behind are final: each is replaced by an equivalent state
+// already output, if any, or output and registered otherwise. The output
+// thus grows with the minimal FST rather than with the input.
+//
+// String weights are pushed towards the initial state as the states are
+// finished, so that states with the same weighted suffixes are merged;
+// weights are compared after quantization by delta. The weights must be
+// left divisible. A string added more than once gets the sum of its weights.
+//
+// With BYTE and UTF8 tokens, label order is the byte order of the strings
+// (as given by, e.g., LC_ALL=C sort); with SYMBOL tokens, it is the order of
+// the symbol keys.
+//
+// Sample usage:
+//
+//   StringSetCompiler<StdArc> compiler;
+//   for (const auto &str : sorted_strings) compiler.Add(str);
+//   VectorFst<StdArc> fst;
+//   compiler.Finish(&fst);
+template <class Arc>
+class StringSetCompiler {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  explicit StringSetCompiler(TokenType token_type = TokenType::BYTE,
+                             const SymbolTable *syms = nullptr,
+                             Label unknown_label = kNoLabel,
+                             float delta = kDelta)
+      : token_type_(token_type),
+        syms_(syms),
+        unknown_label_(unknown_label),
+        delta_(delta),
+        register_(0, StateHash(*this), StateEqual(*this)) {}
+
+  // Adds a string, which must not precede the previous one in label order.
+  // With SYMBOL token type, sep specifies the char separators between
+  // symbols, in addition to '\n'. Returns true on success.
+  bool Add(std::string_view str, Weight weight = Weight::One(),
+           std::string_view sep = FST_FLAGS_fst_field_separator) {
+    std::vector<Label> labels;
+    if (!internal::ConvertStringToLabels(str, token_type_, syms_,
+                                         unknown_label_, &labels, sep)) {
+      return false;
+    }
+    return Add(labels, std::move(weight));
+  }
+
+  // Adds a string given as labels, which must not precede the previous one.
+  // Returns true on success.
+  bool Add(const std::vector<Label> &labels, Weight weight = Weight::One());
+
+  // Outputs the minimal FST of the strings added since construction or the
+  // last call, and resets the compiler. The initial state is numbered last.
+  // Since a VectorFst output is moved rather than copied, finishing into one
+  // and constructing, e.g., a ConstFst from it avoids a copy.
+  void Finish(MutableFst<Arc> *fst) {
+    FinishStates();
+    *fst = fst_;
+    Reset();
+  }
+
+  void Finish(VectorFst<Arc> *fst) {
+    FinishStates();
+    *fst = std::move(fst_);
+    Reset();
+  }
+
+  // Number of strings added since construction or the last Finish().
+  size_t NumStrings() const { return nstrings_; }
+
+ private:
+  // A state on the path of the last string added; the destination of its
+  // last arc is the next state on the path, unfinished.
+  struct PathState {
+    Weight final = Weight::Zero();
+    std::vector<Arc> arcs;
+  };
+
+  // Finishes the states on the path deeper than 'depth'.
+  void FinishPath(size_t depth);
+
+  // Finishes all states, setting the initial state.
+  void FinishStates();
+
+  void Reset() {
+    fst_ = VectorFst<Arc>();
+    register_.clear();
+    path_.clear();
+    labels_.clear();
+    nstrings_ = 0;
+  }
+
+  // Finishes 'state', returning the equivalent output state; pushes its
+  // weights into the arc entering it unless it is the initial state.
+  StateId FinishState(PathState *state, Weight *weight);
+
+  // Hashes and compares output states, where kNoStateId stands for the
+  // state being finished.
+  class StateHash {
+   public:
+    explicit StateHash(const StringSetCompiler &compiler)
+        : compiler_(compiler) {}
+
+    size_t operator()(StateId s) const;
+
+   private:
+    const StringSetCompiler &compiler_;
+  };
+
+  class StateEqual {
+   public:
+    explicit StateEqual(const StringSetCompiler &compiler)
+        : compiler_(compiler) {}
+
+    bool operator()(StateId s1, StateId s2) const;
+
+   private:
+    const StringSetCompiler &compiler_;
+  };
+
+  // Returns the final weight and arcs of output state s, or of the state
+  // being finished if s is kNoStateId.
+  Weight Final(StateId s) const {
+    return s == kNoStateId ? current_->final : fst_.Final(s);
+  }
+
+  std::pair<const Arc *, size_t> Arcs(StateId s) const {
+    if (s == kNoStateId) return {current_->arcs.data(), current_->arcs.size()};
+    ArcIteratorData<Arc> data;
+    fst_.InitArcIterator(s, &data);
+    return {data.arcs, data.narcs};
+  }
+
+  Weight Quantize(const Weight &weight) const {
+    return weight.Quantize(delta_);
+  }
+
+  const TokenType token_type_;
+  const SymbolTable *syms_;    // Symbol table (used when token type is symbol).
+  const Label unknown_label_;  // Label for token missing from symbol table.
+  const float delta_;
+  VectorFst<Arc> fst_;           // Output states.
+  std::vector<PathState> path_;  // Unfinished states.
+  std::vector<Label> labels_;    // Last string added.
+  size_t nstrings_ = 0;
+  const PathState *current_ = nullptr;  // State being finished.
+  std::unordered_set<StateId, StateHash, StateEqual> register_;
+
+  StringSetCompiler(const StringSetCompiler &) = delete;
+  StringSetCompiler &operator=(const StringSetCompiler &) = delete;
+};
+
+template <class Arc>
+bool StringSetCompiler<Arc>::Add(const std::vector<Label> &labels,
+                                 Weight weight) {
+  if (weight == Weight::Zero() || !weight.Member()) {
+    LOG(ERROR) << "StringSetCompiler::Add: Bad string weight: " << weight;
+    return false;
+  }
+  if (nstrings_ == 0) {
+    path_.resize(1);
+  } else if (std::lexicographical_compare(labels.begin(), labels.end(),
+                                          labels_.begin(), labels_.end())) {
+    LOG(ERROR) << "StringSetCompiler::Add: String " << nstrings_ + 1
+               << " precedes the previous one in label order";
+    return false;
+  }
+  const auto prefix =
+      std::mismatch(labels.begin(), labels.end(), labels_.begin(),
+                    labels_.end())
+          .first -
+      labels.begin();
+  FinishPath(prefix);
+  for (auto i = prefix; i < labels.size(); ++i) {
+    path_.back().arcs.emplace_back(labels[i], labels[i], Weight::One(),
+                                   kNoStateId);
+    path_.emplace_back();
+  }
+  path_.back().final = Plus(path_.back().final, weight);
+  labels_ = labels;
+  ++nstrings_;
+  return true;
+}
+
+template <class Arc>
+void StringSetCompiler<Arc>::FinishPath(size_t depth) {
+  while (path_.size() > depth + 1) {
+    Weight weight;
+    const auto s = FinishState(&path_.back(), &weight);
+    path_.pop_back();
+    auto &arc = path_.back().arcs.back();
+    arc.weight = Times(arc.weight, weight);
+    arc.nextstate = s;
+  }
+}
+
+template <class Arc>
+typename Arc::StateId StringSetCompiler<Arc>::FinishState(PathState *state,
+                                                          Weight *weight) {
+  if (weight) {
+    auto total = state->final;
+    for (const auto &arc : state->arcs) total = Plus(total, arc.weight);
+    if (total != Weight::One()) {
+      state->final = Divide(state->final, total, DIVIDE_LEFT);
+      for (auto &arc : state->arcs) {
+        arc.weight = Divide(arc.weight, total, DIVIDE_LEFT);
+      }
+    }
+    *weight = std::move(total);
+  }
+  current_ = state;
+  if (const auto it = register_.find(kNoStateId); it != register_.end()) {
+    return *it;
+  }
+  const auto s = fst_.AddState();
+  fst_.SetFinal(s, state->final);
+  fst_.ReserveArcs(s, state->arcs.size());
+  for (const auto &arc : state->arcs) fst_.AddArc(s, arc);
+  // The initial state has no equivalent, and is not registered.
+  if (weight) register_.insert(s);
+  return s;
+}
+
+template <class Arc>
+void StringSetCompiler<Arc>::FinishStates() {
+  if (nstrings_ == 0) return;
+  FinishPath(0);
+  fst_.SetStart(FinishState(&path_.back(), nullptr));
+  fst_.SetProperties(kAcyclic | kInitialAcyclic | kAccessible | kCoAccessible |
+                         kIDeterministic | kODeterministic,
+                     kAcyclic | kInitialAcyclic | kAccessible | kCoAccessible |
+                         kIDeterministic | kODeterministic);
+}
+
+template <class Arc>
+size_t StringSetCompiler<Arc>::StateHash::operator()(StateId s) const {
+  size_t h = compiler_.Quantize(compiler_.Final(s)).Hash();
+  const auto [arcs, narcs] = compiler_.Arcs(s);
+  for (size_t i = 0; i < narcs; ++i) {
+    const auto &arc = arcs[i];
+    h = h * 7853 + arc.ilabel;
+    h = h * 7853 + arc.nextstate;
+    h = h * 7853 + compiler_.Quantize(arc.weight).Hash();
+  }
+  return h;
+}
+
+template <class Arc>
+bool StringSetCompiler<Arc>::StateEqual::operator()(StateId s1,
+                                                    StateId s2) const {
+  if (s1 == s2) return true;
+  const auto [arcs1, narcs1] = compiler_.Arcs(s1);
+  const auto [arcs2, narcs2] = compiler_.Arcs(s2);
+  if (narcs1 != narcs2 || compiler_.Quantize(compiler_.Final(s1)) !=
+                              compiler_.Quantize(compiler_.Final(s2))) {
+    return false;
+  }
+  for (size_t i = 0; i < narcs1; ++i) {
+    const auto &arc1 = arcs1[i];
+    const auto &arc2 = arcs2[i];
+    if (arc1.ilabel != arc2.ilabel || arc1.nextstate != arc2.nextstate ||
+        compiler_.Quantize(arc1.weight) != compiler_.Quantize(arc2.weight)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace fst
+
+#endif  // FST_STRING_SET_H_
@@ -22,11 +22,16 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <memory>
 #include <random>
+#include <sstream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -40,6 +45,7 @@
 #include <fst/compose-filter.h>
 #include <fst/compose.h>
 #include <fst/concat.h>
+#include <fst/const-fst.h>
 #include <fst/connect.h>
 #include <fst/determinize.h>
 #include <fst/dfs-visit.h>
@@ -57,7 +63,9 @@
 #include <fst/matcher.h>
 #include <fst/minimize.h>
 #include <fst/mutable-fst.h>
+#include <fst/nary-compose.h>
 #include <fst/pair-weight.h>
+#include <fst/parallel.h>
 #include <fst/project.h>
 #include <fst/properties.h>
 #include <fst/prune.h>
@@ -403,6 +411,29 @@ class WeightedTester {
       CHECK(Equiv(I1, I2));
     }
 
+    {
+      VLOG(1) << "Check parallel and sequential inversion are equal.";
+      VectorFst<Arc> I1(T);
+      VectorFst<Arc> I2(T);
+      ArcMap(&I1, InvertMapper<Arc>());
+      ParallelArcMap(&I2, InvertMapper<Arc>(), 4);
+      CHECK(Equal(I1, I2));
+    }
+
+    {
+      VLOG(1) << "Check delayed and non-caching projection are equal.";
+      ProjectFst<Arc> P1(T, ProjectType::OUTPUT);
+      ProjectViewFst<Arc> P2(T, ProjectType::OUTPUT);
+      CHECK(Equal(P1, P2));
+    }
+
+    {
+      VLOG(1) << "Check delayed and non-caching inversion are equal.";
+      InvertFst<Arc> I1(T);
+      InvertViewFst<Arc> I2(T);
+      CHECK(Equal(I1, I2));
+    }
+
     {
       VLOG(1) << "Check Pi_1(T) = Pi_2(T^-1) (destructive).";
       VectorFst<Arc> P1(T);
@@ -509,6 +540,68 @@ class WeightedTester {
       CHECK(Equiv(D, T));
     }
 
+    // ConstFst holds its arcs in raw memory, which requires trivially
+    // copyable arcs.
+    if constexpr (std::is_trivially_copyable_v<Arc>) {
+      {
+        VLOG(1) << "Check parallel and sequential ConstFst conversion are "
+                << "equal.";
+        const ConstFst<Arc> C1(T);
+        const ConstFst<Arc> C2(T, 3);
+        CHECK(Equal(C1, C2));
+        CHECK_EQ(C1.Properties(kFstProperties, false),
+                 C2.Properties(kFstProperties, false));
+      }
+
+      {
+        VLOG(1) << "Check streamed ConstFst equals ConstFst conversion.";
+        const std::string filename = FST_FLAGS_tmpdir + "/builder.fst";
+        const VectorFst<Arc> V(T);
+        for (const bool align : {false, true}) {
+          ConstFstBuilder<Arc> builder(filename, V.NumStates(),
+                                       V.InputSymbols(), V.OutputSymbols(),
+                                       align);
+          if (V.Start() != kNoStateId) builder.SetStart(V.Start());
+          for (StateId s = 0; s < V.NumStates(); ++s) {
+            CHECK_EQ(builder.AddState(V.Final(s)), s);
+            for (ArcIterator<VectorFst<Arc>> aiter(V, s); !aiter.Done();
+                 aiter.Next()) {
+              builder.AddArc(aiter.Value());
+            }
+          }
+          CHECK(builder.Finish());
+          std::unique_ptr<ConstFst<Arc>> C(ConstFst<Arc>::Read(filename));
+          CHECK(C);
+          CHECK(Equal(*C, ConstFst<Arc>(T)));
+        }
+      }
+
+      {
+        VLOG(1) << "Check ConstFstBuilder rejects too many states or arcs.";
+        const std::string filename = FST_FLAGS_tmpdir + "/builder.fst";
+        const bool error_fatal = FST_FLAGS_fst_error_fatal;
+        SetFlag(&FST_FLAGS_fst_error_fatal, false);
+        {
+          ConstFstBuilder<Arc, uint8_t> builder(filename, 1);
+          builder.SetStart(builder.AddState());
+          const Arc arc(1, 1, Weight::One(), 0);
+          for (int i = 0; i < 255; ++i) builder.AddArc(arc);
+          CHECK(!builder.Error());
+          builder.AddArc(arc);
+          CHECK(builder.Error());
+          CHECK(!builder.Finish());
+        }
+        {
+          ConstFstBuilder<Arc> builder(filename, 1);
+          builder.SetStart(builder.AddState());
+          CHECK_EQ(builder.AddState(), kNoStateId);
+          CHECK(builder.Error());
+          CHECK(!builder.Finish());
+        }
+        SetFlag(&FST_FLAGS_fst_error_fatal, error_fatal);
+      }
+    }
+
     {
       VLOG(1) << "Check gallic mappers (constructive).";
       ToGallicMapper<Arc> to_mapper;
@@ -553,6 +646,20 @@ class WeightedTester {
       CHECK(Equiv(C2, C4));
     }
 
+    {
+      VLOG(1) << "Check N-ary composition is equivalent to nested composition.";
+      VectorFst<Arc> I2(S2);
+      ArcSort(&I2, icomp);
+      ComposeFst<Arc> C1(S1, I2);
+      ComposeFst<Arc> C2(C1, S3);
+      NaryComposeFst<Arc> N1({&S1, &I2, &S3});
+      CHECK(Equiv(C2, N1));
+
+      VectorFst<Arc> N2;
+      Compose<Arc>({&S1, &I2, &S3}, &N2);
+      CHECK(Equiv(C2, N2));
+    }
+
     {
       VLOG(1) << "Check composition left distributes over union.";
       UnionFst<Arc> U1(S2, S3);
@@ -629,6 +736,31 @@ class WeightedTester {
       LookAheadCompose(S1, S2, &C2);
       CHECK(Equiv(C1, C2));
     }
+
+    {
+      VLOG(1) << "Check arena-backed caching leads to equal results.";
+      ResettableArena arena;
+      for (const bool gc : {false, true}) {
+        {
+          ComposeFst<Arc> C1(S1, S2);
+          ComposeFst<Arc> C2(S1, S2, CacheOptions(gc, 1024, &arena));
+          CHECK(Equal(C1, C2));
+        }
+        arena.Reset();
+      }
+    }
+
+    {
+      VLOG(1) << "Check composition with non-caching views leads to equal "
+              << "results.";
+      InvertFst<Arc> I1(S3);
+      InvertViewFst<Arc> I2(S3);
+      ProjectFst<Arc> P1(S3, ProjectType::INPUT);
+      ProjectViewFst<Arc> P2(S3, ProjectType::INPUT);
+      ComposeFst<Arc> C1(I1, P1);
+      ComposeFst<Arc> C2(I2, P2);
+      CHECK(Equal(C1, C2));
+    }
   }
 
   // Tests sorting operations
@@ -651,6 +783,112 @@ class WeightedTester {
       CHECK(Equiv(S1, S2));
     }
 
+    {
+      VLOG(1) << "Check parallel and sequential arcsort are equal.";
+      VectorFst<Arc> S1(T);
+      VectorFst<Arc> S2(T);
+      ArcSort(&S1, ocomp);
+      ParallelArcSort(&S2, ocomp, 4);
+      CHECK(Equal(S1, S2));
+    }
+
+    {
+      VLOG(1) << "Check radix and comparison arcsort are equal.";
+      // Gives one state enough arcs, including negative labels, to be radix
+      // sorted.
+      VectorFst<Arc> S1;
+      S1.AddState();
+      S1.SetStart(0);
+      std::uniform_int_distribution<Label> label_dist(-2, 1 << 20);
+      for (size_t i = 0; i < 4 * internal::kArcSortRadixThreshold; ++i) {
+        const auto label = label_dist(rand_);
+        S1.EmplaceArc(0, label % 3, label, Weight::One(), 0);
+      }
+      for (const bool ilabel_sort : {true, false}) {
+        VectorFst<Arc> S2(S1);
+        std::vector<Arc> arcs;
+        for (ArcIterator<VectorFst<Arc>> aiter(S1, 0); !aiter.Done();
+             aiter.Next()) {
+          arcs.push_back(aiter.Value());
+        }
+        if (ilabel_sort) {
+          ArcSort(&S2, icomp);
+          std::stable_sort(arcs.begin(), arcs.end(), icomp);
+        } else {
+          ArcSort(&S2, ocomp);
+          std::stable_sort(arcs.begin(), arcs.end(), ocomp);
+        }
+        ArcIterator<VectorFst<Arc>> aiter(S2, 0);
+        for (const auto &arc : arcs) {
+          CHECK(!aiter.Done());
+          CHECK_EQ(aiter.Value().ilabel, arc.ilabel);
+          CHECK_EQ(aiter.Value().olabel, arc.olabel);
+          aiter.Next();
+        }
+      }
+    }
+
+    {
+      VLOG(1) << "Check delayed arcsort and arc-sorted views are equal.";
+      ArcSortFst<Arc, OLabelCompare<Arc>> S1(T, ocomp);
+      const auto test_views = [&](const auto &F) {
+        using FST = std::decay_t<decltype(F)>;
+        ArcSortViewFst<FST, OLabelCompare<Arc>> S2(F, ocomp);
+        CHECK(Equal(S1, S2));
+        std::stringstream strm;
+        ArcSortPermutation<uint16_t> perm1(F, ocomp);
+        CHECK(perm1.Write(strm, FstWriteOptions()));
+        std::shared_ptr<const ArcSortPermutation<uint16_t>> perm2(
+            ArcSortPermutation<uint16_t>::Read(strm, FstReadOptions()));
+        CHECK(perm2);
+        ArcSortViewFst<FST, OLabelCompare<Arc>, uint16_t> S3(F, perm2);
+        CHECK(Equal(S1, S3));
+      };
+      test_views(VectorFst<Arc>(T));
+      // ConstFst holds its arcs in raw memory, which requires trivially
+      // copyable arcs.
+      if constexpr (std::is_trivially_copyable_v<Arc>) {
+        test_views(ConstFst<Arc>(T));
+      }
+    }
+
+    if (const VectorFst<Arc> F(T); F.NumStates() > 0) {
+      VLOG(1) << "Check arc-sorted views reject mismatched permutations.";
+      const bool error_fatal = FST_FLAGS_fst_error_fatal;
+      SetFlag(&FST_FLAGS_fst_error_fatal, false);
+      VectorFst<Arc> G(F);
+      G.AddArc(0, Arc(1, 1, Weight::One(), 0));
+      const auto perm =
+          std::make_shared<const ArcSortPermutation<>>(F, ocomp);
+      ArcSortViewFst<VectorFst<Arc>, OLabelCompare<Arc>> S(G, perm);
+      CHECK(S.Properties(kError, false));
+      CHECK(!S.GetPermutation());
+      size_t narcs = 0;
+      for (ArcIterator<decltype(S)> aiter(S, 0); !aiter.Done(); aiter.Next()) {
+        ++narcs;
+      }
+      CHECK_EQ(narcs, G.NumArcs(0));
+      SetFlag(&FST_FLAGS_fst_error_fatal, error_fatal);
+
+      // Corrupts the final offset, then the last arc position.
+      std::stringstream strm;
+      CHECK(ArcSortPermutation<uint16_t>(G, ocomp).Write(strm,
+                                                          FstWriteOptions()));
+      const std::string data = strm.str();
+      const size_t perm_size = CountArcs(G) * sizeof(uint16_t);
+      std::string bad_offset = data;
+      bad_offset[data.size() - perm_size - sizeof(uint64_t)] ^= 1;
+      std::istringstream bad_offset_strm(bad_offset);
+      CHECK(!ArcSortPermutation<uint16_t>::Read(bad_offset_strm,
+                                                FstReadOptions()));
+      std::string bad_position = data;
+      bad_position[data.size() - sizeof(uint16_t)] = '\xff';
+      bad_position[data.size() - 1] = '\xff';
+      std::istringstream bad_position_strm(bad_position);
+      CHECK(!ArcSortPermutation<uint16_t>::Read(bad_position_strm,
+                                                FstReadOptions()));
+    }
+
     {
       VLOG(1) << "Check ilabel sorting vs. olabel sorting with inversions.";
       VectorFst<Arc> S1(T);
@@ -696,6 +934,92 @@ class WeightedTester {
       CHECK(Equiv(T, C1));
     }
 
+    {
+      VLOG(1) << "Check parallel connection agrees with DFS connection.";
+      // Adds to T a fan of states wider than kMinParallelFrontier, half of
+      // them coaccessible, and as many inaccessible states, so that both
+      // parallel searches have wide frontiers.
+      VectorFst<Arc> W(T);
+      const StateId kFan = 2 * internal::kMinParallelFrontier;
+      const auto hub = W.AddState();
+      const auto sink = W.AddState();
+      if (W.Start() == kNoStateId) W.SetStart(hub);
+      W.AddArc(W.Start(), Arc(1, 1, Weight::One(), hub));
+      W.SetFinal(sink, Weight::One());
+      for (StateId i = 0; i < kFan; ++i) {
+        const auto s = W.AddState();
+        W.AddArc(hub, Arc(1, 1, Weight::One(), s));
+        if (i % 2 == 0) W.AddArc(s, Arc(2, 2, Weight::One(), sink));
+        W.AddArc(W.AddState(), Arc(3, 3, Weight::One(), sink));
+      }
+      for (const auto *fst : {static_cast<const Fst<Arc> *>(&T),
+                              static_cast<const Fst<Arc> *>(&W)}) {
+        VectorFst<Arc> C1(*fst);
+        Connect(&C1);
+        VectorFst<Arc> C2(*fst);
+        Connect(&C2, 4);
+        CHECK(Equal(C1, C2));
+      }
+    }
+
+    {
+      VLOG(1) << "Check parallel SCC decomposition agrees with DFS.";
+      // Adds to T a few large components, looping through a chain of small
+      // ones, so that every phase of the parallel search runs.
+      VectorFst<Arc> S(T);
+      const auto nstates = S.NumStates();
+      const StateId kCycles = 8;
+      const StateId kCycleStates = 4096;
+      for (StateId i = 0; i < kCycles * kCycleStates; ++i) S.AddState();
+      for (StateId k = 0; k < kCycles; ++k) {
+        const auto base = nstates + k * kCycleStates;
+        for (StateId i = 0; i < kCycleStates; ++i) {
+          S.AddArc(base + i, Arc(1, 1, Weight::One(),
+                                 base + (i + 1) % kCycleStates));
+          if (i % 2 == 0) {
+            S.AddArc(base + i, Arc(2, 2, Weight::One(),
+                                   base + (i + 7) % kCycleStates));
+          }
+        }
+        if (k + 1 < kCycles) {
+          S.AddArc(base, Arc(3, 3, Weight::One(), base + kCycleStates));
+        }
+      }
+      if (S.Start() != kNoStateId) {
+        S.AddArc(S.Start(), Arc(1, 1, Weight::One(), nstates));
+      }
+      S.SetFinal(S.NumStates() - 1, Weight::One());
+      for (const auto *fst : {static_cast<const Fst<Arc> *>(&T),
+                              static_cast<const Fst<Arc> *>(&S)}) {
+        std::vector<StateId> scc1;
+        std::vector<bool> access1;
+        std::vector<bool> coaccess1;
+        uint64_t props1 = 0;
+        SccVisitor<Arc> scc_visitor(&scc1, &access1, &coaccess1, &props1);
+        DfsVisit(*fst, &scc_visitor);
+        std::vector<StateId> scc2;
+        std::vector<bool> access2;
+        std::vector<bool> coaccess2;
+        uint64_t props2 = 0;
+        ParallelScc(*fst, &scc2, &access2, &coaccess2, &props2,
+                    AnyArcFilter<Arc>(), 4);
+        CHECK_EQ(props1, props2);
+        CHECK(access1 == access2);
+        CHECK(coaccess1 == coaccess2);
+        CHECK_EQ(scc1.size(), scc2.size());
+        // The partitions agree and the numbering is topological.
+        std::vector<StateId> scc_map(scc1.size(), kNoStateId);
+        for (StateId s = 0; s < scc1.size(); ++s) {
+          if (scc_map[scc1[s]] == kNoStateId) scc_map[scc1[s]] = scc2[s];
+          CHECK_EQ(scc_map[scc1[s]], scc2[s]);
+          for (ArcIterator<Fst<Arc>> aiter(*fst, s); !aiter.Done();
+               aiter.Next()) {
+            CHECK_LE(scc2[s], scc2[aiter.Value().nextstate]);
+          }
+        }
+      }
+    }
+
     if ((wprops & kSemiring) == kSemiring &&
         (tprops & kAcyclic || wprops & kIdempotent)) {
       VLOG(1) << "Check epsilon-removed FST is equivalent to its input.";
@@ -921,10 +1245,176 @@ class WeightedTester {
       SynchronizeFst<Arc> S(T);
       CHECK(Equiv(T, S));
     }
+
+    if ((wprops & (kSemiring | kLeftSemiring)) ==
+        (kSemiring | kLeftSemiring)) {
+      VLOG(1) << "Check compiled string set equiv union of its strings";
+      static constexpr int kNumStrings = 200;
+      std::vector<std::vector<Label>> strings(kNumStrings);
+      for (auto &labels : strings) {
+        labels.resize(std::uniform_int_distribution<>(0, 6)(rand_));
+        for (auto &label : labels) {
+          label = std::uniform_int_distribution<>(1, 3)(rand_);
+        }
+      }
+      std::sort(strings.begin(), strings.end());
+      StringSetCompiler<Arc> compiler;
+      VectorFst<Arc> U;
+      for (const auto &labels : strings) {
+        const auto weight = generate_();
+        CHECK(compiler.Add(labels, weight));
+        VectorFst<Arc> S;
+        const auto s = S.AddState();
+        S.SetStart(s);
+        for (const auto label : labels) {
+          S.AddState();
+          S.EmplaceArc(S.NumStates() - 2, label, label, S.NumStates() - 1);
+        }
+        S.SetFinal(S.NumStates() - 1, weight);
+        Union(&U, S);
+      }
+      // Strings out of order are rejected.
+      if (std::vector<Label>{1} < strings.back()) {
+        CHECK(!compiler.Add(std::vector<Label>{1}));
+      }
+      VectorFst<Arc> C;
+      compiler.Finish(&C);
+      CHECK(Equiv(U, C));
+
+      if ((wprops & kIdempotent) == kIdempotent) {
+        VLOG(1) << "Check compiled string set is minimal";
+        VectorFst<Arc> R(U);
+        RmEpsilon(&R);
+        VectorFst<Arc> M;
+        Determinize(R, &M);
+        Minimize(&M, static_cast<MutableFst<Arc> *>(nullptr), kDelta);
+        CHECK_EQ(M.NumStates(), C.NumStates());
+      }
+    }
   }
 
   // Tests search operations
   void TestSearch(const Fst<Arc> &T) {
+    {
+      VLOG(1) << "Check parallel random paths are independent of threads.";
+      const UniformArcSelector<Arc> selector(seed_);
+      const RandGenOptions<UniformArcSelector<Arc>> opts(
+          selector, kRandomPathLength, kNumRandomPaths);
+      VectorFst<Arc> P1;
+      VectorFst<Arc> P2;
+      ParallelRandGen(T, &P1, opts, 1);
+      ParallelRandGen(T, &P2, opts, 3);
+      CHECK(Verify(P1));
+      CHECK(Equal(P1, P2));
+    }
+
+    {
+      VLOG(1) << "Check parallel random paths follow the arc distribution.";
+      // Three equally likely single-arc paths.
+      VectorFst<Arc> F;
+      F.AddStates(2);
+      F.SetStart(0);
+      F.SetFinal(1, Weight::One());
+      for (Label label = 1; label <= 3; ++label) {
+        F.AddArc(0, Arc(label, label, Weight::One(), 1));
+      }
+      constexpr int kNumPaths = 3000;
+      const UniformArcSelector<Arc> selector(seed_);
+      const RandGenOptions<UniformArcSelector<Arc>> opts(
+          selector, kRandomPathLength, kNumPaths);
+      VectorFst<Arc> P;
+      ParallelRandGen(F, &P, opts, 2);
+      std::vector<int> counts(4, 0);
+      for (ArcIterator<VectorFst<Arc>> aiter(P, P.Start()); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        CHECK_EQ(arc.ilabel, arc.olabel);
+        CHECK_EQ(P.NumArcs(arc.nextstate), 0);
+        CHECK(P.Final(arc.nextstate) != Weight::Zero());
+        ++counts[arc.ilabel];
+      }
+      CHECK_EQ(counts[0], 0);
+      CHECK_EQ(counts[1] + counts[2] + counts[3], kNumPaths);
+      // Within five standard deviations of the expected count.
+      for (Label label = 1; label <= 3; ++label) {
+        CHECK_LT(std::abs(counts[label] - kNumPaths / 3), 130);
+      }
+    }
+
+    if constexpr (std::is_same_v<Weight, TropicalWeight> ||
+                  std::is_same_v<Weight, LogWeight>) {
+      VLOG(1) << "Check alias arc selection follows the arc distribution.";
+      // Arcs with probabilities .4, .3 and .2 and final probability .1.
+      const std::vector<double> probs = {.4, .3, .2, .1};
+      VectorFst<Arc> F;
+      F.AddStates(2);
+      F.SetStart(0);
+      for (Label label = 1; label <= 3; ++label) {
+        F.AddArc(0, Arc(label, label, Weight(-std::log(probs[label - 1])), 1));
+      }
+      F.SetFinal(0, Weight(-std::log(probs[3])));
+      F.SetFinal(1, Weight::One());
+      // Same arcs behind an epsilon arc, so the start states differ.
+      VectorFst<Arc> G;
+      G.AddStates(3);
+      G.SetStart(0);
+      G.AddArc(0, Arc(0, 0, Weight::One(), 1));
+      for (ArcIterator<VectorFst<Arc>> aiter(F, 0); !aiter.Done();
+           aiter.Next()) {
+        auto arc = aiter.Value();
+        arc.nextstate = 2;
+        G.AddArc(1, arc);
+      }
+      G.SetFinal(1, F.Final(0));
+      G.SetFinal(2, Weight::One());
+      // Same arcs with no weights and a non-final start state.
+      VectorFst<Arc> U(F);
+      U.SetFinal(0, Weight::Zero());
+      for (MutableArcIterator<VectorFst<Arc>> aiter(&U, 0); !aiter.Done();
+           aiter.Next()) {
+        auto arc = aiter.Value();
+        arc.weight = Weight::One();
+        aiter.SetValue(arc);
+      }
+
+      constexpr size_t kNumDraws = 20000;
+      const RandState<Arc> rstate(0, kNumDraws);
+      // Checks the draws are within five standard deviations of the expected
+      // counts.
+      auto check_draws = [&](auto &&sampler, const std::vector<double> &p) {
+        std::vector<size_t> counts(p.size(), 0);
+        CHECK(sampler.Sample(rstate));
+        for (; !sampler.Done(); sampler.Next()) {
+          counts[sampler.Value().first] += sampler.Value().second;
+        }
+        for (size_t n = 0; n < p.size(); ++n) {
+          const double expected = p[n] * kNumDraws;
+          CHECK_LE(std::abs(counts[n] - expected),
+                   5 * std::sqrt(expected * (1 - p[n])) + 1);
+        }
+      };
+      const AliasArcSelector<Arc> alias_selector(seed_, /*arc_limit=*/1);
+      const LogProbArcSelector<Arc> logprob_selector(seed_);
+      const UniformArcSelector<Arc> uniform_selector(seed_);
+      check_draws(ArcSampler<Arc, AliasArcSelector<Arc>>(F, alias_selector),
+                  probs);
+      check_draws(
+          ArcSampler<Arc, LogProbArcSelector<Arc>>(F, logprob_selector),
+          probs);
+      const std::vector<double> uniform_probs = {1.0 / 3, 1.0 / 3, 1.0 / 3, 0};
+      check_draws(ArcSampler<Arc, AliasArcSelector<Arc>>(U, alias_selector),
+                  uniform_probs);
+      check_draws(
+          ArcSampler<Arc, UniformArcSelector<Arc>>(U, uniform_selector),
+          uniform_probs);
+
+      VLOG(1) << "Check alias arc selection on two different FSTs.";
+      const RandGenOptions<AliasArcSelector<Arc>> opts(alias_selector,
+                                                       kRandomPathLength);
+      CHECK(RandEquivalent(F, G, kNumRandomPaths, opts, kTestDelta, seed_));
+      CHECK(RandEquivalent(G, F, kNumRandomPaths, opts, kTestDelta, seed_));
+    }
+
     if constexpr (IsPath<Weight>::value) {
       uint64_t wprops = Weight::Properties();
 
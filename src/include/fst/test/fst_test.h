@@ -22,6 +22,7 @@
 
 #include <cstddef>
 #include <memory>
+#include <sstream>
 #include <string>
 
 #include <fst/log.h>
@@ -34,6 +35,8 @@
 #include <fst/properties.h>
 #include <fst/vector-fst.h>
 #include <fst/verify.h>
+#include <fst/script/compile-impl.h>
+#include <fst/script/print-impl.h>
 
 namespace fst {
 
@@ -67,6 +70,8 @@ class FstTester {
     StateIterator<G> siter(fst);
     Matcher<G> matcher(fst, MATCH_INPUT);
     MatchType match_type = matcher.Type(true);
+    Matcher<G> omatcher(fst, MATCH_OUTPUT);
+    MatchType omatch_type = omatcher.Type(true);
     bool has_states = false;
     for (; !siter.Done(); siter.Next()) {
       has_states = true;
@@ -94,6 +99,11 @@ class FstTester {
         if (match_type == MATCH_INPUT) {
           CHECK(matcher.Find(arc.ilabel));
           CHECK_EQ(matcher.Value().ilabel, arc.ilabel);
+          CHECK_EQ(matcher.Value().olabel, arc.olabel);
+          CHECK_EQ(matcher.Value().weight, arc.weight);
+          CHECK_EQ(matcher.Value().nextstate, arc.nextstate);
+          matcher.Next();
+          CHECK(matcher.Done());
         }
       }
       CHECK_EQ(na, s + 1);
@@ -105,6 +115,18 @@ class FstTester {
       CHECK(!matcher.Find(kNoLabel));  // no explicit input epsilons
       CHECK(matcher.Find(0));
       CHECK_EQ(matcher.Value().ilabel, kNoLabel);  // implicit epsilon loop
+      if (omatch_type == MATCH_OUTPUT) {
+        // All output labels are epsilons, matched after the implicit loop.
+        omatcher.SetState(s);
+        CHECK(omatcher.Find(0));
+        CHECK_EQ(omatcher.Value().olabel, kNoLabel);
+        size_t nmatches = 0;
+        for (omatcher.Next(); !omatcher.Done(); omatcher.Next()) {
+          CHECK_EQ(omatcher.Value().ilabel, ++nmatches);
+        }
+        CHECK_EQ(nmatches, s + 1);
+        CHECK(!omatcher.Find(1));
+      }
       ++ns;
     }
     CHECK_EQ(num_states_, ns);
@@ -255,6 +277,20 @@ class FstTester {
       TestBase(*gfst);
     }
 
+    // check out-of-core reading, keeping few small chunks resident.
+    for (const bool chunk_stats : {false, true}) {
+      std::ifstream istr(aligned);
+      FstReadOptions opts;
+      opts.mode = FstReadOptions::ReadMode("map");
+      opts.source = aligned;
+      opts.chunk_states = 3;
+      opts.max_resident_chunks = 2;
+      opts.chunk_stats = chunk_stats;
+      auto gfst = fst::WrapUnique(G::Read(istr, opts));
+      CHECK(gfst);
+      TestBase(*gfst);
+    }
+
     // check mmaping of unaligned files to make sure it does not fail.
     {
       {
@@ -289,6 +325,37 @@ class FstTester {
       TestExpanded(*mfst);
       TestMutable(mfst.get());
     }
+
+    // text print/compile
+    {
+      std::ostringstream text;
+      FstPrinter<Arc> printer(fst, nullptr, nullptr, nullptr,
+                                      /*accept=*/false,
+                                      /*show_weight_one=*/true, "\t");
+      printer.Print(text, "test");
+      // Parallel printing gives the same text for any number of threads.
+      for (const size_t num_threads : {0, 2, 5}) {
+        std::ostringstream ptext;
+        FstPrinter<Arc> pprinter(fst, nullptr, nullptr, nullptr,
+                                 /*accept=*/false, /*show_weight_one=*/true,
+                                 "\t", /*missing_symbol=*/"", num_threads);
+        pprinter.Print(ptext, "test");
+        CHECK_EQ(text.str(), ptext.str());
+      }
+      std::istringstream istrm(text.str());
+      const FstCompiler<Arc> compiler(
+          istrm, "test", nullptr, nullptr, nullptr, /*accep=*/false,
+          /*ikeep=*/false, /*okeep=*/false, /*nkeep=*/true);
+      CHECK(Verify(compiler.Fst()));
+      // Parallel compilation gives the same FST for any number of threads.
+      for (const size_t num_threads : {0, 2, 5}) {
+        std::istringstream pstrm(text.str());
+        const FstCompiler<Arc> pcompiler(
+            pstrm, "test", nullptr, nullptr, nullptr, /*accep=*/false,
+            /*ikeep=*/false, /*okeep=*/false, /*nkeep=*/true, num_threads);
+        CHECK(Equal(compiler.Fst(), pcompiler.Fst()));
+      }
+    }
   }
 
   void TestIO() const { TestIO(*testfst_); }
@@ -31,6 +31,7 @@
 #include <new>
 #include <ostream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -103,6 +104,25 @@ class VectorState {
 
   void SetNumOutputEpsilons(size_t n) { noepsilons_ = n; }
 
+  // Resizes the arc container to n arcs and returns them for bulk
+  // initialization by the caller, who must then call CountEpsilons().
+  Arc *ResizeArcs(size_t n) {
+    arcs_.resize(n);
+    return MutableArcs();
+  }
+
+  // Recomputes the number of epsilons from the arcs.
+  void CountEpsilons() {
+    size_t niepsilons = 0;
+    size_t noepsilons = 0;
+    for (const auto &arc : arcs_) {
+      niepsilons += arc.ilabel == 0;
+      noepsilons += arc.olabel == 0;
+    }
+    niepsilons_ = niepsilons;
+    noepsilons_ = noepsilons;
+  }
+
   void AddArc(const Arc &arc) {
     IncrementNumEpsilons(arc);
     arcs_.push_back(arc);
@@ -168,6 +188,22 @@ class VectorState {
 
 namespace internal {
 
+// Whether the arcs are serialized in their in-memory layout, i.e., they are
+// trivially copyable ArcTpls without padding whose weight is a floating-point
+// value written as is. Such arcs can be read in bulk.
+template <class Arc, class = void>
+struct HasRawArcLayout : std::false_type {};
+
+template <class W, class L, class S>
+struct HasRawArcLayout<
+    ArcTpl<W, L, S>,
+    std::enable_if_t<
+        std::is_base_of_v<FloatWeightTpl<typename W::ValueType>, W>>>
+    : std::bool_constant<std::is_trivially_copyable_v<ArcTpl<W, L, S>> &&
+                         sizeof(W) == sizeof(typename W::ValueType) &&
+                         sizeof(ArcTpl<W, L, S>) ==
+                             2 * sizeof(L) + sizeof(W) + sizeof(S)> {};
+
 // States are implemented by STL vectors, templated on the
 // State definition. This does not manage the Fst properties.
 template <class S>
@@ -476,6 +512,11 @@ VectorFstImpl<S>::VectorFstImpl(const Fst<Arc> &fst) {
 template <class S>
 VectorFstImpl<S> *VectorFstImpl<S>::Read(std::istream &strm,
                                          const FstReadOptions &opts) {
+  // Arcs in their serialized layout are read directly into the arc vectors,
+  // with one stream read per state.
+  static constexpr bool kBulkRead =
+      HasRawArcLayout<Arc>::value &&
+      std::is_same_v<S, VectorState<Arc, typename S::ArcAllocator>>;
   auto impl = std::make_unique<VectorFstImpl>();
   FstHeader hdr;
   if (!impl->ReadHeader(strm, opts, kMinFileVersion, &hdr)) return nullptr;
@@ -494,6 +535,18 @@ VectorFstImpl<S> *VectorFstImpl<S>::Read(std::istream &strm,
       LOG(ERROR) << "VectorFst::Read: Read failed: " << opts.source;
       return nullptr;
     }
+    if constexpr (kBulkRead) {
+      if (narcs > 0) {
+        auto *arcs = vstate->ResizeArcs(narcs);
+        strm.read(reinterpret_cast<char *>(arcs), narcs * sizeof(Arc));
+        if (!strm) {
+          LOG(ERROR) << "VectorFst::Read: Read failed: " << opts.source;
+          return nullptr;
+        }
+        vstate->CountEpsilons();
+      }
+      continue;
+    }
     impl->ReserveArcs(state, narcs);
     for (int64_t i = 0; i < narcs; ++i) {
       Arc arc;
@@ -48,6 +48,10 @@ DEFINE_string(save_relabel_opairs, "", "Save output relabel pairs to file");
 
 DEFINE_string(fst_read_mode, "read",
               "Default file reading mode for mappable files");
+DEFINE_bool(fst_map_populate, false,
+            "Pre-fault memory-mapped FST data when reading");
+DEFINE_bool(fst_huge_pages, false,
+            "Back FST data read from files with huge pages where possible");
 
 namespace fst {
 
@@ -114,7 +118,12 @@ FstReadOptions::FstReadOptions(const std::string_view source,
       isymbols(isymbols),
       osymbols(osymbols),
       read_isymbols(true),
-      read_osymbols(true) {
+      read_osymbols(true),
+      populate(FST_FLAGS_fst_map_populate),
+      huge_pages(FST_FLAGS_fst_huge_pages),
+      chunk_states(0),
+      max_resident_chunks(64),
+      chunk_stats(false) {
   mode = ReadMode(FST_FLAGS_fst_read_mode);
 }
 
@@ -138,7 +147,12 @@ std::string FstReadOptions::DebugString() const {
         << (read_osymbols ? "true" : "false") << "\" header: \""
         << (header ? "set" : "null") << "\" isymbols: \""
         << (isymbols ? "set" : "null") << "\" osymbols: \""
-        << (osymbols ? "set" : "null") << "\"";
+        << (osymbols ? "set" : "null") << "\" populate: \""
+        << (populate ? "true" : "false") << "\" huge_pages: \""
+        << (huge_pages ? "true" : "false") << "\" chunk_states: \""
+        << chunk_states << "\" max_resident_chunks: \""
+        << max_resident_chunks << "\" chunk_stats: \""
+        << (chunk_stats ? "true" : "false") << "\"";
   return ostrm.str();
 }
 
@@ -39,6 +39,7 @@
 #include <istream>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include <fst/log.h>
 
@@ -77,7 +78,8 @@ MappedFile::~MappedFile() {
 MappedFile * MappedFile::Map(std::istream &istrm,
                                              bool memorymap,
                                              const std::string &source,
-                                             size_t size) {
+                                             size_t size, bool populate,
+                                             bool huge_pages) {
   const auto spos = istrm.tellg();
   VLOG(2) << "memorymap: " << (memorymap ? "true" : "false") << " source: \""
           << source << "\""
@@ -90,7 +92,8 @@ MappedFile * MappedFile::Map(std::istream &istrm,
     const int fd = open(source.c_str(), O_RDONLY);
 #endif
     if (fd != -1) {
-      std::unique_ptr<MappedFile> mmf(MapFromFileDescriptor(fd, pos, size));
+      std::unique_ptr<MappedFile> mmf(
+          MapFromFileDescriptor(fd, pos, size, populate, huge_pages));
       if (close(fd) == 0 && mmf != nullptr) {
         istrm.seekg(pos + size, std::ios::beg);
         if (istrm) {
@@ -110,7 +113,7 @@ MappedFile * MappedFile::Map(std::istream &istrm,
                  << " could not be honored, reading instead";
   }
   // Reads the file into the buffer in chunks not larger than kMaxReadChunk.
-  std::unique_ptr<MappedFile> mf(Allocate(size));
+  std::unique_ptr<MappedFile> mf(Allocate(size, kArchAlignment, huge_pages));
   auto *buffer = static_cast<char *>(mf->mutable_data());
   while (size > 0) {
     const auto next_size = std::min(size, kMaxReadChunk);
@@ -127,9 +130,8 @@ MappedFile * MappedFile::Map(std::istream &istrm,
   return mf.release();
 }
 
-MappedFile * MappedFile::MapFromFileDescriptor(int fd,
-                                                               size_t pos,
-                                                               size_t size) {
+MappedFile * MappedFile::MapFromFileDescriptor(
+    int fd, size_t pos, size_t size, bool populate, bool huge_pages) {
 #ifdef _WIN32
   SYSTEM_INFO sysInfo;
   GetSystemInfo(&sysInfo);
@@ -176,12 +178,21 @@ MappedFile * MappedFile::MapFromFileDescriptor(int fd,
     return nullptr;
   }
 #else
-  void *map = mmap(nullptr, upsize, PROT_READ, MAP_SHARED, fd, offset_pos);
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (populate) flags |= MAP_POPULATE;
+#endif  // MAP_POPULATE
+  void *map = mmap(nullptr, upsize, PROT_READ, flags, fd, offset_pos);
   if (map == MAP_FAILED) {
     LOG(ERROR) << "mmap failed for fd=" << fd << " size=" << upsize
                << " offset=" << offset_pos;
     return nullptr;
   }
+#ifdef MADV_HUGEPAGE
+  if (huge_pages && madvise(map, upsize, MADV_HUGEPAGE) != 0) {
+    VLOG(1) << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+  }
+#endif  // MADV_HUGEPAGE
 #endif
   MemoryRegion region;
   region.mmap = map;
@@ -194,10 +205,12 @@ MappedFile * MappedFile::MapFromFileDescriptor(int fd,
   return new MappedFile(region);
 }
 
-MappedFile *MappedFile::Allocate(size_t size, size_t align) {
+MappedFile *MappedFile::Allocate(size_t size, size_t align, bool huge_pages) {
   MemoryRegion region;
   region.data = nullptr;
   region.offset = 0;
+  huge_pages = huge_pages && size >= kHugePageSize;
+  if (huge_pages) align = std::max(align, kHugePageSize);
   if (size > 0) {
     // TODO(jrosenstock,sorenj): Use std::align() when that is no longer banned.
     // Use std::aligned_alloc() when C++17 is allowed.
@@ -205,12 +218,64 @@ MappedFile *MappedFile::Allocate(size_t size, size_t align) {
     uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
     region.offset = align - (address % align);
     region.data = buffer + region.offset;
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+    // The block is not yet touched, so it can be faulted in as huge pages.
+    if (huge_pages &&
+        madvise(region.data, size / kHugePageSize * kHugePageSize,
+                MADV_HUGEPAGE) != 0) {
+      VLOG(1) << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+    }
+#endif
   }
   region.mmap = nullptr;
   region.size = size;
   return new MappedFile(region);
 }
 
+bool MappedFile::Advise(size_t pos, size_t size, Advice advice) const {
+#ifdef _WIN32
+  return false;
+#else
+  if (!IsMapped() || size == 0) return false;
+  const size_t pagesize = sysconf(_SC_PAGESIZE);
+  // Offsets from the start of the mapping, which is page-aligned.
+  size_t begin = region_.offset + pos;
+  size_t end = std::min(begin + size, region_.size);
+  if (advice == DONTNEED) {
+    begin = (begin + pagesize - 1) / pagesize * pagesize;
+    // The partial page at the end of the mapping holds no other data.
+    if (end != region_.size) end = end / pagesize * pagesize;
+  } else {
+    begin = begin / pagesize * pagesize;
+  }
+  if (begin >= end) return true;
+  int flag = MADV_NORMAL;
+  switch (advice) {
+    case NORMAL:
+      flag = MADV_NORMAL;
+      break;
+    case RANDOM:
+      flag = MADV_RANDOM;
+      break;
+    case SEQUENTIAL:
+      flag = MADV_SEQUENTIAL;
+      break;
+    case WILLNEED:
+      flag = MADV_WILLNEED;
+      break;
+    case DONTNEED:
+      flag = MADV_DONTNEED;
+      break;
+  }
+  if (madvise(static_cast<char *>(region_.mmap) + begin, end - begin, flag) !=
+      0) {
+    VLOG(1) << "madvise failed: " << strerror(errno);
+    return false;
+  }
+  return true;
+#endif  // _WIN32
+}
+
 MappedFile *MappedFile::Borrow(void *data) {
   MemoryRegion region;
   region.data = data;
@@ -220,4 +285,58 @@ MappedFile *MappedFile::Borrow(void *data) {
   return new MappedFile(region);
 }
 
+MappedChunkCache::MappedChunkCache(size_t num_states, size_t chunk_states,
+                                   size_t max_chunks, bool count_accesses,
+                                   AdviseFn advise)
+    : chunk_states_(std::max<size_t>(chunk_states, 1)),
+      max_chunks_(std::max<size_t>(max_chunks, 1)),
+      count_accesses_(count_accesses),
+      advise_(std::move(advise)),
+      position_((num_states + chunk_states_ - 1) / chunk_states_),
+      resident_(position_.size(), false) {}
+
+void MappedChunkCache::Fault(size_t chunk) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (chunk >= resident_.size()) return;
+  if (resident_[chunk]) {
+    lru_.splice(lru_.begin(), lru_, position_[chunk]);
+  } else {
+    ++faults_;
+    // Loads the next chunk ahead when the faults are sequential; it is placed
+    // behind this chunk so it is not the next to be released.
+    if (max_chunks_ > 1 && last_fault_ + 1 == chunk &&
+        chunk + 1 < resident_.size() && !resident_[chunk + 1]) {
+      Load(chunk + 1);
+      ++prefetches_;
+    }
+    last_fault_ = chunk;
+    Load(chunk);
+  }
+  mru_chunk_.store(chunk, std::memory_order_release);
+}
+
+void MappedChunkCache::Load(size_t chunk) {
+  while (lru_.size() >= max_chunks_) {
+    const auto evicted = lru_.back();
+    lru_.pop_back();
+    resident_[evicted] = false;
+    advise_(evicted, MappedFile::DONTNEED);
+    ++evictions_;
+  }
+  advise_(chunk, MappedFile::WILLNEED);
+  lru_.push_front(chunk);
+  position_[chunk] = lru_.begin();
+  resident_[chunk] = true;
+}
+
+MappedChunkCache::Stats MappedChunkCache::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats;
+  stats.accesses = accesses_.load(std::memory_order_relaxed);
+  stats.faults = faults_;
+  stats.prefetches = prefetches_;
+  stats.evictions = evictions_;
+  return stats;
+}
+
 }  // namespace fst
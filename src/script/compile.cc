@@ -17,6 +17,7 @@
 
 #include <fst/script/compile.h>
 
+#include <cstddef>
 #include <istream>
 #include <memory>
 #include <string>
@@ -33,10 +34,10 @@ void Compile(std::istream &istrm, const std::string &source,
              const std::string &dest, const std::string &fst_type,
              const std::string &arc_type, const SymbolTable *isyms,
              const SymbolTable *osyms, const SymbolTable *ssyms, bool accep,
-             bool ikeep, bool okeep, bool nkeep) {
-  std::unique_ptr<FstClass> fst(CompileInternal(istrm, source, fst_type,
-                                                arc_type, isyms, osyms, ssyms,
-                                                accep, ikeep, okeep, nkeep));
+             bool ikeep, bool okeep, bool nkeep, size_t num_threads) {
+  std::unique_ptr<FstClass> fst(CompileInternal(
+      istrm, source, fst_type, arc_type, isyms, osyms, ssyms, accep, ikeep,
+      okeep, nkeep, num_threads));
   fst->Write(dest);
 }
 
@@ -44,7 +45,7 @@ std::unique_ptr<FstClass> CompileInternal(
     std::istream &istrm, const std::string &source, const std::string &fst_type,
     const std::string &arc_type, const SymbolTable *isyms,
     const SymbolTable *osyms, const SymbolTable *ssyms, bool accep, bool ikeep,
-    bool okeep, bool nkeep) {
+    bool okeep, bool nkeep, size_t num_threads) {
   FstCompileInnerArgs iargs{istrm,
                             source,
                             fst_type,
@@ -54,7 +55,8 @@ std::unique_ptr<FstClass> CompileInternal(
                             accep,
                             ikeep,
                             okeep,
-                            nkeep};
+                            nkeep,
+                            num_threads};
   FstCompileArgs args(iargs);
   Apply<Operation<FstCompileArgs>>("CompileInternal", arc_type, &args);
   return std::move(args.retval);
@@ -175,6 +175,8 @@ bool GetRandArcSelection(std::string_view str, RandArcSelection *ras) {
     *ras = RandArcSelection::LOG_PROB;
   } else if (str == "fast_log_prob") {
     *ras = RandArcSelection::FAST_LOG_PROB;
+  } else if (str == "alias") {
+    *ras = RandArcSelection::ALIAS;
   } else {
     return false;
   }
@@ -17,6 +17,7 @@
 
 #include <fst/script/print.h>
 
+#include <cstddef>
 #include <ostream>
 #include <string>
 
@@ -30,10 +31,10 @@ namespace script {
 void Print(const FstClass &fst, std::ostream &ostrm, const std::string &dest,
            const SymbolTable *isyms, const SymbolTable *osyms,
            const SymbolTable *ssyms, bool accept, bool show_weight_one,
-           const std::string &missing_sym) {
+           const std::string &missing_sym, size_t num_threads) {
   const auto sep = FST_FLAGS_fst_field_separator.substr(0, 1);
-  FstPrintArgs args{fst,   isyms, osyms, ssyms,      accept, show_weight_one,
-                    ostrm, dest,  sep,   missing_sym};
+  FstPrintArgs args{fst,   isyms, osyms, ssyms,       accept, show_weight_one,
+                    ostrm, dest,  sep,   missing_sym, num_threads};
   Apply<Operation<FstPrintArgs>>("Print", fst.ArcType(), &args);
 }
 
@@ -22,8 +22,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <ostream>
+#include <random>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include <fst/log.h>
 #include <fst/arc.h>
@@ -31,6 +35,7 @@
 #include <fst/compact-fst.h>
 #include <fst/const-fst.h>
 #include <fst/edit-fst.h>
+#include <fst/extensions/compress/elias.h>
 #include <fst/float-weight.h>
 #include <fst/fst-decl.h>
 #include <fst/matcher-fst.h>
@@ -84,6 +89,71 @@ static fst::FstRegisterer<
     CompactFst<CustomArc, TrivialCompactor<CustomArc>>>
     CompactFst_CustomArc_CustomCompactor_registerer;
 
+// Decodes a bit stream of nbytes bytes, returning false on error.
+bool EliasDecode(const std::string &bytes, int64_t nbytes,
+                 std::vector<int64_t> *output) {
+  std::istringstream strm(bytes);
+  BitReader reader(strm, nbytes);
+  Elias<int64_t>::BatchDecode(&reader, output);
+  return !reader.Error();
+}
+
+// Tests that word-packed Elias delta codes match the bool vector codes,
+// decode back to their input, and are rejected when truncated or corrupt.
+void TestElias() {
+  std::vector<int64_t> values = {0, 1, 2, 3,
+                                 std::numeric_limits<int64_t>::max() - 1};
+  for (int k = 1; k < 63; ++k) {
+    const int64_t p = int64_t{1} << k;
+    values.insert(values.end(), {p - 2, p - 1, p});
+  }
+  std::mt19937_64 rand(403);
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(rand() >> std::uniform_int_distribution<>(1, 63)(rand));
+  }
+
+  BitWriter writer;
+  std::vector<bool> code;
+  for (const auto value : values) {
+    Elias<int64_t>::DeltaEncode(value, &writer);
+    std::vector<bool> value_code;
+    Elias<int64_t>::DeltaEncode(value, &value_code);
+    code.insert(code.end(), value_code.begin(), value_code.end());
+    CHECK_EQ(writer.NumBits(), code.size());
+  }
+  std::ostringstream ostrm;
+  writer.WriteToStream(ostrm);
+  std::istringstream istrm(ostrm.str());
+  int64_t nbytes = 0;
+  ReadType(istrm, &nbytes);
+  CHECK_EQ(nbytes, (code.size() + 7) / 8);
+  const std::string bytes = ostrm.str().substr(sizeof(nbytes));
+  CHECK_EQ(bytes.size(), nbytes);
+  for (size_t i = 0; i < code.size(); ++i) {
+    CHECK_EQ((bytes[i / 8] >> (7 - i % 8)) & 1, code[i]);
+  }
+
+  // The one-bit padding decodes as zeros.
+  std::vector<int64_t> output;
+  CHECK(EliasDecode(bytes, nbytes, &output));
+  CHECK_EQ(output.size(), values.size() + (8 - code.size() % 8) % 8);
+  output.resize(values.size());
+  CHECK(output == values);
+  std::vector<int64_t> bool_output;
+  Elias<int64_t>::BatchDecode(code, &bool_output);
+  CHECK(bool_output == values);
+
+  // Truncated streams.
+  CHECK(!EliasDecode(bytes.substr(0, nbytes / 2), nbytes, &output));
+  CHECK(!EliasDecode(bytes, nbytes + 1, &output));
+  CHECK(EliasDecode(std::string(1, '\xff'), 1, &output));
+  // A length of 16 followed by only 2 bits.
+  CHECK(!EliasDecode(std::string(1, '\x08'), 1, &output));
+  // Lengths longer than 64 bits.
+  CHECK(!EliasDecode(std::string(4, '\0'), 4, &output));
+  CHECK(!EliasDecode(std::string("\x02\x08", 2), 2, &output));
+}
+
 }  // namespace
 }  // namespace fst
 
@@ -95,6 +165,7 @@ using fst::EditFst;
 using fst::FstTester;
 using fst::StdArc;
 using fst::StdArcLookAheadFst;
+using fst::TestElias;
 using fst::TrivialArcCompactor;
 using fst::TrivialCompactor;
 using fst::VectorFst;
@@ -268,6 +339,9 @@ int main(int argc, char **argv) {
     std_edit_tester.TestMutable();
   }
 
+  LOG(INFO) << "Testing Elias codes.";
+  TestElias();
+
   std::cout << "PASS" << std::endl;
 
   return 0;